@@ -0,0 +1,429 @@
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/resource.h>
+
+#include "elf_header.hpp"
+#include "address_space.hpp"
+#include "content_hash.hpp"
+#include "crc32.hpp"
+#include "size_report.hpp"
+#include "relocation_xref.hpp"
+#include "elf_generator.hpp"
+#include "string_table_builder.hpp"
+#include "windowed_file.hpp"
+#include "validated_elf.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    struct Options {
+        u64 min_time_ns = 200 * 1000 * 1000;
+        usize max_system_files = 32;
+        usize synthetic_symbols = 1000000;
+        usize synthetic_sections = 100000;
+        bool system = true;
+        bool synthetic = true;
+        std::string synthetic_dir = "/tmp";
+        std::vector<std::string> files;
+    };
+
+    volatile u64 sink = 0;
+
+    struct Usage {
+        long minor_faults;
+        long major_faults;
+        long peak_rss_kb;
+
+        static Usage now() {
+            struct rusage usage{};
+            getrusage(RUSAGE_SELF, &usage);
+            return Usage{usage.ru_minflt, usage.ru_majflt, usage.ru_maxrss};
+        }
+    };
+
+    void print_json_string(const char *str) {
+        putchar('"');
+        for (; *str != '\0'; ++str) {
+            char c = *str;
+            if (c == '"' || c == '\\') {
+                putchar('\\');
+                putchar(c);
+            } else if (static_cast<u8>(c) < 0x20) {
+                printf("\\u%04x", c);
+            } else {
+                putchar(c);
+            }
+        }
+        putchar('"');
+    }
+
+    /// run `body` until `min_time_ns` elapsed, `body` returns a checksum to keep the work alive, `ops` and `bytes` are
+    /// the amount of operations and bytes processed by one call of `body`.
+    template<typename F>
+    void run(const Options &options, const char *name, const std::string &file, usize ops, usize bytes, F body) {
+        if (ops == 0) return;
+
+        Usage before = Usage::now();
+        auto start = std::chrono::steady_clock::now();
+        u64 iterations = 0;
+        u64 elapsed = 0;
+
+        do {
+            sink = sink + body();
+            ++iterations;
+            elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < options.min_time_ns);
+
+        Usage after = Usage::now();
+        double total_ops = static_cast<double>(iterations) * ops;
+        double seconds = static_cast<double>(elapsed) / 1e9;
+
+        printf("{\"benchmark\":\"%s\",\"file\":", name);
+        print_json_string(file.c_str());
+        printf(",\"iterations\":%llu,\"ops\":%.0f,\"ns_per_op\":%.3f,\"bytes_per_second\":%.0f,"
+               "\"minor_faults\":%ld,\"major_faults\":%ld,\"peak_rss_kb\":%ld}\n",
+               static_cast<unsigned long long>(iterations), total_ops, static_cast<double>(elapsed) / total_ops,
+               static_cast<double>(iterations) * bytes / seconds,
+               after.minor_faults - before.minor_faults, after.major_faults - before.major_faults,
+               after.peak_rss_kb);
+        fflush(stdout);
+    }
+
+    template<typename USizeT>
+    void bench_file(const Options &options, const std::string &file, MappedFileVisitor &visitor) {
+        using ELFHeaderT = ELFHeader<USizeT>;
+        using SectionHeaderT = SectionHeader<USizeT>;
+        using SymbolTableHeaderT = _SymbolTableHeader<USizeT>;
+        using SymbolTableEntryT = typename SymbolTableHeaderT::SymbolTableEntry;
+
+        struct stat file_stat{};
+        if (fstat(visitor.get_fd(), &file_stat) != 0) return;
+        usize file_size = file_stat.st_size;
+
+        ELFHeaderT *header = ELFHeaderT::read(visitor);
+        if (header == nullptr) {
+            elf_warn("not a valid elf file, skipped!");
+            return;
+        }
+
+        run(options, "open_read", file, 1, file_size, [&]() -> u64 {
+            MappedFileVisitor other = MappedFileVisitor::open_elf(file.c_str());
+            return reinterpret_cast<uintptr_t>(ELFHeaderT::read(other));
+        });
+
+        /// the section header table through 1 MiB windows, as a file too large to be mapped at once is read.
+        run(options, "windowed_open_read", file, 1, file_size, [&]() -> u64 {
+            WindowedFileVisitor other = WindowedFileVisitor::open_elf(file.c_str(), 1024 * 1024);
+            ELFHeaderT *windowed_header = other.template read_header<USizeT>();
+            if (windowed_header == nullptr) return 0;
+
+            /// the section number, from section 0 with extended section numbering.
+            MappedFileVisitor *first = other.view(windowed_header->section_header_offset, sizeof(SectionHeaderT));
+            if (first == nullptr) return 0;
+
+            usize table_size = windowed_header->get_section_num(*first) * windowed_header->section_header_size;
+            MappedFileVisitor *table = other.view(windowed_header->section_header_offset, table_size);
+            if (table == nullptr) return 0;
+
+            u64 sum = 0;
+            for (auto &section: windowed_header->sections(*table)) sum += section.size;
+            return sum;
+        });
+
+        ValidatedELF<USizeT> validated = validate<USizeT>(visitor);
+
+        run(options, "validate", file, 1, file_size, [&]() -> u64 {
+            return validate<USizeT>(visitor).is_valid();
+        });
+
+        usize section_num = header->sections(visitor).size();
+
+        run(options, "section_iterate", file, section_num, section_num * header->section_header_size, [&]() -> u64 {
+            u64 sum = 0;
+            for (auto &section: header->sections(visitor)) sum += section.size ^ section.section_type;
+            return sum;
+        });
+
+        AddressSpace<USizeT> space = AddressSpace<USizeT>::build(header, visitor);
+        std::vector<USizeT> addresses;
+        for (auto &segment: space.get_segments()) {
+            USizeT stride = std::max<USizeT>(sizeof(USizeT), (segment.end - segment.start) / 256);
+            for (USizeT address = segment.start; address < segment.end && segment.end - address >= sizeof(USizeT);
+                 address += stride) {
+                addresses.push_back(address);
+            }
+        }
+
+        if (!addresses.empty()) {
+            run(options, "address_read", file, addresses.size(), addresses.size() * sizeof(USizeT), [&]() -> u64 {
+                u64 sum = 0;
+                for (USizeT address: addresses) {
+                    USizeT val = 0;
+                    if (space.read_value(address, val)) sum += val;
+                }
+                return sum;
+            });
+        }
+
+        run(options, "content_hash", file, 1, file_size, [&]() -> u64 {
+            return ContentHasher::hash(visitor.address(0, file_size), file_size);
+        });
+
+        run(options, "crc32", file, 1, file_size, [&]() -> u64 {
+            return CRC32::compute(visitor.address(0, file_size), file_size);
+        });
+
+        run(options, "size_report", file, 1, file_size, [&]() -> u64 {
+            SizeReport::Node root{};
+            SizeReport::build(header, visitor, root);
+            return root.children.size();
+        });
+
+        if (validated.is_valid()) {
+            run(options, "relocation_xref", file, 1, file_size, [&]() -> u64 {
+                RelocationXRef xref{};
+                xref.build(validated);
+                return xref.size();
+            });
+        }
+
+        if (header->get_section_string_table_header(visitor) == nullptr) return;
+
+        auto section_string_table = header->get_section_string_table(visitor);
+        const char *target = nullptr;
+        SymbolTableHeaderT *symbol_header = nullptr;
+        StringTableHeader<USizeT> *string_header = nullptr;
+
+        for (auto &section: header->sections(visitor)) {
+            const char *name = section_string_table.get_str(section.name);
+            if (name == nullptr) continue;
+            if (target == nullptr && section.section_type == SectionHeaderT::STRING_TABLE) target = name;
+
+            if (symbol_header != nullptr && symbol_header->section_type == SectionHeaderT::SYMBOL_TABLE) continue;
+
+            SymbolTableHeaderT *symbol = SectionHeaderT::template cast<SymbolTableHeader<USizeT>>(&section, visitor);
+            if (symbol == nullptr) {
+                symbol = SectionHeaderT::template cast<DynSymbolTableHeader<USizeT>>(&section, visitor);
+            }
+            if (symbol == nullptr || symbol->link >= section_num) continue;
+
+            auto *string = SectionHeaderT::template cast<StringTableHeader<USizeT>>(
+                    &header->sections(visitor)[symbol->link], visitor);
+            if (string == nullptr) continue;
+
+            symbol_header = symbol;
+            string_header = string;
+        }
+
+        if (target != nullptr) {
+            run(options, "section_by_name", file, 1, section_num * header->section_header_size,
+                [&]() -> u64 {
+                    return reinterpret_cast<uintptr_t>(
+                            header->template get_section_header<StringTableHeader<USizeT>>(target, visitor));
+                });
+        }
+
+        if (symbol_header == nullptr) return;
+
+        auto symbols = symbol_header->get_table(visitor);
+        auto strings = string_header->get_table(visitor);
+        usize symbol_num = symbol_header->size / symbol_header->entry_size;
+
+        run(options, "symbol_iterate", file, symbol_num, symbol_header->size, [&]() -> u64 {
+            u64 sum = 0;
+            for (auto &symbol: symbols) sum += symbol.value ^ symbol.info;
+            return sum;
+        });
+
+        usize string_bytes = 0;
+        std::vector<const char *> samples;
+        usize stride = std::max<usize>(1, symbol_num / 16);
+
+        for (usize i = 0; i < symbol_num; ++i) {
+            const char *name = strings.get_str(symbols[i].name);
+            if (name == nullptr) continue;
+            string_bytes += strlen(name) + 1;
+            if (i % stride == 0 && *name != '\0') samples.push_back(name);
+        }
+
+        run(options, "get_str", file, symbol_num, string_bytes, [&]() -> u64 {
+            u64 sum = 0;
+            for (auto &symbol: symbols) {
+                const char *name = strings.get_str(symbol.name);
+                if (name != nullptr) sum += static_cast<u8>(*name);
+            }
+            return sum;
+        });
+
+        run(options, "string_table_build", file, symbol_num, string_bytes, [&]() -> u64 {
+            StringTableBuilder builder{};
+            for (auto &symbol: symbols) {
+                const char *name = strings.get_str(symbol.name);
+                if (name != nullptr) builder.add(name);
+            }
+            builder.finalize();
+            return builder.size();
+        });
+
+        if (validated.is_valid()) {
+            auto trusted_symbols = validated.get_symbol_table(*symbol_header);
+            auto trusted_strings = validated.get_linked_string_table(*symbol_header);
+
+            run(options, "trusted_get_str", file, symbol_num, string_bytes, [&]() -> u64 {
+                u64 sum = 0;
+                for (auto &symbol: trusted_symbols) sum += static_cast<u8>(*trusted_strings.get_str(symbol.name));
+                return sum;
+            });
+        }
+
+        run(options, "symbol_lookup", file, samples.size(), samples.size() * symbol_header->size, [&]() -> u64 {
+            u64 sum = 0;
+            for (const char *sample: samples) {
+                for (usize i = 0; i < symbol_num; ++i) {
+                    const SymbolTableEntryT &symbol = symbols[i];
+                    const char *name = strings.get_str(symbol.name);
+                    if (name != nullptr && strcmp(name, sample) == 0) {
+                        sum += i;
+                        break;
+                    }
+                }
+            }
+            return sum;
+        });
+    }
+
+    void bench_path(const Options &options, const std::string &file) {
+        MappedFileVisitor visitor = MappedFileVisitor::open_elf(file.c_str());
+        switch (get_elf_class(visitor)) {
+            case 1:
+                bench_file<u32>(options, file, visitor);
+                break;
+            case 2:
+                bench_file<u64>(options, file, visitor);
+                break;
+            default:
+                elf_warn("not an elf file in host byte order, skipped!");
+        }
+    }
+
+    bool is_shared_library_name(const char *name) {
+        const char *suffix = strstr(name, ".so");
+        return suffix != nullptr && (suffix[3] == '\0' || suffix[3] == '.');
+    }
+
+    void collect_system_files(const std::string &dir, usize depth, usize limit, std::vector<std::string> &files) {
+        if (files.size() >= limit) return;
+
+        DIR *handle = opendir(dir.c_str());
+        if (handle == nullptr) return;
+
+        std::vector<std::string> names;
+        for (struct dirent *entry = readdir(handle); entry != nullptr; entry = readdir(handle)) {
+            if (entry->d_name[0] != '.') names.emplace_back(entry->d_name);
+        }
+        closedir(handle);
+        std::sort(names.begin(), names.end());
+
+        for (auto &name: names) {
+            if (files.size() >= limit) return;
+
+            std::string path = dir + '/' + name;
+            struct stat file_stat{};
+            if (lstat(path.c_str(), &file_stat) != 0) continue;
+
+            if (S_ISDIR(file_stat.st_mode)) {
+                if (depth > 0) collect_system_files(path, depth - 1, limit, files);
+            } else if (S_ISREG(file_stat.st_mode) && is_shared_library_name(name.c_str())) {
+                files.push_back(path);
+            }
+        }
+    }
+
+    bool write_synthetic(const std::string &path, u64 seed, usize section_num, usize symbol_num) {
+        GeneratorOptions generator_options{};
+        generator_options.seed = seed;
+        generator_options.section_num = section_num;
+        generator_options.symbol_num = symbol_num;
+        generator_options.string_table_size = symbol_num * 32;
+        generator_options.relocation_num = symbol_num;
+        return ELFGenerator<u64>{generator_options}.write(path.c_str());
+    }
+
+    bool parse_options(int argc, char **argv, Options &options) {
+        for (int i = 1; i < argc; ++i) {
+            const char *arg = argv[i];
+            const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+            if (strcmp(arg, "--no-system") == 0) {
+                options.system = false;
+            } else if (strcmp(arg, "--no-synthetic") == 0) {
+                options.synthetic = false;
+            } else if (arg[0] == '-' && arg[1] == '-' && value == nullptr) {
+                return false;
+            } else if (strcmp(arg, "--min-time-ms") == 0) {
+                options.min_time_ns = strtoull(value, nullptr, 10) * 1000 * 1000;
+                ++i;
+            } else if (strcmp(arg, "--max-system-files") == 0) {
+                options.max_system_files = strtoull(value, nullptr, 10);
+                ++i;
+            } else if (strcmp(arg, "--synthetic-symbols") == 0) {
+                options.synthetic_symbols = strtoull(value, nullptr, 10);
+                ++i;
+            } else if (strcmp(arg, "--synthetic-sections") == 0) {
+                options.synthetic_sections = strtoull(value, nullptr, 10);
+                ++i;
+            } else if (strcmp(arg, "--synthetic-dir") == 0) {
+                options.synthetic_dir = value;
+                ++i;
+            } else if (arg[0] == '-') {
+                return false;
+            } else {
+                options.files.emplace_back(arg);
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char **argv) {
+    Options options{};
+
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0] << " [--min-time-ms N] [--max-system-files N] [--no-system]"
+                  << " [--no-synthetic] [--synthetic-dir DIR] [--synthetic-symbols N] [--synthetic-sections N]"
+                  << " [FILE...]" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> files = options.files;
+
+    if (options.system && options.files.empty()) {
+        collect_system_files("/usr/lib", 2, options.max_system_files, files);
+    }
+
+    std::vector<std::string> synthetic_files;
+    if (options.synthetic) {
+        std::string symbols_path = options.synthetic_dir + "/elf_bench_symbols.o";
+        std::string sections_path = options.synthetic_dir + "/elf_bench_sections.o";
+
+        if (write_synthetic(symbols_path, 1, 8, options.synthetic_symbols)) synthetic_files.push_back(symbols_path);
+        if (write_synthetic(sections_path, 2, options.synthetic_sections, 1)) synthetic_files.push_back(sections_path);
+    }
+
+    files.insert(files.end(), synthetic_files.begin(), synthetic_files.end());
+
+    for (auto &file: files) bench_path(options, file);
+
+    for (auto &file: synthetic_files) unlink(file.c_str());
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+#ifndef ELF_ADDRESS_SPACE_HPP
+#define ELF_ADDRESS_SPACE_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+
+
+namespace elf {
+    /// virtual address to file translation over the PT_LOAD segments of an executable, a shared object or a core
+    /// file. The segments are kept in a flat array sorted by address, a read is a binary search and a pointer add.
+    template<typename USizeT>
+    class AddressSpace {
+    public:
+        using ELFHeaderT = ELFHeader<USizeT>;
+        using ProgramHeaderT = ProgramHeader<USizeT>;
+
+        /// [start, data_end) is backed by the file, [zero_start, end) reads as zero, and [data_end, zero_start) is
+        /// missing, cut from a truncated file or not dumped in a core file.
+        struct Segment {
+            USizeT start;
+            USizeT data_end;
+            USizeT zero_start;
+            USizeT end;
+            const u8 *data;
+        };
+
+    private:
+        std::vector<Segment> segments;
+
+        const Segment *find_segment(USizeT address) const {
+            auto iter = std::upper_bound(segments.begin(), segments.end(), address, [](USizeT val, const Segment &s) {
+                return val < s.start;
+            });
+
+            if (iter == segments.begin()) return nullptr;
+            --iter;
+            return address < iter->end ? &*iter : nullptr;
+        }
+
+    public:
+        /// index the loadable segments of `header`, `visitor` must outlive the address space. Segments overlapping
+        /// an earlier one are clipped, the earlier one wins. In core files the memory past the file size of a
+        /// segment was not dumped rather than zero, so it is missing.
+        static AddressSpace build(ELFHeaderT *header, MappedFileVisitor &visitor) {
+            AddressSpace space{};
+            bool is_core = header->file_type == ELFHeaderT::CORE;
+
+            for (auto &program: header->programs(visitor)) {
+                if (program.type != ProgramHeaderT::LOADABLE || program.mem_size == 0) continue;
+                if (program.virtual_address + program.mem_size < program.virtual_address) continue;
+
+                USizeT file_size = std::min(program.file_size, program.mem_size);
+                USizeT available = 0;
+                if (visitor.check_address(program.offset, 0)) {
+                    available = std::min<USizeT>(file_size, visitor.get_end() - program.offset);
+                }
+
+                space.segments.push_back(Segment{
+                        program.virtual_address, static_cast<USizeT>(program.virtual_address + available),
+                        static_cast<USizeT>(program.virtual_address + (is_core ? program.mem_size : file_size)),
+                        static_cast<USizeT>(program.virtual_address + program.mem_size),
+                        static_cast<const u8 *>(visitor.trusted_address(program.offset))
+                });
+            }
+
+            std::stable_sort(space.segments.begin(), space.segments.end(), [](const Segment &a, const Segment &b) {
+                return a.start < b.start;
+            });
+
+            usize num = 0;
+            for (usize i = 0; i < space.segments.size(); ++i) {
+                Segment segment = space.segments[i];
+
+                if (num > 0 && segment.start < space.segments[num - 1].end) {
+                    USizeT clip = space.segments[num - 1].end;
+                    if (clip >= segment.end) continue;
+
+                    segment.data += std::min(clip, segment.data_end) - segment.start;
+                    segment.data_end = std::max(segment.data_end, clip);
+                    segment.zero_start = std::max(segment.zero_start, clip);
+                    segment.start = clip;
+                }
+
+                space.segments[num++] = segment;
+            }
+            space.segments.resize(num);
+            space.segments.shrink_to_fit();
+
+            return space;
+        }
+
+        /// return the `len` bytes at `address` if they are contiguous in the file, nullptr otherwise: unmapped,
+        /// zero filled, missing from the file, or straddling two segments.
+        const u8 *read(USizeT address, usize len) const {
+            const Segment *segment = find_segment(address);
+            if (segment == nullptr || address >= segment->data_end || len > segment->data_end - address) return nullptr;
+            return segment->data + (address - segment->start);
+        }
+
+        /// like `read`, but fall back to copying into `scratch`, which must hold `len` bytes, when the range is zero
+        /// filled or spans adjacent segments. Return nullptr if any byte is unmapped or missing from the file.
+        const u8 *read(USizeT address, usize len, void *scratch) const {
+            const u8 *ptr = read(address, len);
+            if (ptr != nullptr || len == 0) return ptr;
+            return copy(address, scratch, len) ? static_cast<const u8 *>(scratch) : nullptr;
+        }
+
+        /// copy `len` bytes at `address` to `buffer`, return false if any byte is unmapped or missing from the file.
+        bool copy(USizeT address, void *buffer, usize len) const {
+            u8 *out = static_cast<u8 *>(buffer);
+
+            while (len > 0) {
+                const Segment *segment = find_segment(address);
+                if (segment == nullptr) return false;
+
+                usize num = std::min<usize>(len, segment->end - address);
+                if (address < segment->data_end) {
+                    num = std::min<usize>(num, segment->data_end - address);
+                    memcpy(out, segment->data + (address - segment->start), num);
+                } else if (address >= segment->zero_start) {
+                    memset(out, 0, num);
+                } else {
+                    return false;
+                }
+
+                out += num;
+                address += num;
+                len -= num;
+            }
+
+            return true;
+        }
+
+        /// read a value of `T` at `address`, e.g. to chase a pointer. Return false if it is not readable.
+        template<typename T>
+        bool read_value(USizeT address, T &val) const {
+            const u8 *ptr = read(address, sizeof(T));
+            if (ptr != nullptr) {
+                memcpy(&val, ptr, sizeof(T));
+                return true;
+            }
+            return copy(address, &val, sizeof(T));
+        }
+
+        /// file offset of `address`, return false if it is not backed by the file.
+        bool get_offset(USizeT address, const MappedFileVisitor &visitor, USizeT &offset) const {
+            const u8 *ptr = read(address, 1);
+            if (ptr == nullptr) return false;
+            auto *first = static_cast<const u8 *>(visitor.trusted_address(visitor.get_origin()));
+            offset = visitor.get_origin() + (ptr - first);
+            return true;
+        }
+
+        /// return nullptr if `address` is not in a loadable segment.
+        const Segment *find(USizeT address) const { return find_segment(address); }
+
+        const std::vector<Segment> &get_segments() const { return segments; }
+    };
+}
+
+namespace elf32 {
+    using AddressSpace = elf::AddressSpace<elf::u32>;
+}
+
+namespace elf64 {
+    using AddressSpace = elf::AddressSpace<elf::u64>;
+}
+
+
+#endif //ELF_ADDRESS_SPACE_HPP
@@ -0,0 +1,365 @@
+#ifndef ELF_ARCHIVE_HPP
+#define ELF_ARCHIVE_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+
+
+namespace elf {
+    /// view over an `ar` static library mapped by one `MappedFileVisitor`, members are never copied out. GNU and
+    /// BSD long names are resolved, the GNU ("/" and "/SYM64/") and BSD ("__.SYMDEF") symbol indices are read,
+    /// and thin archives, whose members are files next to the archive, are supported.
+    ///
+    /// Member data is only 2-byte aligned in the archive. The ELF structures are read in place, which the
+    /// architectures this library runs on tolerate.
+    class Archive {
+    public:
+        struct Member {
+            /// not NUL terminated, see `get_name`.
+            const char *name;
+            usize name_size;
+            /// file offset of the member header, which the symbol indices refer to.
+            u64 header_offset;
+            /// file offset and size of the content, the offset is 0 for members of thin archives.
+            u64 offset;
+            u64 size;
+
+            std::string get_name() const { return std::string{name, name_size}; }
+        };
+
+        struct Symbol {
+            const char *name;
+            usize member;
+        };
+
+        using SymbolIter = std::vector<Symbol>::const_iterator;
+
+    private:
+        static constexpr usize HEADER_SIZE = 60;
+
+        /// struct ar_hdr, every field is ASCII padded with spaces.
+        struct Header {
+            char name[16];
+            char date[12];
+            char user_id[6];
+            char group_id[6];
+            char mode[8];
+            char size[10];
+            char magic[2];
+        };
+
+        MappedFileVisitor *visitor;
+        bool thin;
+        /// directory of the archive with a trailing slash, thin members are relative to it.
+        std::string directory;
+        std::vector<Member> members;
+        std::vector<Symbol> symbols;
+        std::vector<MappedFileVisitor> thin_visitors;
+
+        static bool parse_decimal(const char *str, usize len, u64 &val) {
+            val = 0;
+            usize i = 0;
+            for (; i < len && str[i] >= '0' && str[i] <= '9'; ++i) {
+                if (val > (static_cast<u64>(-1) - 9) / 10) return false;
+                val = val * 10 + (str[i] - '0');
+            }
+            if (i == 0) return false;
+            for (; i < len; ++i) {
+                if (str[i] != ' ') return false;
+            }
+            return true;
+        }
+
+        static u64 read_word(const u8 *ptr, usize word) {
+            if (word == 8) {
+                u64 val;
+                memcpy(&val, ptr, sizeof(val));
+                return val;
+            }
+            u32 val;
+            memcpy(&val, ptr, sizeof(val));
+            return val;
+        }
+
+        static u64 read_big_endian(const u8 *ptr, usize len) {
+            u64 val = 0;
+            for (usize i = 0; i < len; ++i) val = val << 8 | ptr[i];
+            return val;
+        }
+
+        static bool is_name(const Header &header, const char *name) {
+            usize len = strlen(name);
+            if (memcmp(header.name, name, len) != 0) return false;
+            for (usize i = len; i < sizeof(header.name); ++i) {
+                if (header.name[i] != ' ') return false;
+            }
+            return true;
+        }
+
+        usize find_member(u64 header_offset) const {
+            auto iter = std::lower_bound(members.begin(), members.end(), header_offset,
+                                         [](const Member &member, u64 offset) {
+                                             return member.header_offset < offset;
+                                         });
+            if (iter == members.end() || iter->header_offset != header_offset) return members.size();
+            return iter - members.begin();
+        }
+
+        /// GNU index: a big endian count, that many big endian member offsets of `word` bytes, then the names.
+        static bool read_gnu_symbols(const u8 *data, u64 size, usize word,
+                                     std::vector<std::pair<const char *, u64>> &out) {
+            if (size < word) return false;
+            u64 num = read_big_endian(data, word);
+            if (num > (size - word) / word) return false;
+
+            const char *names = reinterpret_cast<const char *>(data + word + num * word);
+            const char *names_end = reinterpret_cast<const char *>(data + size);
+            for (u64 i = 0; i < num; ++i) {
+                const char *end = static_cast<const char *>(memchr(names, '\0', names_end - names));
+                if (end == nullptr) return false;
+                out.emplace_back(names, read_big_endian(data + word + i * word, word));
+                names = end + 1;
+            }
+            return true;
+        }
+
+        /// BSD index: the byte size of the ranlib array, {name offset, member offset} pairs in host order, the byte
+        /// size of the names, then the names.
+        static bool read_bsd_symbols(const u8 *data, u64 size, usize word,
+                                     std::vector<std::pair<const char *, u64>> &out) {
+            if (size < word) return false;
+            u64 array_size = read_word(data, word);
+            if (array_size % (2 * word) != 0 || array_size > size - word || size - word - array_size < word) {
+                return false;
+            }
+
+            const u8 *array = data + word;
+            const u8 *strings = array + array_size;
+            u64 string_size = read_word(strings, word);
+            strings += word;
+            if (string_size > static_cast<u64>(data + size - strings)) return false;
+
+            for (u64 i = 0; i < array_size / (2 * word); ++i) {
+                const u8 *entry = array + i * 2 * word;
+                u64 name = read_word(entry, word);
+                u64 offset = read_word(entry + word, word);
+                if (name >= string_size || memchr(strings + name, '\0', string_size - name) == nullptr) return false;
+                out.emplace_back(reinterpret_cast<const char *>(strings + name), offset);
+            }
+            return true;
+        }
+
+        template<typename USizeT>
+        static void index_member(MappedFileVisitor &member_visitor, usize member, std::vector<Symbol> &out) {
+            using SectionHeaderT = SectionHeader<USizeT>;
+            using SymbolTableHeaderT = _SymbolTableHeader<USizeT>;
+
+            ELFHeader<USizeT> *header = ELFHeader<USizeT>::read(member_visitor);
+            if (header == nullptr) return;
+
+            usize section_num = header->get_section_num(member_visitor);
+            auto sections = header->sections(member_visitor);
+            for (auto &section: sections) {
+                auto *table = SectionHeaderT::template cast<SymbolTableHeader<USizeT>>(&section, member_visitor);
+                if (table == nullptr || section.link >= section_num) continue;
+                auto *strings = SectionHeaderT::template cast<StringTableHeader<USizeT>>(&sections[section.link],
+                                                                                         member_visitor);
+                if (strings == nullptr) continue;
+
+                auto string_table = strings->get_table(member_visitor);
+                for (auto &symbol: table->get_table(member_visitor)) {
+                    if (symbol.get_bind() == SymbolTableHeaderT::LOCAL) continue;
+                    if (symbol.section_header_index == SectionHeaderT::INDEX_UNDEFINED) continue;
+
+                    const char *name = string_table.get_str(symbol.name, nullptr);
+                    if (name != nullptr && name[0] != '\0') out.push_back(Symbol{name, member});
+                }
+            }
+        }
+
+        static bool symbol_less(const Symbol &lhs, const Symbol &rhs) {
+            int ret = strcmp(lhs.name, rhs.name);
+            return ret < 0 || (ret == 0 && lhs.member < rhs.member);
+        }
+
+    public:
+        Archive() : visitor{nullptr}, thin{false}, directory{}, members{}, symbols{}, thin_visitors{} {}
+
+        /// return true if `visitor` maps an archive or a thin archive.
+        static bool is_archive(MappedFileVisitor &visitor) {
+            auto *magic = static_cast<const char *>(visitor.address(0, 8));
+            return magic != nullptr && (memcmp(magic, "!<arch>\n", 8) == 0 || memcmp(magic, "!<thin>\n", 8) == 0);
+        }
+
+        /// read the member list and the symbol index of the archive mapped by `visitor`, which must outlive
+        /// `archive`. `path` is the path of the archive, only needed to find the members of thin archives. Return
+        /// false if the archive is malformed.
+        static bool read(MappedFileVisitor &visitor, Archive &archive, const char *path = nullptr) {
+            archive = Archive{};
+            if (!is_archive(visitor)) return false;
+
+            archive.visitor = &visitor;
+            archive.thin = memcmp(visitor.address(0, 8), "!<thin>\n", 8) == 0;
+            if (path != nullptr) {
+                const char *slash = strrchr(path, '/');
+                if (slash != nullptr) archive.directory.assign(path, slash + 1);
+            }
+
+            const char *long_names = nullptr;
+            u64 long_names_size = 0;
+            std::vector<std::pair<const char *, u64>> index;
+
+            u64 offset = 8;
+            u64 end = visitor.get_end();
+            while (offset < end) {
+                auto *header = static_cast<const Header *>(visitor.address(offset, HEADER_SIZE));
+                if (header == nullptr || header->magic[0] != '`' || header->magic[1] != '\n') return false;
+
+                u64 size = 0;
+                if (!parse_decimal(header->size, sizeof(header->size), size)) return false;
+
+                u64 data_offset = offset + HEADER_SIZE;
+                bool special = header->name[0] == '/' && (header->name[1] == ' ' || header->name[1] == '/' ||
+                                                          memcmp(header->name, "/SYM64/", 7) == 0);
+                bool bsd_index = memcmp(header->name, "__.SYMDEF", 9) == 0;
+                bool has_data = !archive.thin || special;
+                if (has_data && !visitor.check_address(data_offset, size)) return false;
+                auto *data = static_cast<const u8 *>(visitor.trusted_address(data_offset));
+
+                Member member{header->name, sizeof(header->name), offset, data_offset, size};
+                if (is_name(*header, "/")) {
+                    if (!archive.read_gnu_symbols(data, size, 4, index)) return false;
+                } else if (is_name(*header, "/SYM64/")) {
+                    if (!archive.read_gnu_symbols(data, size, 8, index)) return false;
+                } else if (is_name(*header, "//")) {
+                    long_names = reinterpret_cast<const char *>(data);
+                    long_names_size = size;
+                } else if (header->name[0] == '/' && header->name[1] >= '0' && header->name[1] <= '9') {
+                    u64 name_offset = 0;
+                    if (!parse_decimal(header->name + 1, sizeof(header->name) - 1, name_offset)) return false;
+                    if (long_names == nullptr || name_offset >= long_names_size) return false;
+
+                    member.name = long_names + name_offset;
+                    auto *name_end = static_cast<const char *>(memchr(member.name, '\n',
+                                                                      long_names_size - name_offset));
+                    member.name_size = name_end == nullptr ? long_names_size - name_offset : name_end - member.name;
+                    if (member.name_size > 0 && member.name[member.name_size - 1] == '/') --member.name_size;
+                } else if (memcmp(header->name, "#1/", 3) == 0) {
+                    /// BSD long name, stored at the start of the content.
+                    u64 name_size = 0;
+                    if (!parse_decimal(header->name + 3, sizeof(header->name) - 3, name_size)) return false;
+                    if (name_size > size) return false;
+
+                    member.name = reinterpret_cast<const char *>(data);
+                    member.name_size = strnlen(member.name, name_size);
+                    member.offset += name_size;
+                    member.size -= name_size;
+
+                    if (member.name_size >= 9 && memcmp(member.name, "__.SYMDEF", 9) == 0) {
+                        bsd_index = true;
+                        data += name_size;
+                    }
+                } else {
+                    while (member.name_size > 0 && member.name[member.name_size - 1] == ' ') --member.name_size;
+                    if (member.name_size > 0 && member.name[member.name_size - 1] == '/') --member.name_size;
+                }
+
+                if (bsd_index) {
+                    bool is_64 = memmem(member.name, member.name_size, "_64", 3) != nullptr;
+                    if (!archive.read_bsd_symbols(data, member.size, is_64 ? 8 : 4, index)) return false;
+                } else if (!special) {
+                    if (archive.thin) member.offset = 0;
+                    archive.members.push_back(member);
+                }
+
+                offset = data_offset + (has_data ? size : 0);
+                offset += offset & 1;
+            }
+
+            for (auto &entry: index) {
+                usize member = archive.find_member(entry.second);
+                if (member == archive.members.size()) return false;
+                archive.symbols.push_back(Symbol{entry.first, member});
+            }
+
+            if (archive.thin) {
+                archive.thin_visitors.resize(archive.members.size());
+                for (usize i = 0; i < archive.members.size(); ++i) {
+                    const Member &member = archive.members[i];
+                    std::string name = member.get_name();
+                    if (name.empty() || name[0] != '/') name = archive.directory + name;
+                    archive.thin_visitors[i] = MappedFileVisitor::open_elf(name.c_str());
+                }
+            }
+
+            return true;
+        }
+
+        bool is_thin() const { return thin; }
+
+        const std::vector<Member> &get_members() const { return members; }
+
+        /// the symbol index of the archive, in archive order, empty if the archive has none.
+        const std::vector<Symbol> &get_symbols() const { return symbols; }
+
+        /// visitor over the content of the `index`-th member, for `ELFHeader::read` with member relative offsets.
+        /// It borrows from the archive mapping, or for thin archives from the mapping of the member file, which
+        /// lives as long as the archive.
+        MappedFileVisitor get_member_visitor(usize index) {
+            const Member &member = members[index];
+            if (thin) {
+                MappedFileVisitor &file = thin_visitors[index];
+                return MappedFileVisitor::borrow(file.address(0, file.get_size()), file.get_size());
+            }
+            return MappedFileVisitor::borrow(visitor->trusted_address(member.offset), member.size);
+        }
+
+        /// index the defined global symbols of every ELF member from their own symbol tables, on `thread_num`
+        /// threads, 0 for one per hardware thread. This does not trust the archive index, which may be stale or
+        /// missing. `out` is sorted by name, then member.
+        void build_symbol_index(std::vector<Symbol> &out, usize thread_num = 0) {
+            thread_num = thread_count(thread_num, members.size());
+
+            std::vector<std::vector<Symbol>> partial(thread_num);
+            parallel_for(members.size(), thread_num, [&](usize index, usize thread) {
+                MappedFileVisitor member_visitor = get_member_visitor(index);
+                switch (get_elf_class(member_visitor)) {
+                    case 1:
+                        index_member<u32>(member_visitor, index, partial[thread]);
+                        break;
+                    case 2:
+                        index_member<u64>(member_visitor, index, partial[thread]);
+                        break;
+                    default:
+                        break;
+                }
+            });
+            parallel_for(partial.size(), thread_num, [&](usize index, usize) {
+                std::sort(partial[index].begin(), partial[index].end(), symbol_less);
+            });
+
+            out.clear();
+            for (auto &symbols: partial) {
+                usize middle = out.size();
+                out.insert(out.end(), symbols.begin(), symbols.end());
+                std::inplace_merge(out.begin(), out.begin() + middle, out.end(), symbol_less);
+            }
+        }
+
+        /// the entries of `name` in `index`, a result of `build_symbol_index`, one per member defining it.
+        static std::pair<SymbolIter, SymbolIter> find_symbol(const std::vector<Symbol> &index, const char *name) {
+            return std::equal_range(index.begin(), index.end(), Symbol{name, 0}, [](const Symbol &a, const Symbol &b) {
+                return strcmp(a.name, b.name) < 0;
+            });
+        }
+    };
+}
+
+
+#endif //ELF_ARCHIVE_HPP
@@ -0,0 +1,128 @@
+#ifndef ELF_BYTE_READER_HPP
+#define ELF_BYTE_READER_HPP
+
+
+#include <cstring>
+
+#include "elf_utility.hpp"
+
+
+namespace elf {
+    /// bounds checked cursor over a byte range in host byte order, for the variable length encodings of
+    /// .eh_frame and DWARF. A read past the end returns zero and marks the reader as failed, so a parser can read
+    /// a whole record and check `is_valid` once.
+    class ByteReader {
+    private:
+        const u8 *data;
+        usize size;
+        usize position;
+        bool valid;
+
+    public:
+        ByteReader() : data{nullptr}, size{0}, position{0}, valid{true} {}
+
+        ByteReader(const void *data, usize size) :
+                data{static_cast<const u8 *>(data)}, size{size}, position{0}, valid{true} {}
+
+        bool is_valid() const { return valid; }
+
+        usize get_position() const { return position; }
+
+        usize get_size() const { return size; }
+
+        usize remain() const { return size - position; }
+
+        const u8 *get_data() const { return data; }
+
+        /// move to `new_position`, which may be the end but not past it.
+        void seek(usize new_position) {
+            if (new_position > size) {
+                valid = false;
+                position = size;
+                return;
+            }
+            position = new_position;
+        }
+
+        void skip(usize len) {
+            if (len > remain()) {
+                valid = false;
+                position = size;
+                return;
+            }
+            position += len;
+        }
+
+        template<typename T>
+        T read() {
+            T val{};
+            if (sizeof(T) > remain()) {
+                valid = false;
+                position = size;
+                return val;
+            }
+            memcpy(&val, data + position, sizeof(T));
+            position += sizeof(T);
+            return val;
+        }
+
+        /// an unsigned value of `len` bytes, 1, 2, 4 or 8.
+        u64 read_unsigned(usize len) {
+            switch (len) {
+                case 1:
+                    return read<u8>();
+                case 2:
+                    return read<u16>();
+                case 4:
+                    return read<u32>();
+                case 8:
+                    return read<u64>();
+                default:
+                    valid = false;
+                    return 0;
+            }
+        }
+
+        u64 read_uleb128() {
+            u64 val = 0;
+            for (u32 shift = 0; position < size; shift += 7) {
+                u8 byte = data[position++];
+                if (shift < 64) val |= static_cast<u64>(byte & 0x7fu) << shift;
+                if ((byte & 0x80u) == 0) return val;
+            }
+            valid = false;
+            return 0;
+        }
+
+        i64 read_sleb128() {
+            u64 val = 0;
+            for (u32 shift = 0; position < size;) {
+                u8 byte = data[position++];
+                if (shift < 64) val |= static_cast<u64>(byte & 0x7fu) << shift;
+                shift += 7;
+                if ((byte & 0x80u) == 0) {
+                    if (shift < 64 && (byte & 0x40u) != 0) val |= ~static_cast<u64>(0) << shift;
+                    return static_cast<i64>(val);
+                }
+            }
+            valid = false;
+            return 0;
+        }
+
+        /// a zero terminated string, nullptr if it runs past the end.
+        const char *read_str() {
+            const char *str = reinterpret_cast<const char *>(data + position);
+            usize len = strnlen(str, remain());
+            if (len == remain()) {
+                valid = false;
+                position = size;
+                return nullptr;
+            }
+            position += len + 1;
+            return str;
+        }
+    };
+}
+
+
+#endif //ELF_BYTE_READER_HPP
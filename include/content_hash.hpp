@@ -0,0 +1,361 @@
+#ifndef ELF_CONTENT_HASH_HPP
+#define ELF_CONTENT_HASH_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+
+
+namespace elf {
+    /// XXH3 64-bit with seed 0 and the default secret, bit-exact with the reference implementation so that hashes
+    /// can be compared with other tools. The long input loop uses SSE2 where available.
+    class XXH3 {
+    private:
+        static constexpr u64 PRIME32_1 = 0x9E3779B1u;
+        static constexpr u64 PRIME32_2 = 0x85EBCA77u;
+        static constexpr u64 PRIME32_3 = 0xC2B2AE3Du;
+        static constexpr u64 PRIME64_1 = 0x9E3779B185EBCA87u;
+        static constexpr u64 PRIME64_2 = 0xC2B2AE3D27D4EB4Fu;
+        static constexpr u64 PRIME64_3 = 0x165667B19E3779F9u;
+        static constexpr u64 PRIME64_4 = 0x85EBCA77C2B2AE63u;
+        static constexpr u64 PRIME64_5 = 0x27D4EB2F165667C5u;
+        static constexpr u64 PRIME_MX1 = 0x165667919E3779F9u;
+        static constexpr u64 PRIME_MX2 = 0x9FB21C651E98DF25u;
+
+        static constexpr usize SECRET_SIZE = 192;
+        static constexpr usize STRIPE_SIZE = 64;
+        static constexpr usize STRIPE_NUM = (SECRET_SIZE - STRIPE_SIZE) / 8;
+        static constexpr usize BLOCK_SIZE = STRIPE_SIZE * STRIPE_NUM;
+
+        static const u8 *secret() {
+            alignas(64) static const u8 SECRET[SECRET_SIZE] = {
+                    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+                    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+                    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+                    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+                    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+                    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+                    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+                    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+                    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+                    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+                    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+                    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+            };
+            return SECRET;
+        }
+
+        static u32 read32(const u8 *ptr) {
+            u32 val;
+            memcpy(&val, ptr, sizeof(val));
+            return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? val : byte_swap(val);
+        }
+
+        static u64 read64(const u8 *ptr) {
+            u64 val;
+            memcpy(&val, ptr, sizeof(val));
+            return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? val : byte_swap(val);
+        }
+
+        static u64 rotate_left(u64 val, u32 bits) { return (val << bits) | (val >> (64 - bits)); }
+
+        static u64 multiply_fold(u64 lhs, u64 rhs) {
+#if defined(__SIZEOF_INT128__)
+            unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+            return static_cast<u64>(product) ^ static_cast<u64>(product >> 64);
+#else
+            u64 lo_lo = (lhs & 0xffffffffu) * (rhs & 0xffffffffu);
+            u64 hi_lo = (lhs >> 32) * (rhs & 0xffffffffu);
+            u64 lo_hi = (lhs & 0xffffffffu) * (rhs >> 32);
+            u64 hi_hi = (lhs >> 32) * (rhs >> 32);
+            u64 cross = (lo_lo >> 32) + (hi_lo & 0xffffffffu) + lo_hi;
+            u64 upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+            u64 lower = (cross << 32) | (lo_lo & 0xffffffffu);
+            return lower ^ upper;
+#endif
+        }
+
+        static u64 avalanche64(u64 hash) {
+            hash ^= hash >> 33;
+            hash *= PRIME64_2;
+            hash ^= hash >> 29;
+            hash *= PRIME64_3;
+            hash ^= hash >> 32;
+            return hash;
+        }
+
+        static u64 avalanche(u64 hash) {
+            hash ^= hash >> 37;
+            hash *= PRIME_MX1;
+            hash ^= hash >> 32;
+            return hash;
+        }
+
+        static u64 rrmxmx(u64 hash, u64 len) {
+            hash ^= rotate_left(hash, 49) ^ rotate_left(hash, 24);
+            hash *= PRIME_MX2;
+            hash ^= (hash >> 35) + len;
+            hash *= PRIME_MX2;
+            return hash ^ (hash >> 28);
+        }
+
+        static u64 mix16(const u8 *input, const u8 *key) {
+            return multiply_fold(read64(input) ^ read64(key), read64(input + 8) ^ read64(key + 8));
+        }
+
+        static u64 hash_short(const u8 *input, usize len) {
+            const u8 *key = secret();
+
+            if (len > 8) {
+                u64 lo = read64(input) ^ (read64(key + 24) ^ read64(key + 32));
+                u64 hi = read64(input + len - 8) ^ (read64(key + 40) ^ read64(key + 48));
+                return avalanche(len + byte_swap(lo) + hi + multiply_fold(lo, hi));
+            }
+            if (len >= 4) {
+                u64 val = read32(input + len - 4) + (static_cast<u64>(read32(input)) << 32);
+                return rrmxmx(val ^ (read64(key + 8) ^ read64(key + 16)), len);
+            }
+            if (len > 0) {
+                u32 combined = (static_cast<u32>(input[0]) << 16) | (static_cast<u32>(input[len >> 1]) << 24) |
+                               static_cast<u32>(input[len - 1]) | (static_cast<u32>(len) << 8);
+                return avalanche64(combined ^ static_cast<u64>(read32(key) ^ read32(key + 4)));
+            }
+            return avalanche64(read64(key + 56) ^ read64(key + 64));
+        }
+
+        static u64 hash_medium(const u8 *input, usize len) {
+            const u8 *key = secret();
+            u64 acc = len * PRIME64_1;
+
+            if (len <= 128) {
+                if (len > 32) {
+                    if (len > 64) {
+                        if (len > 96) {
+                            acc += mix16(input + 48, key + 96);
+                            acc += mix16(input + len - 64, key + 112);
+                        }
+                        acc += mix16(input + 32, key + 64);
+                        acc += mix16(input + len - 48, key + 80);
+                    }
+                    acc += mix16(input + 16, key + 32);
+                    acc += mix16(input + len - 32, key + 48);
+                }
+                acc += mix16(input, key);
+                acc += mix16(input + len - 16, key + 16);
+                return avalanche(acc);
+            }
+
+            for (usize i = 0; i < 8; ++i) acc += mix16(input + 16 * i, key + 16 * i);
+            u64 acc_end = mix16(input + len - 16, key + 136 - 17);
+            acc = avalanche(acc);
+            for (usize i = 8; i < len / 16; ++i) acc_end += mix16(input + 16 * i, key + 16 * (i - 8) + 3);
+            return avalanche(acc + acc_end);
+        }
+
+        static void accumulate_stripe(u64 *acc, const u8 *input, const u8 *key) {
+#if defined(__SSE2__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            auto *lanes = reinterpret_cast<__m128i *>(acc);
+            for (usize i = 0; i < STRIPE_SIZE / 16; ++i) {
+                __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input) + i);
+                __m128i data_key = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i *>(key) + i));
+                __m128i product = _mm_mul_epu32(data_key, _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)));
+                __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                lanes[i] = _mm_add_epi64(product, _mm_add_epi64(lanes[i], swapped));
+            }
+#else
+            for (usize i = 0; i < 8; ++i) {
+                u64 data = read64(input + 8 * i);
+                u64 data_key = data ^ read64(key + 8 * i);
+                acc[i ^ 1u] += data;
+                acc[i] += (data_key & 0xffffffffu) * (data_key >> 32);
+            }
+#endif
+        }
+
+        static void scramble(u64 *acc, const u8 *key) {
+#if defined(__SSE2__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            auto *lanes = reinterpret_cast<__m128i *>(acc);
+            const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+            for (usize i = 0; i < STRIPE_SIZE / 16; ++i) {
+                __m128i val = _mm_xor_si128(lanes[i], _mm_srli_epi64(lanes[i], 47));
+                val = _mm_xor_si128(val, _mm_loadu_si128(reinterpret_cast<const __m128i *>(key) + i));
+                __m128i product_lo = _mm_mul_epu32(val, prime);
+                __m128i product_hi = _mm_mul_epu32(_mm_shuffle_epi32(val, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+                lanes[i] = _mm_add_epi64(product_lo, _mm_slli_epi64(product_hi, 32));
+            }
+#else
+            for (usize i = 0; i < 8; ++i) {
+                u64 val = acc[i];
+                val ^= val >> 47;
+                val ^= read64(key + 8 * i);
+                acc[i] = val * PRIME32_1;
+            }
+#endif
+        }
+
+        static u64 hash_long(const u8 *input, usize len) {
+            const u8 *key = secret();
+            alignas(16) u64 acc[8] = {PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5,
+                                      PRIME32_1};
+
+            usize block_num = (len - 1) / BLOCK_SIZE;
+            for (usize block = 0; block < block_num; ++block) {
+                for (usize stripe = 0; stripe < STRIPE_NUM; ++stripe) {
+                    accumulate_stripe(acc, input + block * BLOCK_SIZE + stripe * STRIPE_SIZE, key + stripe * 8);
+                }
+                scramble(acc, key + SECRET_SIZE - STRIPE_SIZE);
+            }
+
+            usize stripe_num = ((len - 1) - block_num * BLOCK_SIZE) / STRIPE_SIZE;
+            for (usize stripe = 0; stripe < stripe_num; ++stripe) {
+                accumulate_stripe(acc, input + block_num * BLOCK_SIZE + stripe * STRIPE_SIZE, key + stripe * 8);
+            }
+            accumulate_stripe(acc, input + len - STRIPE_SIZE, key + SECRET_SIZE - STRIPE_SIZE - 7);
+
+            u64 result = len * PRIME64_1;
+            for (usize i = 0; i < 4; ++i) {
+                result += multiply_fold(acc[2 * i] ^ read64(key + 11 + 16 * i),
+                                        acc[2 * i + 1] ^ read64(key + 19 + 16 * i));
+            }
+            return avalanche(result);
+        }
+
+    public:
+        static u64 hash(const void *data, usize len) {
+            auto *input = static_cast<const u8 *>(data);
+            if (len <= 16) return hash_short(input, len);
+            if (len <= 240) return hash_medium(input, len);
+            return hash_long(input, len);
+        }
+    };
+
+    /// content hashes of byte ranges, the ones larger than `CHUNK_SIZE` are cut in chunks hashed in parallel. The
+    /// hash of a range is XXH3 of its content if it fits in a chunk, and XXH3 of the little endian array of its
+    /// chunk hashes otherwise, so it does not depend on the number of threads.
+    class ContentHasher {
+    public:
+        static constexpr usize CHUNK_SIZE = 4 * 1024 * 1024;
+
+        struct Range {
+            const void *data;
+            u64 size;
+        };
+
+    private:
+        struct Task {
+            usize range;
+            u64 offset;
+            usize size;
+            u64 *result;
+        };
+
+        static u64 combine(const std::vector<u64> &chunk_hashes) {
+            if (chunk_hashes.size() == 1) return chunk_hashes[0];
+
+            std::vector<u64> bytes(chunk_hashes.size());
+            for (usize i = 0; i < bytes.size(); ++i) {
+                bytes[i] = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? chunk_hashes[i] : byte_swap(chunk_hashes[i]);
+            }
+            return XXH3::hash(bytes.data(), bytes.size() * sizeof(u64));
+        }
+
+    public:
+        /// hash of one range on the calling thread.
+        static u64 hash(const void *data, u64 size) {
+            std::vector<Range> ranges{Range{data, size}};
+            std::vector<u64> hashes;
+            hash(ranges, hashes, 1);
+            return hashes[0];
+        }
+
+        /// `hashes[i]` receives the hash of `ranges[i]`. 0 threads means one per hardware thread.
+        static void hash(const std::vector<Range> &ranges, std::vector<u64> &hashes, usize thread_num) {
+            std::vector<std::vector<u64>> chunk_hashes(ranges.size());
+            std::vector<Task> tasks;
+
+            for (usize i = 0; i < ranges.size(); ++i) {
+                u64 chunk_num = ranges[i].size == 0 ? 1 : (ranges[i].size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+                chunk_hashes[i].resize(chunk_num);
+                for (u64 chunk = 0; chunk < chunk_num; ++chunk) {
+                    u64 offset = chunk * CHUNK_SIZE;
+                    usize size = std::min<u64>(u64{CHUNK_SIZE}, ranges[i].size - offset);
+                    tasks.push_back(Task{i, offset, size, &chunk_hashes[i][chunk]});
+                }
+            }
+
+            parallel_for(tasks.size(), thread_num, [&](usize index, usize) {
+                const Task &task = tasks[index];
+                auto *data = static_cast<const u8 *>(ranges[task.range].data);
+                *task.result = XXH3::hash(data + task.offset, task.size);
+            });
+
+            hashes.resize(ranges.size());
+            for (usize i = 0; i < ranges.size(); ++i) hashes[i] = combine(chunk_hashes[i]);
+        }
+    };
+
+    /// per-file content manifest for deduplication across builds: one entry per section and per segment.
+    struct ManifestEntry {
+        /// name of the section, or "segment[<index>]" for segments.
+        std::string name;
+        u64 size;
+        /// `ContentHasher` hash of the content in the file, of nothing for NO_BITS sections.
+        u64 hash;
+    };
+
+    /// hash every section of `header`, and every segment if `segments` is set. Sections and segments out of the
+    /// file are skipped. 0 threads means one per hardware thread.
+    template<typename USizeT>
+    std::vector<ManifestEntry> build_manifest(ELFHeader<USizeT> *header, MappedFileVisitor &visitor, bool segments,
+                                              usize thread_num) {
+        using SectionHeaderT = SectionHeader<USizeT>;
+
+        std::vector<ManifestEntry> entries;
+        std::vector<ContentHasher::Range> ranges;
+
+        auto *name_header = header->sections(visitor).size() == 0 ? nullptr :
+                            header->get_section_string_table_header(visitor);
+
+        for (auto &section: header->sections(visitor)) {
+            if (section.section_type == SectionHeaderT::SECTION_NULL) continue;
+
+            u64 size = section.section_type == SectionHeaderT::NO_BITS ? 0 : section.size;
+            const void *data = visitor.address(section.offset, size);
+            if (data == nullptr) continue;
+
+            const char *name = name_header == nullptr ? "" : name_header->get_table(visitor).get_str(section.name);
+            entries.push_back(ManifestEntry{name == nullptr ? "[unnamed]" : name, section.size, 0});
+            ranges.push_back(ContentHasher::Range{data, size});
+        }
+
+        if (segments) {
+            usize index = 0;
+            for (auto &program: header->programs(visitor)) {
+                const void *data = visitor.address(program.offset, program.file_size);
+                if (program.type != ProgramHeader<USizeT>::PROGRAM_NULL && data != nullptr) {
+                    entries.push_back(ManifestEntry{"segment[" + std::to_string(index) + "]", program.file_size, 0});
+                    ranges.push_back(ContentHasher::Range{data, program.file_size});
+                }
+                ++index;
+            }
+        }
+
+        std::vector<u64> hashes;
+        ContentHasher::hash(ranges, hashes, thread_num);
+        for (usize i = 0; i < entries.size(); ++i) entries[i].hash = hashes[i];
+
+        return entries;
+    }
+}
+
+
+#endif //ELF_CONTENT_HASH_HPP
@@ -0,0 +1,337 @@
+#ifndef ELF_CORE_FILE_HPP
+#define ELF_CORE_FILE_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+#include "note.hpp"
+
+
+namespace elf {
+    /// view of a Linux core file built from a single walk over its PT_NOTE segments. Threads, process information,
+    /// the auxiliary vector and the mapped file table are kept as compact records pointing into the mapped file,
+    /// nothing else of the file is touched, so the cost does not depend on the size of the dumped memory.
+    template<typename USizeT>
+    class CoreFile {
+    public:
+        using ELFHeaderT = ELFHeader<USizeT>;
+        using ProgramHeaderT = ProgramHeader<USizeT>;
+
+        elf_enum_display(RegisterKind, u8, 3,
+                         PROGRAM_COUNTER, 0,
+                         STACK_POINTER, 1,
+                         FRAME_POINTER, 2
+        );
+
+        /// one NT_PRSTATUS note, and the NT_FPREGSET note following it.
+        struct Thread {
+            i32 pid;
+            /// signal that stopped the thread, 0 if none.
+            i32 signal;
+            /// `pr_reg`, the general purpose registers in the layout of the machine's `user_regs_struct`.
+            const u8 *registers;
+            usize register_num;
+            /// nullptr if the thread has no floating point registers note.
+            const u8 *fp_registers;
+            usize fp_register_size;
+
+            USizeT get_register(usize index) const {
+                USizeT val = 0;
+                if (index < register_num) memcpy(&val, registers + index * sizeof(USizeT), sizeof(USizeT));
+                return val;
+            }
+        };
+
+        /// NT_PRPSINFO.
+        struct ProcessInfo {
+            /// `pr_sname`, the state as in `/proc/<pid>/stat`, like 'R' or 'S'.
+            char state;
+            i32 pid;
+            i32 parent_pid;
+            i32 group_id;
+            i32 session_id;
+            u32 user_id;
+            u32 group_user_id;
+            /// executable name, truncated to 15 characters by the kernel.
+            char name[17];
+            /// start of the command line, arguments separated by spaces.
+            char arguments[81];
+        };
+
+        /// entry of NT_AUXV, `type` is one of the AT_* constants.
+        struct AuxEntry {
+            USizeT type;
+            USizeT val;
+        };
+
+        /// entry of NT_FILE, a file backed mapping of the dumped process.
+        struct Mapping {
+            USizeT start;
+            USizeT end;
+            /// offset in the file, in bytes.
+            USizeT offset;
+            const char *path;
+        };
+
+    private:
+        MappedFileVisitor *visitor;
+        ELFHeaderT *header;
+        std::vector<Thread> threads;
+        std::vector<Mapping> mappings;
+        ProcessInfo process;
+        bool has_process;
+        const u8 *aux_vector;
+        usize aux_num;
+        USizeT page_size;
+
+        /// notes of core files are only aligned to 4 bytes, even in ELF64 files.
+        template<typename T>
+        static T load(const u8 *ptr) {
+            T val;
+            memcpy(&val, ptr, sizeof(T));
+            return val;
+        }
+
+        /// `elf_prstatus`: siginfo, the current signal padded to a word, two signal sets, four ids and four
+        /// timevals of two words precede `pr_reg`, which is followed by the `pr_fpvalid` int padded to a word.
+        bool parse_status(const Note &note, usize alignment) {
+            static constexpr usize WORD = sizeof(USizeT);
+            static constexpr usize PID_OFFSET = 16 + 2 * WORD;
+            static constexpr usize REGISTER_OFFSET = PID_OFFSET + 16 + 8 * WORD;
+            static constexpr usize TAIL = WORD == 8 ? 8 : 4;
+
+            if (note.desc_size < REGISTER_OFFSET + TAIL + WORD) return false;
+
+            const u8 *desc = note.get_desc(alignment);
+            Thread thread{};
+            thread.pid = load<i32>(desc + PID_OFFSET);
+            thread.signal = load<i16>(desc + 12);
+            thread.registers = desc + REGISTER_OFFSET;
+            thread.register_num = (note.desc_size - REGISTER_OFFSET - TAIL) / WORD;
+            threads.push_back(thread);
+
+            return true;
+        }
+
+        /// `elf_prpsinfo`: four chars, the flags word, user and group ids, whose size depends on the architecture,
+        /// four ids, then `pr_fname[16]` and `pr_psargs[80]`.
+        bool parse_process(const Note &note, usize alignment) {
+            static constexpr usize WORD = sizeof(USizeT);
+            static constexpr usize ID_OFFSET = WORD == 8 ? 16 : 8;
+
+            if (note.desc_size < ID_OFFSET + 4 + 16 + 16 + 80) return false;
+
+            const u8 *desc = note.get_desc(alignment);
+            usize name_offset = note.desc_size - 96;
+            usize pid_offset = name_offset - 16;
+            usize id_size = (pid_offset - ID_OFFSET) / 2;
+            if (id_size != 2 && id_size != 4) return false;
+
+            process.state = static_cast<char>(desc[1]);
+            process.user_id = id_size == 2 ? load<u16>(desc + ID_OFFSET) : load<u32>(desc + ID_OFFSET);
+            process.group_user_id = id_size == 2 ? load<u16>(desc + ID_OFFSET + 2) : load<u32>(desc + ID_OFFSET + 4);
+            process.pid = load<i32>(desc + pid_offset);
+            process.parent_pid = load<i32>(desc + pid_offset + 4);
+            process.group_id = load<i32>(desc + pid_offset + 8);
+            process.session_id = load<i32>(desc + pid_offset + 12);
+            memcpy(process.name, desc + name_offset, 16);
+            process.name[16] = '\0';
+            memcpy(process.arguments, desc + name_offset + 16, 80);
+            process.arguments[80] = '\0';
+            has_process = true;
+
+            return true;
+        }
+
+        /// NT_FILE: the number of entries and the page size, then start, end and offset in pages of every entry,
+        /// then the paths, each terminated by a zero.
+        bool parse_files(const Note &note, usize alignment) {
+            static constexpr usize WORD = sizeof(USizeT);
+
+            if (note.desc_size < 2 * WORD) return false;
+
+            const u8 *desc = note.get_desc(alignment);
+            USizeT num = load<USizeT>(desc);
+            page_size = load<USizeT>(desc + WORD);
+            if (num > (note.desc_size - 2 * WORD) / (3 * WORD)) return false;
+
+            const char *path = reinterpret_cast<const char *>(desc + 2 * WORD + 3 * WORD * num);
+            const char *limit = reinterpret_cast<const char *>(desc + note.desc_size);
+
+            mappings.reserve(mappings.size() + num);
+            for (usize i = 0; i < num; ++i) {
+                const u8 *entry = desc + 2 * WORD + 3 * WORD * i;
+                usize len = strnlen(path, limit - path);
+                if (len == static_cast<usize>(limit - path)) return false;
+
+                mappings.push_back(Mapping{load<USizeT>(entry), load<USizeT>(entry + WORD),
+                                           static_cast<USizeT>(load<USizeT>(entry + 2 * WORD) * page_size), path});
+                path += len + 1;
+            }
+
+            return true;
+        }
+
+        static bool get_register_index(typename ELFHeaderT::MachineType machine, RegisterKind kind, usize &index) {
+            /// indices of the program counter, stack pointer and frame pointer in `user_regs_struct`.
+            static const usize x86_64[] = {16, 19, 4};
+            static const usize i386[] = {12, 15, 5};
+            static const usize aarch64[] = {32, 31, 29};
+            static const usize arm[] = {15, 13, 11};
+            static const usize riscv[] = {0, 2, 8};
+
+            switch (machine) {
+                case ELFHeaderT::X86_64:
+                    index = x86_64[kind];
+                    return true;
+                case ELFHeaderT::INTEL_80386:
+                    index = i386[kind];
+                    return true;
+                case ELFHeaderT::AARCH64:
+                    index = aarch64[kind];
+                    return true;
+                case ELFHeaderT::ARM:
+                    index = arm[kind];
+                    return true;
+                case ELFHeaderT::RISCV:
+                    index = riscv[kind];
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+    public:
+        CoreFile() : visitor{nullptr}, header{nullptr}, process{}, has_process{false}, aux_vector{nullptr}, aux_num{0},
+                     page_size{0} {}
+
+        /// walk the notes of a core file in host byte order, return false if `visitor` is not one or a note is
+        /// malformed. `visitor` must outlive `core`.
+        static bool read(MappedFileVisitor &visitor, CoreFile &core) {
+            core = CoreFile{};
+
+            ELFHeaderT *header = ELFHeaderT::read(visitor);
+            if (header == nullptr || header->file_type != ELFHeaderT::CORE) return false;
+            if (get_elf_class(visitor) != (sizeof(USizeT) == 8 ? 2 : 1)) return false;
+
+            core.visitor = &visitor;
+            core.header = header;
+
+            for (auto &program: header->programs(visitor)) {
+                auto *note_header = ProgramHeaderT::template cast<NoteHeader<USizeT>>(&program, visitor);
+                if (note_header == nullptr) continue;
+
+                auto notes = note_header->get_table(visitor);
+                for (auto &note: notes) {
+                    if (!note.is_name("CORE")) continue;
+
+                    bool success = true;
+                    switch (note.type) {
+                        case Note::CORE_PRSTATUS:
+                            success = core.parse_status(note, notes.get_alignment());
+                            break;
+                        case Note::CORE_FPREGSET:
+                            if (!core.threads.empty() && core.threads.back().fp_registers == nullptr) {
+                                core.threads.back().fp_registers = note.get_desc(notes.get_alignment());
+                                core.threads.back().fp_register_size = note.desc_size;
+                            }
+                            break;
+                        case Note::CORE_PRPSINFO:
+                            success = core.parse_process(note, notes.get_alignment());
+                            break;
+                        case Note::CORE_AUXV:
+                            core.aux_vector = note.get_desc(notes.get_alignment());
+                            core.aux_num = note.desc_size / sizeof(AuxEntry);
+                            break;
+                        case Note::CORE_FILE:
+                            success = core.parse_files(note, notes.get_alignment());
+                            break;
+                        default:
+                            break;
+                    }
+
+                    if (!success) {
+                        elf_warn("malformed core file note!");
+                        core = CoreFile{};
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        ELFHeaderT *get_header() const { return header; }
+
+        MappedFileVisitor *get_visitor() const { return visitor; }
+
+        /// in the order of the notes, the first one is the thread that received the fatal signal.
+        const std::vector<Thread> &get_threads() const { return threads; }
+
+        /// return false if the core file has no NT_PRPSINFO note.
+        bool get_process_info(ProcessInfo &info) const {
+            info = process;
+            return has_process;
+        }
+
+        usize get_aux_num() const { return aux_num; }
+
+        AuxEntry get_aux(usize index) const {
+            return AuxEntry{load<USizeT>(aux_vector + index * sizeof(AuxEntry)),
+                            load<USizeT>(aux_vector + index * sizeof(AuxEntry) + sizeof(USizeT))};
+        }
+
+        /// return false if the auxiliary vector has no entry of `type`.
+        bool find_aux(USizeT type, USizeT &val) const {
+            for (usize i = 0; i < aux_num; ++i) {
+                AuxEntry entry = get_aux(i);
+                if (entry.type == 0) break;
+                if (entry.type == type) {
+                    val = entry.val;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// page size recorded by NT_FILE, 0 if the core file has none.
+        USizeT get_page_size() const { return page_size; }
+
+        /// in the order of NT_FILE, which is sorted by address.
+        const std::vector<Mapping> &get_mappings() const { return mappings; }
+
+        /// return nullptr if no file is mapped at `address`.
+        const Mapping *find_mapping(USizeT address) const {
+            auto iter = std::upper_bound(mappings.begin(), mappings.end(), address, [](USizeT val, const Mapping &m) {
+                return val < m.start;
+            });
+
+            if (iter == mappings.begin()) return nullptr;
+            --iter;
+            return address < iter->end ? &*iter : nullptr;
+        }
+
+        /// return false if the machine is not supported or the register is out of the thread's register set.
+        bool get_register(const Thread &thread, RegisterKind kind, USizeT &val) const {
+            usize index = 0;
+            if (!get_register_index(header->machine_type, kind, index) || index >= thread.register_num) return false;
+            val = thread.get_register(index);
+            return true;
+        }
+    };
+}
+
+namespace elf32 {
+    using CoreFile = elf::CoreFile<elf::u32>;
+}
+
+namespace elf64 {
+    using CoreFile = elf::CoreFile<elf::u64>;
+}
+
+
+#endif //ELF_CORE_FILE_HPP
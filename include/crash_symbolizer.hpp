@@ -0,0 +1,334 @@
+#ifndef ELF_CRASH_SYMBOLIZER_HPP
+#define ELF_CRASH_SYMBOLIZER_HPP
+
+
+#include <algorithm>
+#include <csignal>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <cerrno>
+#include <link.h>
+#include <pthread.h>
+#include <ucontext.h>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+#include "validated_elf.hpp"
+#include "symbol_index.hpp"
+#include "plt_symbols.hpp"
+#include "function_starts.hpp"
+
+
+namespace elf {
+    /// fixed size line buffer that formats without allocation, locale or stdio, usable in a signal handler.
+    class CrashWriter {
+    private:
+        char buffer[512];
+        usize size;
+
+    public:
+        CrashWriter() : buffer{}, size{0} {}
+
+        CrashWriter &str(const char *str) {
+            for (; *str != '\0' && size < sizeof(buffer); ++str) buffer[size++] = *str;
+            return *this;
+        }
+
+        CrashWriter &hex(u64 val) {
+            char digits[16];
+            usize num = 0;
+            do {
+                digits[num++] = "0123456789abcdef"[val & 0xfu];
+                val >>= 4u;
+            } while (val != 0);
+            str("0x");
+            while (num > 0 && size < sizeof(buffer)) buffer[size++] = digits[--num];
+            return *this;
+        }
+
+        CrashWriter &dec(u64 val) {
+            char digits[20];
+            usize num = 0;
+            do {
+                digits[num++] = static_cast<char>('0' + val % 10);
+                val /= 10;
+            } while (val != 0);
+            while (num > 0 && size < sizeof(buffer)) buffer[size++] = digits[--num];
+            return *this;
+        }
+
+        /// write the buffered line to `fd` and reset the buffer.
+        void flush(int fd) {
+            usize done = 0;
+            while (done < size) {
+                ssize_t ret = write(fd, buffer + done, size - done);
+                if (ret < 0 && errno == EINTR) continue;
+                if (ret <= 0) break;
+                done += ret;
+            }
+            size = 0;
+        }
+    };
+
+    /// in-process symbolizer for crash handlers. `install` does all the work that allocates or takes locks:
+    /// it walks the loaded objects with `dl_iterate_phdr`, maps each file with `MappedFileVisitor`, validates it
+    /// and builds its `SymbolIndex`. After that `symbolize` and the `write_*` functions only read immutable arrays
+    /// and call `write`, so they are async-signal-safe: no malloc, no locks, no iostreams.
+    class CrashSymbolizer {
+    public:
+        using HostUSizeT = std::conditional<sizeof(void *) == 8, u64, u32>::type;
+
+        struct Frame {
+            /// nullptr if the address is not in a loaded object.
+            const char *path;
+            /// nullptr if no symbol covers the address.
+            const char *symbol;
+            u64 offset;
+        };
+
+    private:
+        struct Module {
+            std::string path;
+            u64 bias;
+            MappedFileVisitor visitor;
+            SymbolIndex symbols;
+            PltSymbols plt;
+            FunctionStarts functions;
+        };
+
+        struct Range {
+            u64 start;
+            u64 end;
+            usize module;
+        };
+
+        std::vector<Module> modules;
+        std::vector<Range> ranges;
+        std::vector<u8> signal_stack;
+        std::string executable;
+        /// stack of the thread that installed the handler, the only one whose frame pointers are followed.
+        uintptr_t stack_start = 0;
+        uintptr_t stack_end = 0;
+
+        static int visit(struct dl_phdr_info *info, size_t, void *data) {
+            auto *self = static_cast<CrashSymbolizer *>(data);
+            auto *programs = reinterpret_cast<const ProgramHeader<HostUSizeT> *>(info->dlpi_phdr);
+
+            const char *path = info->dlpi_name;
+            if (path == nullptr || path[0] == '\0') path = self->executable.c_str();
+
+            usize index = self->modules.size();
+            bool mapped = false;
+
+            for (usize i = 0; i < info->dlpi_phnum; ++i) {
+                if (programs[i].type != ProgramHeader<HostUSizeT>::LOADABLE) continue;
+                u64 start = info->dlpi_addr + programs[i].virtual_address;
+                self->ranges.push_back(Range{start, start + programs[i].mem_size, index});
+                mapped = true;
+            }
+
+            if (!mapped) return 0;
+
+            /// objects without a file, like the vDSO, are still reported by range but without symbols.
+            Module module{path, info->dlpi_addr, MappedFileVisitor{}, SymbolIndex{}, PltSymbols{}, FunctionStarts{}};
+            if (path[0] == '/') {
+                module.visitor = MappedFileVisitor::open_elf(path);
+                ValidatedELF<HostUSizeT> elf = validate<HostUSizeT>(module.visitor);
+                if (elf.is_valid()) {
+                    module.symbols.add_symbols(elf);
+                    module.plt.build(elf);
+                    module.plt.add_to(module.symbols);
+                    module.functions.build(elf);
+                    module.functions.add_to(module.symbols);
+                }
+            }
+            module.symbols.build();
+
+            self->modules.push_back(std::move(module));
+            return 0;
+        }
+
+        static CrashSymbolizer *&current() {
+            static CrashSymbolizer *instance = nullptr;
+            return instance;
+        }
+
+        static void handler(int signal, siginfo_t *info, void *context) {
+            CrashSymbolizer *self = current();
+
+            if (self != nullptr) {
+                CrashWriter writer{};
+                writer.str("*** signal ").dec(signal).str(" at address ")
+                        .hex(reinterpret_cast<uintptr_t>(info->si_addr)).str(" ***\n");
+                writer.flush(STDERR_FILENO);
+                self->write_stack(STDERR_FILENO, static_cast<ucontext_t *>(context));
+            }
+
+            /// re-raise with the default action so that the process still dies with the original signal.
+            struct sigaction action{};
+            action.sa_handler = SIG_DFL;
+            sigemptyset(&action.sa_mask);
+            sigaction(signal, &action, nullptr);
+            raise(signal);
+        }
+
+    public:
+        static constexpr usize MAX_FRAMES = 64;
+
+        CrashSymbolizer() = default;
+
+        CrashSymbolizer(const CrashSymbolizer &other) = delete;
+
+        CrashSymbolizer &operator=(const CrashSymbolizer &other) = delete;
+
+        /// snapshot the loaded objects, call again after `dlopen` to pick up new ones. Not async-signal-safe.
+        void install() {
+            modules.clear();
+            ranges.clear();
+
+            char buffer[4096];
+            ssize_t size = readlink("/proc/self/exe", buffer, sizeof(buffer) - 1);
+            executable.assign(buffer, size > 0 ? size : 0);
+
+            dl_iterate_phdr(visit, this);
+
+            std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) {
+                return a.start < b.start;
+            });
+            modules.shrink_to_fit();
+            ranges.shrink_to_fit();
+        }
+
+        /// install `handler` for the fatal signals. The calling thread gets a preallocated alternate stack, so that
+        /// its stack overflows are reported too. The symbolizer must stay alive as long as the handler is installed.
+        void install_handler() {
+            static const int signals[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT, SIGTRAP};
+
+            if (modules.empty()) install();
+
+            signal_stack.resize(std::max<usize>(SIGSTKSZ, 64 * 1024));
+            stack_t stack{};
+            stack.ss_sp = signal_stack.data();
+            stack.ss_size = signal_stack.size();
+            sigaltstack(&stack, nullptr);
+
+            pthread_attr_t attr;
+            if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+                void *address = nullptr;
+                size_t size = 0;
+                if (pthread_attr_getstack(&attr, &address, &size) == 0) {
+                    stack_start = reinterpret_cast<uintptr_t>(address);
+                    stack_end = stack_start + size;
+                }
+                pthread_attr_destroy(&attr);
+            }
+
+            current() = this;
+
+            struct sigaction action{};
+            action.sa_sigaction = handler;
+            action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+            sigemptyset(&action.sa_mask);
+            for (int signal: signals) sigaction(signal, &action, nullptr);
+        }
+
+        /// async-signal-safe, return false if `address` is not in a loaded object.
+        bool symbolize(u64 address, Frame &frame) const {
+            auto iter = std::upper_bound(ranges.begin(), ranges.end(), address, [](u64 val, const Range &range) {
+                return val < range.start;
+            });
+
+            frame.path = nullptr;
+            frame.symbol = nullptr;
+            frame.offset = 0;
+
+            if (iter == ranges.begin()) return false;
+            --iter;
+            if (address >= iter->end) return false;
+
+            const Module &module = modules[iter->module];
+            const SymbolIndex::Symbol *symbol = module.symbols.find(address - module.bias);
+
+            frame.path = module.path.c_str();
+            if (symbol == nullptr) {
+                frame.offset = address - module.bias;
+            } else {
+                frame.symbol = symbol->name;
+                frame.offset = address - module.bias - symbol->address;
+            }
+
+            return true;
+        }
+
+        /// async-signal-safe, write "#index address symbol+offset (path)".
+        void write_frame(int fd, usize index, u64 address) const {
+            Frame frame{};
+            CrashWriter writer{};
+
+            writer.str("#").dec(index).str(" ").hex(address);
+            if (symbolize(address, frame)) {
+                writer.str(" ");
+                if (frame.symbol != nullptr) writer.str(frame.symbol).str("+");
+                writer.hex(frame.offset).str(" (").str(frame.path).str(")");
+            }
+            writer.str("\n").flush(fd);
+        }
+
+        /// async-signal-safe.
+        void write_backtrace(int fd, const u64 *addresses, usize num) const {
+            for (usize i = 0; i < num; ++i) write_frame(fd, i, addresses[i]);
+        }
+
+        /// async-signal-safe, walk the frame pointer chain from the interrupted context. A frame is only read if it
+        /// lies between the interrupted stack pointer and the base of the stack recorded by `install_handler`, so
+        /// the garbage frame pointer of code built without frame pointers ends the walk instead of faulting, and
+        /// only the interrupted address is reported for the other threads.
+        void write_stack(int fd, const ucontext_t *context) const {
+            u64 pc, stack_pointer, frame_pointer;
+#if defined(__x86_64__)
+            pc = context->uc_mcontext.gregs[REG_RIP];
+            stack_pointer = context->uc_mcontext.gregs[REG_RSP];
+            frame_pointer = context->uc_mcontext.gregs[REG_RBP];
+#elif defined(__aarch64__)
+            pc = context->uc_mcontext.pc;
+            stack_pointer = context->uc_mcontext.sp;
+            frame_pointer = context->uc_mcontext.regs[29];
+#elif defined(__i386__)
+            pc = context->uc_mcontext.gregs[REG_EIP];
+            stack_pointer = context->uc_mcontext.gregs[REG_ESP];
+            frame_pointer = context->uc_mcontext.gregs[REG_EBP];
+#else
+#error "architecture not supported"
+#endif
+            write_frame(fd, 0, pc);
+
+            /// below the recorded stack after an overflow, the frames are still in [stack_start, stack_end).
+            if (stack_pointer >= stack_end) return;
+            u64 low = std::max<u64>(stack_pointer, stack_start);
+
+            for (usize i = 1; i < MAX_FRAMES; ++i) {
+                if (frame_pointer % sizeof(void *) != 0 || frame_pointer < low ||
+                    frame_pointer > stack_end - 2 * sizeof(void *)) {
+                    break;
+                }
+
+                auto *frame = reinterpret_cast<const uintptr_t *>(frame_pointer);
+                u64 next = frame[0];
+                u64 return_address = frame[1];
+                if (return_address == 0) break;
+
+                /// the caller's return address points after the call, step back into the call instruction.
+                write_frame(fd, i, return_address - 1);
+
+                if (next <= frame_pointer) break;
+                frame_pointer = next;
+            }
+        }
+
+        usize module_num() const { return modules.size(); }
+    };
+}
+
+
+#endif //ELF_CRASH_SYMBOLIZER_HPP
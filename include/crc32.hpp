@@ -0,0 +1,153 @@
+#ifndef ELF_CRC32_HPP
+#define ELF_CRC32_HPP
+
+
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ELF_CRC32_PCLMUL
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include "elf_utility.hpp"
+
+
+namespace elf {
+    /// CRC-32 of zlib and .gnu_debuglink, the reflected polynomial 0xedb88320 with inverted input and output.
+    /// x86 CPUs with PCLMULQDQ fold 64 bytes per iteration with carry-less multiplies, the constants and the final
+    /// Barrett reduction being those of Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ".
+    /// The instruction is picked at run time since it is not part of the x86-64 baseline. AArch64 builds with the
+    /// CRC extension use its CRC32X instruction, which implements this polynomial (the SSE 4.2 one does not).
+    /// Anything else uses slice-by-8 tables.
+    class CRC32 {
+    private:
+        struct Tables {
+            u32 inner[8][256];
+
+            Tables() : inner{} {
+                for (u32 i = 0; i < 256; ++i) {
+                    u32 crc = i;
+                    for (usize bit = 0; bit < 8; ++bit) crc = (crc >> 1u) ^ ((crc & 1u) != 0 ? 0xedb88320u : 0);
+                    inner[0][i] = crc;
+                }
+                for (u32 i = 0; i < 256; ++i) {
+                    for (usize slice = 1; slice < 8; ++slice) {
+                        u32 previous = inner[slice - 1][i];
+                        inner[slice][i] = (previous >> 8u) ^ inner[0][previous & 0xffu];
+                    }
+                }
+            }
+        };
+
+        static const Tables &get_tables() {
+            static const Tables tables{};
+            return tables;
+        }
+
+        /// `crc` is the running state, without the inversions.
+        static u32 update_slice_by_8(u32 crc, const u8 *data, usize size) {
+            const auto &table = get_tables().inner;
+
+            for (; size >= 8; data += 8, size -= 8) {
+                u32 low, high;
+                memcpy(&low, data, sizeof(low));
+                memcpy(&high, data + 4, sizeof(high));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                low = __builtin_bswap32(low);
+                high = __builtin_bswap32(high);
+#endif
+                low ^= crc;
+                crc = table[7][low & 0xffu] ^ table[6][(low >> 8u) & 0xffu] ^ table[5][(low >> 16u) & 0xffu] ^
+                      table[4][low >> 24u] ^ table[3][high & 0xffu] ^ table[2][(high >> 8u) & 0xffu] ^
+                      table[1][(high >> 16u) & 0xffu] ^ table[0][high >> 24u];
+            }
+            for (; size > 0; ++data, --size) crc = (crc >> 8u) ^ table[0][(crc ^ *data) & 0xffu];
+
+            return crc;
+        }
+
+#if defined(ELF_CRC32_PCLMUL)
+        static bool has_pclmul() {
+            static const bool supported = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+            return supported;
+        }
+
+        __attribute__((target("pclmul,sse4.1")))
+        static __m128i fold(__m128i val, __m128i constant) {
+            return _mm_xor_si128(_mm_clmulepi64_si128(val, constant, 0x00), _mm_clmulepi64_si128(val, constant, 0x11));
+        }
+
+        /// `size` must be a multiple of 16, at least 64.
+        __attribute__((target("pclmul,sse4.1")))
+        static u32 update_pclmul(u32 crc, const u8 *data, usize size) {
+            const __m128i r2r1 = _mm_set_epi64x(0x1c6e41596, 0x154442bd4);
+            const __m128i r4r3 = _mm_set_epi64x(0x0ccaa009e, 0x1751997d0);
+            const __m128i r5 = _mm_set_epi64x(0, 0x163cd6124);
+            const __m128i poly = _mm_set_epi64x(0x1f7011641, 0x1db710641);
+            const __m128i mask32 = _mm_set_epi32(0, 0, 0, -1);
+
+            const auto *blocks = reinterpret_cast<const __m128i *>(data);
+            __m128i x1 = _mm_xor_si128(_mm_loadu_si128(blocks), _mm_cvtsi32_si128(static_cast<int>(crc)));
+            __m128i x2 = _mm_loadu_si128(blocks + 1);
+            __m128i x3 = _mm_loadu_si128(blocks + 2);
+            __m128i x4 = _mm_loadu_si128(blocks + 3);
+            blocks += 4;
+            size -= 64;
+
+            for (; size >= 64; blocks += 4, size -= 64) {
+                x1 = _mm_xor_si128(fold(x1, r2r1), _mm_loadu_si128(blocks));
+                x2 = _mm_xor_si128(fold(x2, r2r1), _mm_loadu_si128(blocks + 1));
+                x3 = _mm_xor_si128(fold(x3, r2r1), _mm_loadu_si128(blocks + 2));
+                x4 = _mm_xor_si128(fold(x4, r2r1), _mm_loadu_si128(blocks + 3));
+            }
+
+            x1 = _mm_xor_si128(fold(x1, r4r3), x2);
+            x1 = _mm_xor_si128(fold(x1, r4r3), x3);
+            x1 = _mm_xor_si128(fold(x1, r4r3), x4);
+            for (; size >= 16; ++blocks, size -= 16) x1 = _mm_xor_si128(fold(x1, r4r3), _mm_loadu_si128(blocks));
+
+            /// 128 to 64 bits, then 64 to 32 bits, then the Barrett reduction.
+            x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), _mm_clmulepi64_si128(r4r3, x1, 0x01));
+            __m128i x2_low = _mm_and_si128(x1, mask32);
+            x1 = _mm_xor_si128(_mm_srli_si128(x1, 4), _mm_clmulepi64_si128(x2_low, r5, 0x00));
+
+            __m128i x3_low = _mm_and_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10), mask32);
+            x1 = _mm_xor_si128(x1, _mm_clmulepi64_si128(x3_low, poly, 0x00));
+            return static_cast<u32>(_mm_extract_epi32(x1, 1));
+        }
+#endif
+
+    public:
+        /// continue the CRC `crc` of the preceding bytes, 0 for none, over `size` bytes at `data`.
+        static u32 update(u32 crc, const void *data, usize size) {
+            auto *bytes = static_cast<const u8 *>(data);
+            crc = ~crc;
+
+#if defined(ELF_CRC32_PCLMUL)
+            if (size >= 64 && has_pclmul()) {
+                usize folded = size & ~static_cast<usize>(15);
+                crc = update_pclmul(crc, bytes, folded);
+                bytes += folded;
+                size -= folded;
+            }
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+            for (; size >= 8; bytes += 8, size -= 8) {
+                u64 word;
+                memcpy(&word, bytes, sizeof(word));
+                crc = __crc32d(crc, word);
+            }
+#endif
+
+            return ~update_slice_by_8(crc, bytes, size);
+        }
+
+        static u32 compute(const void *data, usize size) { return update(0, data, size); }
+    };
+}
+
+
+#endif //ELF_CRC32_HPP
@@ -0,0 +1,194 @@
+#ifndef ELF_DEBUG_FILE_HPP
+#define ELF_DEBUG_FILE_HPP
+
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "validated_elf.hpp"
+#include "process_view.hpp"
+#include "crc32.hpp"
+
+
+namespace elf {
+    /// locate the separate debug file of an ELF file, with the conventions of gdb. The build-id convention comes
+    /// first, `<debug dir>/.build-id/xx/yyyy.debug` for the hex build-id xxyyyy, accepted if the build-id of the
+    /// candidate matches. Then the name of .gnu_debuglink, looked up next to the file, in its .debug directory and
+    /// under each debug directory followed by the directory of the file, accepted if the CRC-32 of the whole
+    /// candidate is the one of .gnu_debuglink.
+    ///
+    /// The CRC-32 of a file is computed once per identity (device, inode, size and modification time), so that
+    /// resolving many files with the same debug file, or the same file again, does not read it again.
+    class DebugFileResolver {
+    public:
+        struct DebugLink {
+            const char *name;
+            u32 crc;
+        };
+
+    private:
+        struct FileKey {
+            u64 device;
+            u64 inode;
+            u64 size;
+            i64 modify_sec;
+            i64 modify_nsec;
+
+            bool operator<(const FileKey &other) const {
+                if (device != other.device) return device < other.device;
+                if (inode != other.inode) return inode < other.inode;
+                if (size != other.size) return size < other.size;
+                if (modify_sec != other.modify_sec) return modify_sec < other.modify_sec;
+                return modify_nsec < other.modify_nsec;
+            }
+        };
+
+        std::vector<std::string> debug_dirs;
+        std::map<FileKey, u32> crcs;
+        usize computed;
+
+        static bool get_file_key(const std::string &path, FileKey &key) {
+            struct stat file_stat{};
+            if (stat(path.c_str(), &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) return false;
+#if defined(__APPLE__)
+            const struct timespec &time = file_stat.st_mtimespec;
+#else
+            const struct timespec &time = file_stat.st_mtim;
+#endif
+            key = FileKey{static_cast<u64>(file_stat.st_dev), static_cast<u64>(file_stat.st_ino),
+                          static_cast<u64>(file_stat.st_size), time.tv_sec, time.tv_nsec};
+            return true;
+        }
+
+        /// directory of `path` with its trailing slash, empty for a bare file name.
+        static std::string get_directory(const std::string &path) {
+            usize slash = path.rfind('/');
+            return slash == std::string::npos ? std::string{} : path.substr(0, slash + 1);
+        }
+
+        std::string find_by_build_id(const std::string &build_id) const {
+            if (build_id.size() < 4) return std::string{};
+
+            for (auto &dir: debug_dirs) {
+                std::string candidate = dir + "/.build-id/" + build_id.substr(0, 2) + "/" + build_id.substr(2) +
+                                        ".debug";
+                if (access(candidate.c_str(), R_OK) != 0) continue;
+
+                MappedFileVisitor visitor = MappedFileVisitor::open_elf(candidate.c_str());
+                if (Module::read_build_id(visitor) == build_id) return candidate;
+            }
+
+            return std::string{};
+        }
+
+        std::string find_by_debug_link(const DebugLink &link, const std::string &path) {
+            std::string dir = get_directory(path);
+            std::vector<std::string> candidates{dir + link.name, dir + ".debug/" + link.name};
+            if (!dir.empty() && dir[0] == '/') {
+                for (auto &debug_dir: debug_dirs) candidates.push_back(debug_dir + dir + link.name);
+            }
+
+            for (auto &candidate: candidates) {
+                /// a file linking to itself, as a stripped file copied under the same name would.
+                if (candidate == path) continue;
+
+                u32 crc = 0;
+                if (get_crc(candidate, crc) && crc == link.crc) return candidate;
+            }
+
+            return std::string{};
+        }
+
+        template<typename USizeT>
+        std::string resolve(MappedFileVisitor &visitor, const std::string &path) {
+            std::string found = find_by_build_id(Module::read_build_id(visitor));
+            if (!found.empty()) return found;
+
+            ValidatedELF<USizeT> elf = validate<USizeT>(visitor);
+            DebugLink link{};
+            if (elf.is_valid() && get_debug_link(elf, link)) found = find_by_debug_link(link, path);
+
+            return found;
+        }
+
+    public:
+        explicit DebugFileResolver(std::vector<std::string> debug_dirs = std::vector<std::string>{"/usr/lib/debug"})
+                : debug_dirs{std::move(debug_dirs)}, computed{0} {}
+
+        /// read .gnu_debuglink: the file name, padded to 4 bytes, then the CRC-32 in the byte order of the file.
+        template<typename USizeT>
+        static bool get_debug_link(const ValidatedELF<USizeT> &elf, DebugLink &link) {
+            using SectionHeaderT = SectionHeader<USizeT>;
+
+            for (auto &section: elf.sections()) {
+                if (section.section_type == SectionHeaderT::NO_BITS) continue;
+                if (strcmp(elf.get_section_name(section), ".gnu_debuglink") != 0) continue;
+
+                auto *content = reinterpret_cast<const char *>(elf.get_content(section));
+                usize name_size = strnlen(content, section.size);
+                usize crc_offset = (name_size + 4) & ~static_cast<usize>(3);
+                if (name_size == 0 || crc_offset + sizeof(u32) > section.size) return false;
+
+                link.name = content;
+                memcpy(&link.crc, content + crc_offset, sizeof(link.crc));
+                return true;
+            }
+
+            return false;
+        }
+
+        /// CRC-32 of the whole file at `path`, computed on the first call for each file identity. Return false if
+        /// it is not a regular file or cannot be mapped.
+        bool get_crc(const std::string &path, u32 &crc) {
+            FileKey key{};
+            if (!get_file_key(path, key)) return false;
+
+            auto iter = crcs.find(key);
+            if (iter != crcs.end()) {
+                crc = iter->second;
+                return true;
+            }
+
+            crc = 0;
+            if (key.size != 0) {
+                MappedFileVisitor visitor = MappedFileVisitor::open_elf(path.c_str());
+                void *content = visitor.address(0, visitor.get_size());
+                if (content == nullptr) return false;
+
+                madvise(content, visitor.get_size(), MADV_SEQUENTIAL);
+                ++computed;
+                crc = CRC32::compute(content, visitor.get_size());
+            }
+            crcs[key] = crc;
+            return true;
+        }
+
+        /// path of the debug file of `path`, whose content is `visitor`, empty if none is found.
+        std::string resolve(const std::string &path, MappedFileVisitor &visitor) {
+            switch (get_elf_class(visitor)) {
+                case 1:
+                    return resolve<u32>(visitor, path);
+                case 2:
+                    return resolve<u64>(visitor, path);
+                default:
+                    return std::string{};
+            }
+        }
+
+        std::string resolve(const std::string &path) {
+            if (access(path.c_str(), R_OK) != 0) return std::string{};
+
+            MappedFileVisitor visitor = MappedFileVisitor::open_elf(path.c_str());
+            return resolve(path, visitor);
+        }
+
+        /// number of CRC-32 computed, that is, of files read in whole.
+        usize computed_num() const { return computed; }
+    };
+}
+
+
+#endif //ELF_DEBUG_FILE_HPP
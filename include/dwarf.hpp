@@ -0,0 +1,661 @@
+#ifndef ELF_DWARF_HPP
+#define ELF_DWARF_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "validated_elf.hpp"
+#include "byte_reader.hpp"
+
+
+namespace elf {
+    /// the DWARF sections of an ELF file, and what every DWARF decoder needs on top of them: unit headers,
+    /// abbreviation tables, attribute values, and the address and string indirections of DWARF 5. Versions 2 to 5
+    /// are read, in the 32 and 64 bit formats. Only sections of the file itself are used, compressed sections and
+    /// split units (.dwo) are treated as absent.
+    class DWARF {
+    public:
+        elf_enum_display(Tag, u16, 7,
+                         LEXICAL_BLOCK, 0x0b,
+                         INLINED_SUBROUTINE, 0x1d,
+                         COMPILE_UNIT, 0x11,
+                         SUBPROGRAM, 0x2e,
+                         PARTIAL_UNIT, 0x3c,
+                         TYPE_UNIT, 0x41,
+                         SKELETON_UNIT, 0x4a
+        );
+
+        elf_enum_display(Attribute, u16, 19,
+                         NAME, 0x03,
+                         STMT_LIST, 0x10,
+                         LOW_PC, 0x11,
+                         HIGH_PC, 0x12,
+                         COMP_DIR, 0x1b,
+                         ABSTRACT_ORIGIN, 0x31,
+                         SPECIFICATION, 0x47,
+                         ENTRY_PC, 0x52,
+                         RANGES, 0x55,
+                         CALL_COLUMN, 0x57,
+                         CALL_FILE, 0x58,
+                         CALL_LINE, 0x59,
+                         LINKAGE_NAME, 0x6e,
+                         STR_OFFSETS_BASE, 0x72,
+                         ADDR_BASE, 0x73,
+                         RNGLISTS_BASE, 0x74,
+                         MIPS_LINKAGE_NAME, 0x2007,
+                         GNU_RANGES_BASE, 0x2132,
+                         GNU_ADDR_BASE, 0x2133
+        );
+
+        elf_enum_display(Form, u16, 47,
+                         ADDR, 0x01,
+                         BLOCK2, 0x03,
+                         BLOCK4, 0x04,
+                         DATA2, 0x05,
+                         DATA4, 0x06,
+                         DATA8, 0x07,
+                         STRING, 0x08,
+                         BLOCK, 0x09,
+                         BLOCK1, 0x0a,
+                         DATA1, 0x0b,
+                         FLAG, 0x0c,
+                         SDATA, 0x0d,
+                         STRP, 0x0e,
+                         UDATA, 0x0f,
+                         REF_ADDR, 0x10,
+                         REF1, 0x11,
+                         REF2, 0x12,
+                         REF4, 0x13,
+                         REF8, 0x14,
+                         REF_UDATA, 0x15,
+                         INDIRECT, 0x16,
+                         SEC_OFFSET, 0x17,
+                         EXPRLOC, 0x18,
+                         FLAG_PRESENT, 0x19,
+                         STRX, 0x1a,
+                         ADDRX, 0x1b,
+                         REF_SUP4, 0x1c,
+                         STRP_SUP, 0x1d,
+                         DATA16, 0x1e,
+                         LINE_STRP, 0x1f,
+                         REF_SIG8, 0x20,
+                         IMPLICIT_CONST, 0x21,
+                         LOCLISTX, 0x22,
+                         RNGLISTX, 0x23,
+                         REF_SUP8, 0x24,
+                         STRX1, 0x25,
+                         STRX2, 0x26,
+                         STRX3, 0x27,
+                         STRX4, 0x28,
+                         ADDRX1, 0x29,
+                         ADDRX2, 0x2a,
+                         ADDRX3, 0x2b,
+                         ADDRX4, 0x2c,
+                         GNU_ADDR_INDEX, 0x1f01,
+                         GNU_STR_INDEX, 0x1f02,
+                         GNU_REF_ALT, 0x1f20,
+                         GNU_STRP_ALT, 0x1f21
+        );
+
+        /// DW_UT_* of DWARF 5 unit headers, earlier versions only have compile units in .debug_info.
+        static constexpr u8 UNIT_COMPILE = 1;
+        static constexpr u8 UNIT_TYPE = 2;
+        static constexpr u8 UNIT_PARTIAL = 3;
+        static constexpr u8 UNIT_SKELETON = 4;
+        static constexpr u8 UNIT_SPLIT_COMPILE = 5;
+        static constexpr u8 UNIT_SPLIT_TYPE = 6;
+
+        struct Section {
+            const u8 *data;
+            usize size;
+
+            bool is_empty() const { return size == 0; }
+        };
+
+        struct Unit {
+            /// offset of the unit header in .debug_info, and of the next unit.
+            u64 offset;
+            u64 end;
+            /// offset of the unit DIE.
+            u64 die_offset;
+            u64 abbrev_offset;
+            u16 version;
+            u8 unit_type;
+            u8 address_size;
+            u8 offset_size;
+            /// filled from the unit DIE by `read_root`.
+            u64 base_address;
+            u64 addr_base;
+            u64 rnglists_base;
+            u64 str_offsets_base;
+        };
+
+        struct AttributeSpec {
+            u16 attribute;
+            u16 form;
+            i64 implicit_const;
+        };
+
+        struct Abbrev {
+            u64 code;
+            u16 tag;
+            bool has_children;
+            u32 first_spec;
+            u32 spec_num;
+        };
+
+        /// the abbreviations of one unit, usually shared by all the units of a file.
+        class AbbrevTable {
+        private:
+            std::vector<Abbrev> abbrevs;
+            std::vector<AttributeSpec> specs;
+
+        public:
+            /// parse the table at `offset` of .debug_abbrev, replacing any previous content.
+            bool parse(const Section &section, u64 offset) {
+                abbrevs.clear();
+                specs.clear();
+                if (offset > section.size) return false;
+
+                ByteReader reader{section.data, section.size};
+                reader.seek(static_cast<usize>(offset));
+
+                while (true) {
+                    u64 code = reader.read_uleb128();
+                    if (code == 0 || !reader.is_valid()) break;
+
+                    Abbrev abbrev{code, static_cast<u16>(reader.read_uleb128()), reader.read<u8>() != 0,
+                                  static_cast<u32>(specs.size()), 0};
+                    while (true) {
+                        u64 attribute = reader.read_uleb128(), form = reader.read_uleb128();
+                        if ((attribute == 0 && form == 0) || !reader.is_valid()) break;
+                        i64 implicit_const = form == IMPLICIT_CONST ? reader.read_sleb128() : 0;
+                        specs.push_back(AttributeSpec{static_cast<u16>(attribute), static_cast<u16>(form),
+                                                      implicit_const});
+                    }
+                    abbrev.spec_num = static_cast<u32>(specs.size()) - abbrev.first_spec;
+                    abbrevs.push_back(abbrev);
+                }
+
+                /// codes are almost always 1, 2, 3..., so that `find` is a direct lookup.
+                std::sort(abbrevs.begin(), abbrevs.end(), [](const Abbrev &lhs, const Abbrev &rhs) {
+                    return lhs.code < rhs.code;
+                });
+                return reader.is_valid();
+            }
+
+            const Abbrev *find(u64 code) const {
+                if (code - 1 < abbrevs.size() && abbrevs[code - 1].code == code) return &abbrevs[code - 1];
+
+                auto iter = std::lower_bound(abbrevs.begin(), abbrevs.end(), code, [](const Abbrev &abbrev, u64 val) {
+                    return abbrev.code < val;
+                });
+                return iter != abbrevs.end() && iter->code == code ? &*iter : nullptr;
+            }
+
+            const AttributeSpec *get_specs(const Abbrev &abbrev) const { return specs.data() + abbrev.first_spec; }
+        };
+
+        struct Value {
+            u16 form;
+            /// the constant, address, offset, reference or index, or the size of a block.
+            u64 val;
+            /// the string of DW_FORM_string, or the content of a block.
+            const u8 *data;
+
+            bool is_constant() const {
+                return form == DATA1 || form == DATA2 || form == DATA4 || form == DATA8 || form == UDATA ||
+                       form == SDATA || form == IMPLICIT_CONST;
+            }
+        };
+
+        /// the attributes describing the code of a DIE, collected while reading it and resolved with
+        /// `for_each_range` once the unit bases are known.
+        struct PCAttributes {
+            Value low_pc;
+            Value high_pc;
+            Value ranges;
+            bool has_low_pc;
+            bool has_high_pc;
+            bool has_ranges;
+
+            bool collect(u16 attribute, const Value &value) {
+                switch (attribute) {
+                    case LOW_PC:
+                        low_pc = value;
+                        has_low_pc = true;
+                        return true;
+                    case HIGH_PC:
+                        high_pc = value;
+                        has_high_pc = true;
+                        return true;
+                    case RANGES:
+                        ranges = value;
+                        has_ranges = true;
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+        };
+
+        Section info;
+        Section abbrev;
+        Section aranges;
+        Section ranges;
+        Section rnglists;
+        Section addr;
+        Section str;
+        Section str_offsets;
+        Section line_str;
+        Section line;
+
+    private:
+        static const char *get_str(const Section &section, u64 offset) {
+            if (offset >= section.size) return nullptr;
+            auto *str = reinterpret_cast<const char *>(section.data + offset);
+            return strnlen(str, section.size - offset) < section.size - offset ? str : nullptr;
+        }
+
+        /// the offset stored at entry `index` of a table of offsets starting at `base`.
+        static bool read_offset(const Section &section, u64 base, u64 index, usize offset_size, u64 &val) {
+            if (base > section.size || index >= (section.size - base) / offset_size) return false;
+            ByteReader reader{section.data + base + index * offset_size, offset_size};
+            val = reader.read_unsigned(offset_size);
+            return true;
+        }
+
+        /// DWARF 2 to 4 range list at `offset` of .debug_ranges.
+        template<typename F>
+        bool for_each_range_list(const Unit &unit, u64 offset, F &f) const {
+            if (offset > ranges.size) return false;
+            ByteReader reader{ranges.data, ranges.size};
+            reader.seek(static_cast<usize>(offset));
+
+            u64 max = unit.address_size == 4 ? 0xffffffffu : ~static_cast<u64>(0);
+            u64 base = unit.base_address;
+            while (true) {
+                u64 begin = reader.read_unsigned(unit.address_size), end = reader.read_unsigned(unit.address_size);
+                if (!reader.is_valid()) return false;
+                if (begin == 0 && end == 0) return true;
+
+                if (begin == max) {
+                    base = end;
+                } else if (begin < end) {
+                    f(base + begin, base + end);
+                }
+            }
+        }
+
+        /// DWARF 5 range list at `offset` of .debug_rnglists.
+        template<typename F>
+        bool for_each_rnglist(const Unit &unit, u64 offset, F &f) const {
+            if (offset > rnglists.size) return false;
+            ByteReader reader{rnglists.data, rnglists.size};
+            reader.seek(static_cast<usize>(offset));
+
+            u64 base = unit.base_address;
+            while (true) {
+                u64 begin = 0, end = 0;
+                u8 kind = reader.read<u8>();
+                if (!reader.is_valid()) return false;
+
+                switch (kind) {
+                    case 0:
+                        return true;
+                    case 1:
+                        if (!get_indexed_address(unit, reader.read_uleb128(), base)) return false;
+                        continue;
+                    case 2:
+                        if (!get_indexed_address(unit, reader.read_uleb128(), begin) ||
+                            !get_indexed_address(unit, reader.read_uleb128(), end)) {
+                            return false;
+                        }
+                        break;
+                    case 3:
+                        if (!get_indexed_address(unit, reader.read_uleb128(), begin)) return false;
+                        end = begin + reader.read_uleb128();
+                        break;
+                    case 4:
+                        begin = base + reader.read_uleb128();
+                        end = base + reader.read_uleb128();
+                        break;
+                    case 5:
+                        base = reader.read_unsigned(unit.address_size);
+                        continue;
+                    case 6:
+                        begin = reader.read_unsigned(unit.address_size);
+                        end = reader.read_unsigned(unit.address_size);
+                        break;
+                    case 7:
+                        begin = reader.read_unsigned(unit.address_size);
+                        end = begin + reader.read_uleb128();
+                        break;
+                    default:
+                        return false;
+                }
+
+                if (!reader.is_valid()) return false;
+                if (begin < end) f(begin, end);
+            }
+        }
+
+    public:
+        DWARF() : info{}, abbrev{}, aranges{}, ranges{}, rnglists{}, addr{}, str{}, str_offsets{}, line_str{},
+                  line{} {}
+
+        /// find the DWARF sections of `elf`, return false if it has no .debug_info.
+        template<typename USizeT>
+        bool load(const ValidatedELF<USizeT> &elf) {
+            using SectionHeaderT = SectionHeader<USizeT>;
+
+            struct Name {
+                const char *name;
+                Section *section;
+            };
+            const Name names[] = {{".debug_info",        &info},
+                                  {".debug_abbrev",      &abbrev},
+                                  {".debug_aranges",     &aranges},
+                                  {".debug_ranges",      &ranges},
+                                  {".debug_rnglists",    &rnglists},
+                                  {".debug_addr",        &addr},
+                                  {".debug_str",         &str},
+                                  {".debug_str_offsets", &str_offsets},
+                                  {".debug_line_str",    &line_str},
+                                  {".debug_line",        &line}};
+
+            *this = DWARF{};
+            for (auto &section: elf.sections()) {
+                if (section.section_type == SectionHeaderT::NO_BITS) continue;
+                if ((section.flags & SectionHeaderT::COMPRESSED) != 0) continue;
+
+                const char *section_name = elf.get_section_name(section);
+                if (strncmp(section_name, ".debug_", 7) != 0) continue;
+                for (auto &name: names) {
+                    if (strcmp(section_name, name.name) != 0) continue;
+                    *name.section = Section{elf.get_content(section), static_cast<usize>(section.size)};
+                    break;
+                }
+            }
+
+            return !info.is_empty();
+        }
+
+        /// read the unit header at `offset` of .debug_info, return false at the end or on a malformed header.
+        bool read_unit(u64 offset, Unit &unit) const {
+            if (offset >= info.size) return false;
+            ByteReader reader{info.data, info.size};
+            reader.seek(static_cast<usize>(offset));
+
+            unit = Unit{};
+            unit.offset = offset;
+            unit.offset_size = 4;
+            u64 length = reader.read<u32>();
+            if (length == 0xffffffffu) {
+                unit.offset_size = 8;
+                length = reader.read<u64>();
+            }
+            if (!reader.is_valid() || length > reader.remain() || length < 2) return false;
+            unit.end = reader.get_position() + length;
+
+            unit.version = reader.read<u16>();
+            if (unit.version < 2 || unit.version > 5) return false;
+            if (unit.version == 5) {
+                unit.unit_type = reader.read<u8>();
+                unit.address_size = reader.read<u8>();
+                unit.abbrev_offset = reader.read_unsigned(unit.offset_size);
+                if (unit.unit_type == UNIT_SKELETON || unit.unit_type == UNIT_SPLIT_COMPILE) {
+                    reader.skip(8);
+                } else if (unit.unit_type == UNIT_TYPE || unit.unit_type == UNIT_SPLIT_TYPE) {
+                    reader.skip(8 + unit.offset_size);
+                }
+            } else {
+                unit.unit_type = UNIT_COMPILE;
+                unit.abbrev_offset = reader.read_unsigned(unit.offset_size);
+                unit.address_size = reader.read<u8>();
+            }
+
+            unit.die_offset = reader.get_position();
+            return reader.is_valid() && unit.die_offset <= unit.end &&
+                   (unit.address_size == 4 || unit.address_size == 8);
+        }
+
+        /// read a value of `form` at the cursor of `reader`.
+        bool read_value(ByteReader &reader, const Unit &unit, u16 form, i64 implicit_const, Value &value) const {
+            value = Value{form, 0, nullptr};
+
+            switch (form) {
+                case ADDR:
+                    value.val = reader.read_unsigned(unit.address_size);
+                    break;
+                case DATA1:
+                case REF1:
+                case FLAG:
+                case STRX1:
+                case ADDRX1:
+                    value.val = reader.read<u8>();
+                    break;
+                case DATA2:
+                case REF2:
+                case STRX2:
+                case ADDRX2:
+                    value.val = reader.read<u16>();
+                    break;
+                case STRX3:
+                case ADDRX3: {
+                    u8 bytes[3] = {reader.read<u8>(), reader.read<u8>(), reader.read<u8>()};
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                    value.val = static_cast<u64>(bytes[0]) << 16u | static_cast<u64>(bytes[1]) << 8u | bytes[2];
+#else
+                    value.val = static_cast<u64>(bytes[2]) << 16u | static_cast<u64>(bytes[1]) << 8u | bytes[0];
+#endif
+                    break;
+                }
+                case DATA4:
+                case REF4:
+                case REF_SUP4:
+                case STRX4:
+                case ADDRX4:
+                    value.val = reader.read<u32>();
+                    break;
+                case DATA8:
+                case REF8:
+                case REF_SIG8:
+                case REF_SUP8:
+                    value.val = reader.read<u64>();
+                    break;
+                case DATA16:
+                    value.data = reader.get_data() + reader.get_position();
+                    value.val = 16;
+                    reader.skip(16);
+                    break;
+                case UDATA:
+                case REF_UDATA:
+                case STRX:
+                case ADDRX:
+                case LOCLISTX:
+                case RNGLISTX:
+                case GNU_ADDR_INDEX:
+                case GNU_STR_INDEX:
+                    value.val = reader.read_uleb128();
+                    break;
+                case SDATA:
+                    value.val = static_cast<u64>(reader.read_sleb128());
+                    break;
+                case STRP:
+                case LINE_STRP:
+                case SEC_OFFSET:
+                case STRP_SUP:
+                case GNU_REF_ALT:
+                case GNU_STRP_ALT:
+                    value.val = reader.read_unsigned(unit.offset_size);
+                    break;
+                case REF_ADDR:
+                    value.val = reader.read_unsigned(unit.version == 2 ? unit.address_size : unit.offset_size);
+                    break;
+                case STRING:
+                    value.data = reinterpret_cast<const u8 *>(reader.read_str());
+                    break;
+                case BLOCK1:
+                case BLOCK2:
+                case BLOCK4:
+                case BLOCK:
+                case EXPRLOC:
+                    value.val = form == BLOCK1 ? reader.read<u8>() : form == BLOCK2 ? reader.read<u16>() :
+                                form == BLOCK4 ? reader.read<u32>() : reader.read_uleb128();
+                    value.data = reader.get_data() + reader.get_position();
+                    reader.skip(static_cast<usize>(std::min<u64>(value.val, reader.remain() + 1)));
+                    break;
+                case FLAG_PRESENT:
+                    value.val = 1;
+                    break;
+                case IMPLICIT_CONST:
+                    value.val = static_cast<u64>(implicit_const);
+                    break;
+                case INDIRECT: {
+                    u64 actual = reader.read_uleb128();
+                    if (actual == INDIRECT || actual == IMPLICIT_CONST || !reader.is_valid()) return false;
+                    return read_value(reader, unit, static_cast<u16>(actual), 0, value);
+                }
+                default:
+                    return false;
+            }
+
+            return reader.is_valid();
+        }
+
+        /// read the attributes of the DIE of `abbrev` at the cursor of `reader`, calling `f(attribute, value)`.
+        template<typename F>
+        bool read_attributes(ByteReader &reader, const Unit &unit, const AbbrevTable &table, const Abbrev &abbrev,
+                             F f) const {
+            const AttributeSpec *specs = table.get_specs(abbrev);
+            for (usize i = 0; i < abbrev.spec_num; ++i) {
+                Value value{};
+                if (!read_value(reader, unit, specs[i].form, specs[i].implicit_const, value)) return false;
+                f(specs[i].attribute, value);
+            }
+            return true;
+        }
+
+        /// entry `index` of the .debug_addr table of `unit`.
+        bool get_indexed_address(const Unit &unit, u64 index, u64 &address) const {
+            if (unit.addr_base > addr.size || index >= (addr.size - unit.addr_base) / unit.address_size) return false;
+            ByteReader reader{addr.data + unit.addr_base + index * unit.address_size, unit.address_size};
+            address = reader.read_unsigned(unit.address_size);
+            return reader.is_valid();
+        }
+
+        bool get_address(const Unit &unit, const Value &value, u64 &address) const {
+            switch (value.form) {
+                case ADDR:
+                    address = value.val;
+                    return true;
+                case ADDRX:
+                case ADDRX1:
+                case ADDRX2:
+                case ADDRX3:
+                case ADDRX4:
+                case GNU_ADDR_INDEX:
+                    return get_indexed_address(unit, value.val, address);
+                default:
+                    return false;
+            }
+        }
+
+        /// nullptr for a string out of the sections of this file, or of a supplementary file.
+        const char *get_string(const Unit &unit, const Value &value) const {
+            u64 offset = 0;
+
+            switch (value.form) {
+                case STRING:
+                    return reinterpret_cast<const char *>(value.data);
+                case STRP:
+                    return get_str(str, value.val);
+                case LINE_STRP:
+                    return get_str(line_str, value.val);
+                case STRX:
+                case STRX1:
+                case STRX2:
+                case STRX3:
+                case STRX4:
+                case GNU_STR_INDEX:
+                    if (!read_offset(str_offsets, unit.str_offsets_base, value.val, unit.offset_size, offset)) {
+                        return nullptr;
+                    }
+                    return get_str(str, offset);
+                default:
+                    return nullptr;
+            }
+        }
+
+        /// call `f(begin, end)` for each address range of a DIE, given by low_pc and high_pc, or by ranges.
+        template<typename F>
+        bool for_each_range(const Unit &unit, const PCAttributes &pc, F f) const {
+            if (pc.has_ranges) {
+                if (unit.version < 5) return for_each_range_list(unit, pc.ranges.val, f);
+
+                u64 offset = pc.ranges.val;
+                if (pc.ranges.form == RNGLISTX) {
+                    if (!read_offset(rnglists, unit.rnglists_base, pc.ranges.val, unit.offset_size, offset)) {
+                        return false;
+                    }
+                    offset += unit.rnglists_base;
+                }
+                return for_each_rnglist(unit, offset, f);
+            }
+
+            if (!pc.has_low_pc || !pc.has_high_pc) return true;
+
+            u64 begin = 0, end = 0;
+            if (!get_address(unit, pc.low_pc, begin)) return false;
+            if (pc.high_pc.is_constant()) {
+                end = begin + pc.high_pc.val;
+            } else if (!get_address(unit, pc.high_pc, end)) {
+                return false;
+            }
+            if (begin < end) f(begin, end);
+            return true;
+        }
+
+        /// read the unit DIE of `unit` with its abbreviations `table`, filling the bases of `unit` and `pc`. `f`
+        /// gets the other attributes.
+        template<typename F>
+        bool read_root(Unit &unit, const AbbrevTable &table, PCAttributes &pc, F f) const {
+            ByteReader reader{info.data, static_cast<usize>(unit.end)};
+            reader.seek(static_cast<usize>(unit.die_offset));
+
+            const Abbrev *root = table.find(reader.read_uleb128());
+            if (root == nullptr || !reader.is_valid()) return false;
+
+            pc = PCAttributes{};
+            bool success = read_attributes(reader, unit, table, *root, [&](u16 attribute, const Value &value) {
+                switch (attribute) {
+                    case ADDR_BASE:
+                    case GNU_ADDR_BASE:
+                        unit.addr_base = value.val;
+                        break;
+                    case RNGLISTS_BASE:
+                        unit.rnglists_base = value.val;
+                        break;
+                    case STR_OFFSETS_BASE:
+                        unit.str_offsets_base = value.val;
+                        break;
+                    default:
+                        if (!pc.collect(attribute, value)) f(attribute, value);
+                        break;
+                }
+            });
+            if (!success) return false;
+
+            /// the base of the range lists is the low_pc of the unit, which may be indexed.
+            if (pc.has_low_pc && !get_address(unit, pc.low_pc, unit.base_address)) unit.base_address = 0;
+            return true;
+        }
+    };
+}
+
+
+#endif //ELF_DWARF_HPP
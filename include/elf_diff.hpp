@@ -0,0 +1,279 @@
+#ifndef ELF_ELF_DIFF_HPP
+#define ELF_ELF_DIFF_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+#include "content_hash.hpp"
+
+
+namespace elf {
+    /// structural difference of two ELF files of the same class, for reproducibility checks and size regression
+    /// gates. Sections are matched by name and symbols by name and version, the n-th of several equal names on
+    /// one side being matched with the n-th on the other. Each side is collected and sorted on its own thread, the
+    /// contents are hashed by `ContentHasher`, and the sorted lists are merged, so the cost is O(n log n) in the
+    /// number of sections and symbols.
+    ///
+    /// Symbols are read from .symtab, or from .dynsym with their versions when the file is stripped. Symbols of
+    /// type section or file and unnamed symbols are skipped. A symbol changes when its size or the bytes it covers
+    /// in the file change, a moved but otherwise identical symbol is not reported.
+    class ELFDiff {
+    public:
+        elf_enum_display(Change, u8, 3,
+                         ADDED, 0,
+                         REMOVED, 1,
+                         CHANGED, 2
+        );
+
+        struct Entry {
+            Change change;
+            /// section name, or symbol name followed by "@version", or "@@version" for the default version.
+            std::string name;
+            /// 0 on the missing side.
+            u64 old_size;
+            u64 new_size;
+            u64 old_hash;
+            u64 new_hash;
+
+            i64 get_size_delta() const { return static_cast<i64>(new_size - old_size); }
+        };
+
+    private:
+        struct Item {
+            const char *name;
+            const char *version;
+            bool hidden;
+            u64 size;
+            const void *data;
+            u64 data_size;
+            u64 hash;
+        };
+
+        struct Side {
+            std::vector<Item> sections;
+            std::vector<Item> symbols;
+            bool valid;
+        };
+
+        static int compare(const Item &lhs, const Item &rhs) {
+            int ret = strcmp(lhs.name, rhs.name);
+            if (ret != 0) return ret;
+            return strcmp(lhs.version, rhs.version);
+        }
+
+        static void sort(std::vector<Item> &items) {
+            std::stable_sort(items.begin(), items.end(), [](const Item &lhs, const Item &rhs) {
+                return compare(lhs, rhs) < 0;
+            });
+        }
+
+        static std::string get_name(const Item &item) {
+            std::string name = item.name;
+            if (item.version[0] != '\0') name.append(item.hidden ? "@" : "@@").append(item.version);
+            return name;
+        }
+
+        template<typename USizeT>
+        static void collect_symbols(ELFHeader<USizeT> *header, MappedFileVisitor &visitor, Side &side) {
+            using SectionHeaderT = SectionHeader<USizeT>;
+            using SymbolTableHeaderT = _SymbolTableHeader<USizeT>;
+
+            usize section_num = header->get_section_num(visitor);
+            auto sections = header->sections(visitor);
+
+            usize table_index = 0;
+            for (usize i = 0; i < section_num; ++i) {
+                auto type = sections[i].section_type;
+                if (type == SectionHeaderT::SYMBOL_TABLE) {
+                    table_index = i;
+                    break;
+                }
+                if (type == SectionHeaderT::DYNAMIC_SYMBOL_TABLE && table_index == 0) table_index = i;
+            }
+            if (table_index == 0) return;
+
+            auto &table_section = sections[table_index];
+            SymbolTableHeaderT *table_header = nullptr;
+            if (table_section.section_type == SectionHeaderT::SYMBOL_TABLE) {
+                table_header = SectionHeaderT::template cast<SymbolTableHeader<USizeT>>(&table_section, visitor);
+            } else {
+                table_header = SectionHeaderT::template cast<DynSymbolTableHeader<USizeT>>(&table_section, visitor);
+            }
+            if (table_header == nullptr || table_section.link >= section_num) return;
+
+            auto *string_header = SectionHeaderT::template cast<StringTableHeader<USizeT>>(
+                    &sections[table_section.link], visitor);
+            if (string_header == nullptr) return;
+            auto strings = string_header->get_table(visitor);
+
+            SymbolTableIndex section_indices{};
+            auto *index_header = header->get_symbol_table_index_header(table_index, visitor);
+            if (index_header != nullptr) section_indices = index_header->get_table(visitor);
+
+            VersionSymbolTable versions{};
+            std::vector<const char *> version_names;
+            if (table_section.section_type == SectionHeaderT::DYNAMIC_SYMBOL_TABLE &&
+                header->get_version_names(visitor, version_names)) {
+                for (auto &section: sections) {
+                    if (section.section_type != SectionHeaderT::VERSION_SYMBOL || section.link != table_index) continue;
+                    auto *version_header = SectionHeaderT::template cast<VersionSymbolHeader<USizeT>>(&section,
+                                                                                                      visitor);
+                    if (version_header != nullptr) versions = version_header->get_table(visitor);
+                    break;
+                }
+            }
+
+            bool relocatable = header->file_type == ELFHeader<USizeT>::RELOCATABLE;
+            usize index = 0;
+            for (auto &symbol: table_header->get_table(visitor)) {
+                usize symbol_index = index++;
+                auto type = symbol.get_type();
+                if (type == SymbolTableHeaderT::SECTION || type == SymbolTableHeaderT::FILE) continue;
+
+                const char *name = strings.get_str(symbol.name, nullptr);
+                if (name == nullptr || name[0] == '\0') continue;
+
+                Item item{name, "", false, symbol.size, nullptr, 0, 0};
+
+                u16 version = versions.get_version(symbol_index);
+                if (version > VersionSymbolTable::GLOBAL && version < version_names.size() &&
+                    version_names[version] != nullptr) {
+                    item.version = version_names[version];
+                    item.hidden = versions.is_hidden(symbol_index) || symbol.section_header_index == 0;
+                }
+
+                u32 section_index = section_indices.get_section_index(symbol, symbol_index);
+                bool reserved = symbol.section_header_index >= SectionHeaderT::INDEX_LOW_RESERVE &&
+                                symbol.section_header_index != SectionHeaderT::INDEX_EXTENDED;
+                if (!reserved && section_index != SectionHeaderT::INDEX_UNDEFINED && section_index < section_num) {
+                    auto &section = sections[section_index];
+                    u64 start = relocatable ? symbol.value : symbol.value - section.address;
+                    if (section.section_type != SectionHeaderT::NO_BITS && start <= section.size &&
+                        symbol.size <= section.size - start) {
+                        item.data = visitor.address(section.offset + start, symbol.size);
+                        if (item.data != nullptr) item.data_size = symbol.size;
+                    }
+                }
+
+                side.symbols.push_back(item);
+            }
+        }
+
+        template<typename USizeT>
+        static void collect(ELFHeader<USizeT> *header, MappedFileVisitor &visitor, Side &side) {
+            using SectionHeaderT = SectionHeader<USizeT>;
+
+            side.valid = false;
+            if (header->sections(visitor).size() > 0) {
+                auto *name_header = header->get_section_string_table_header(visitor);
+                if (name_header == nullptr) return;
+                auto names = name_header->get_table(visitor);
+
+                for (auto &section: header->sections(visitor)) {
+                    if (section.section_type == SectionHeaderT::SECTION_NULL) continue;
+
+                    const char *name = names.get_str(section.name, nullptr);
+                    if (name == nullptr) return;
+
+                    Item item{name, "", false, section.size, nullptr, 0, 0};
+                    if (section.section_type != SectionHeaderT::NO_BITS) {
+                        item.data = visitor.address(section.offset, section.size);
+                        if (item.data == nullptr) return;
+                        item.data_size = section.size;
+                    }
+                    side.sections.push_back(item);
+                }
+
+                collect_symbols(header, visitor, side);
+            }
+
+            sort(side.sections);
+            sort(side.symbols);
+            side.valid = true;
+        }
+
+        static void merge(const std::vector<Item> &old_items, const std::vector<Item> &new_items,
+                          std::vector<Entry> &entries) {
+            usize i = 0, j = 0;
+            while (i < old_items.size() || j < new_items.size()) {
+                int order = i == old_items.size() ? 1 : j == new_items.size() ? -1 :
+                                                        compare(old_items[i], new_items[j]);
+                if (order < 0) {
+                    const Item &item = old_items[i++];
+                    entries.push_back(Entry{REMOVED, get_name(item), item.size, 0, item.hash, 0});
+                } else if (order > 0) {
+                    const Item &item = new_items[j++];
+                    entries.push_back(Entry{ADDED, get_name(item), 0, item.size, 0, item.hash});
+                } else {
+                    const Item &old_item = old_items[i++], &new_item = new_items[j++];
+                    if (old_item.size != new_item.size || old_item.hash != new_item.hash) {
+                        entries.push_back(Entry{CHANGED, get_name(new_item), old_item.size, new_item.size,
+                                                old_item.hash, new_item.hash});
+                    }
+                }
+            }
+        }
+
+        static void add_ranges(std::vector<Item> &items, std::vector<ContentHasher::Range> &ranges) {
+            for (auto &item: items) ranges.push_back(ContentHasher::Range{item.data, item.data_size});
+        }
+
+        static usize set_hashes(std::vector<Item> &items, const std::vector<u64> &hashes, usize index) {
+            for (auto &item: items) item.hash = hashes[index++];
+            return index;
+        }
+
+    public:
+        std::vector<Entry> sections;
+        std::vector<Entry> symbols;
+
+        /// compare `old_header` with `new_header`, return false if either file has a malformed section table.
+        /// 0 threads means one per hardware thread.
+        template<typename USizeT>
+        static bool diff(ELFHeader<USizeT> *old_header, MappedFileVisitor &old_visitor,
+                         ELFHeader<USizeT> *new_header, MappedFileVisitor &new_visitor, ELFDiff &result,
+                         usize thread_num = 0) {
+            result = ELFDiff{};
+            Side old_side{}, new_side{};
+
+            if (thread_num == 1) {
+                collect(old_header, old_visitor, old_side);
+                collect(new_header, new_visitor, new_side);
+            } else {
+                std::thread thread([&]() { collect(old_header, old_visitor, old_side); });
+                collect(new_header, new_visitor, new_side);
+                thread.join();
+            }
+            if (!old_side.valid || !new_side.valid) return false;
+
+            std::vector<ContentHasher::Range> ranges;
+            add_ranges(old_side.sections, ranges);
+            add_ranges(old_side.symbols, ranges);
+            add_ranges(new_side.sections, ranges);
+            add_ranges(new_side.symbols, ranges);
+
+            std::vector<u64> hashes;
+            ContentHasher::hash(ranges, hashes, thread_num);
+
+            usize index = set_hashes(old_side.sections, hashes, 0);
+            index = set_hashes(old_side.symbols, hashes, index);
+            index = set_hashes(new_side.sections, hashes, index);
+            set_hashes(new_side.symbols, hashes, index);
+
+            merge(old_side.sections, new_side.sections, result.sections);
+            merge(old_side.symbols, new_side.symbols, result.symbols);
+            return true;
+        }
+
+        bool empty() const { return sections.empty() && symbols.empty(); }
+    };
+}
+
+
+#endif //ELF_ELF_DIFF_HPP
@@ -0,0 +1,458 @@
+#ifndef ELF_ELF_GENERATOR_HPP
+#define ELF_ELF_GENERATOR_HPP
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+#include "string_table_builder.hpp"
+
+
+namespace elf {
+    struct GeneratorOptions {
+        /// all names, section assignments and relocation targets are derived from this value.
+        u64 seed = 0;
+        /// lower bound of the number of sections, the null section and the tables are included.
+        usize section_num = 0;
+        /// number of symbols, the null symbol is not included.
+        usize symbol_num = 0;
+        /// number of entries in `.rela.text`, the section is omitted if zero.
+        usize relocation_num = 0;
+        /// lower bound of the size of `.strtab` in bytes, symbol names are padded to reach it.
+        usize string_table_size = 0;
+        /// size of `.text` in bytes.
+        usize text_size = 4096;
+        bool big_endian = false;
+    };
+
+    /// writes a deterministic relocatable object for stress tests. Layout of the file:
+    ///
+    ///     ELF header, .text, .symtab, .symtab_shndx, .rela.text, .strtab, .shstrtab, section header table
+    ///
+    /// and the section header table is ordered as
+    ///
+    ///     null, .text, .text.s0 ... .text.sN, .rela.text, .symtab, .symtab_shndx, .strtab, .shstrtab
+    ///
+    /// so that objects with more than `INDEX_LOW_RESERVE` sections use extended section numbering for the section
+    /// number, the section name string table index and the symbol section indices, like real `-ffunction-sections`
+    /// objects do.
+    template<typename USizeT>
+    class ELFGenerator {
+    private:
+        using ELFHeaderT = ELFHeader<USizeT>;
+        using SectionHeaderT = SectionHeader<USizeT>;
+        using SymbolTableHeaderT = _SymbolTableHeader<USizeT>;
+        using SymbolTableEntryT = typename SymbolTableHeaderT::SymbolTableEntry;
+        using RelocationAddendEntryT = RelocationAddendEntry<USizeT>;
+
+        static constexpr usize CHUNK_SIZE = 4096;
+        static constexpr usize NAME_PREFIX_SIZE = 18;
+
+        GeneratorOptions options;
+
+        usize filler_num;
+        usize local_num;
+        usize name_average;
+        bool extended_symbol_index;
+
+        usize text_index;
+        usize relocation_index;
+        usize symbol_table_index;
+        usize symbol_index_table_index;
+        usize string_table_index;
+        usize section_string_table_index;
+        usize section_num;
+
+        static u64 mix(u64 val) {
+            val += 0x9e3779b97f4a7c15ull;
+            val = (val ^ (val >> 30u)) * 0xbf58476d1ce4e5b9ull;
+            val = (val ^ (val >> 27u)) * 0x94d049bb133111ebull;
+            return val ^ (val >> 31u);
+        }
+
+        u64 random(u64 stream, u64 index) const { return mix(mix(options.seed ^ stream) + index); }
+
+        static usize align(usize val, usize alignment) { return (val + alignment - 1) / alignment * alignment; }
+
+        /// length of the name of symbol `index` (starting from 1), without the terminating zero.
+        usize name_length(usize index) const {
+            if (name_average <= NAME_PREFIX_SIZE) return NAME_PREFIX_SIZE;
+            usize spread = name_average - NAME_PREFIX_SIZE;
+            return NAME_PREFIX_SIZE + spread / 2 + random(1, index) % (spread + 1);
+        }
+
+        /// the prefix `s<16 hex digits>_` keeps every name unique, the rest is filled with letters.
+        void write_name(usize index, char *out) const {
+            static const char digits[] = "0123456789abcdef";
+
+            usize length = name_length(index);
+            out[0] = 's';
+            for (usize i = 0; i < 16; ++i) out[1 + i] = digits[(static_cast<u64>(index) >> ((15 - i) * 4)) & 0xfu];
+            out[17] = '_';
+            for (usize i = NAME_PREFIX_SIZE; i < length; ++i) {
+                out[i] = static_cast<char>('a' + random(2, index * 64 + i % 64) % 26);
+            }
+            out[length] = '\0';
+        }
+
+        usize symbol_section(usize index) const { return text_index + random(3, index) % (filler_num + 1); }
+
+        template<typename T>
+        T target(T val) const {
+            return options.big_endian == (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__) ? val : byte_swap(val);
+        }
+
+        template<typename T, typename E>
+        E target_enum(E val) const { return static_cast<E>(target(static_cast<T>(val))); }
+
+        void to_target(ELFHeaderT &header) const {
+            header.file_type = target_enum<u16>(header.file_type);
+            header.machine_type = target_enum<u16>(header.machine_type);
+            header.version = target(header.version);
+            header.entry_point = target(header.entry_point);
+            header.program_header_offset = target(header.program_header_offset);
+            header.section_header_offset = target(header.section_header_offset);
+            header.flags = target(header.flags);
+            header.elf_header_size = target(header.elf_header_size);
+            header.program_header_size = target(header.program_header_size);
+            header.program_header_num = target(header.program_header_num);
+            header.section_header_size = target(header.section_header_size);
+            header.section_header_num = target(header.section_header_num);
+            header.string_table_index = target(header.string_table_index);
+        }
+
+        void to_target(SectionHeaderT &section) const {
+            section.name = target(section.name);
+            section.section_type = target_enum<u32>(section.section_type);
+            section.flags = target(section.flags);
+            section.address = target(section.address);
+            section.offset = target(section.offset);
+            section.size = target(section.size);
+            section.link = target(section.link);
+            section.info = target(section.info);
+            section.alignment = target(section.alignment);
+            section.entry_size = target(section.entry_size);
+        }
+
+        void to_target(SymbolTableEntryT &symbol) const {
+            symbol.name = target(symbol.name);
+            symbol.section_header_index = target(symbol.section_header_index);
+            symbol.value = target(symbol.value);
+            symbol.size = target(symbol.size);
+        }
+
+        void to_target(RelocationAddendEntryT &relocation) const {
+            relocation.offset = target(relocation.offset);
+            relocation.info = target(relocation.info);
+            relocation.addend = target(relocation.addend);
+        }
+
+        void to_target(u32 &val) const { val = target(val); }
+
+        template<typename T>
+        static bool write_array(FILE *file, const std::vector<T> &buffer) {
+            return fwrite(buffer.data(), sizeof(T), buffer.size(), file) == buffer.size();
+        }
+
+        static bool write_zero(FILE *file, usize size) {
+            static const u8 zero[CHUNK_SIZE]{};
+            for (; size > CHUNK_SIZE; size -= CHUNK_SIZE) {
+                if (fwrite(zero, 1, CHUNK_SIZE, file) != CHUNK_SIZE) return false;
+            }
+            return fwrite(zero, 1, size, file) == size;
+        }
+
+        /// pads the file up to `offset`.
+        static bool seek(FILE *file, usize &position, usize offset) {
+            bool success = write_zero(file, offset - position);
+            position = offset;
+            return success;
+        }
+
+        /// emits entries `begin` to `end` generated by `make` in chunks, in target byte order.
+        template<typename T, typename F>
+        bool write_entries(FILE *file, usize begin, usize end, F make) const {
+            std::vector<T> buffer;
+            buffer.reserve(CHUNK_SIZE);
+
+            for (usize i = begin; i < end; ++i) {
+                buffer.push_back(make(i));
+                to_target(buffer.back());
+                if (buffer.size() == CHUNK_SIZE) {
+                    if (!write_array(file, buffer)) return false;
+                    buffer.clear();
+                }
+            }
+
+            return write_array(file, buffer);
+        }
+
+        SymbolTableEntryT make_symbol(usize index, usize &name_offset) const {
+            SymbolTableEntryT symbol{};
+            if (index == 0) return symbol;
+
+            usize section = symbol_section(index);
+            u8 bind = index <= local_num ? SymbolTableHeaderT::LOCAL : SymbolTableHeaderT::GLOBAL;
+            u8 type = random(4, index) % 2 == 0 ? SymbolTableHeaderT::FUNCTION : SymbolTableHeaderT::OBJECT;
+
+            symbol.name = name_offset;
+            symbol.info = static_cast<u8>(bind << 4u | type);
+            symbol.section_header_index = section >= SectionHeaderT::INDEX_LOW_RESERVE ?
+                                          SectionHeaderT::INDEX_EXTENDED : section;
+            if (section == text_index && options.text_size != 0) {
+                symbol.value = random(5, index) % options.text_size;
+                symbol.size = std::min<usize>(16, options.text_size - symbol.value);
+            }
+
+            name_offset += name_length(index) + 1;
+            return symbol;
+        }
+
+        RelocationAddendEntryT make_relocation(usize index) const {
+            RelocationAddendEntryT relocation{};
+            /// ELF32 relocations only have 24 bits for the symbol index.
+            usize symbol_limit = sizeof(USizeT) == 8 ? options.symbol_num :
+                                 std::min<usize>(options.symbol_num, 0xffffff);
+            usize symbol = symbol_limit == 0 ? 0 : 1 + random(6, index) % symbol_limit;
+
+            relocation.offset = options.text_size < sizeof(USizeT) ? 0 :
+                                random(7, index) % (options.text_size - sizeof(USizeT) + 1);
+            relocation.info = sizeof(USizeT) == 8 ? static_cast<USizeT>(static_cast<u64>(symbol) << 32u | 1u) :
+                              static_cast<USizeT>(symbol << 8u | 1u);
+            relocation.addend = random(8, index) % 64;
+            return relocation;
+        }
+
+        typename ELFHeaderT::MachineType machine_type() const {
+            if (sizeof(USizeT) == 8) {
+                return static_cast<typename ELFHeaderT::MachineType>(options.big_endian ? 21 : 62); // PPC64, X86_64
+            } else {
+                return static_cast<typename ELFHeaderT::MachineType>(options.big_endian ? 20 : 3); // PPC, 386
+            }
+        }
+
+    public:
+        explicit ELFGenerator(const GeneratorOptions &options) : options{options} {
+            usize table_num = 5 + (options.relocation_num > 0 ? 1 : 0);
+            filler_num = options.section_num > table_num ? options.section_num - table_num : 0;
+            extended_symbol_index = options.symbol_num > 0 && 1 + filler_num >= SectionHeaderT::INDEX_LOW_RESERVE;
+            local_num = options.symbol_num / 8;
+            name_average = options.symbol_num == 0 ? 0 : options.string_table_size / options.symbol_num;
+            if (name_average > 0) name_average -= 1;
+
+            text_index = 1;
+            usize next = text_index + 1 + filler_num;
+            relocation_index = options.relocation_num > 0 ? next++ : 0;
+            symbol_table_index = next++;
+            symbol_index_table_index = extended_symbol_index ? next++ : 0;
+            string_table_index = next++;
+            section_string_table_index = next++;
+            section_num = next;
+        }
+
+        usize get_section_num() const { return section_num; }
+
+        bool write(const char *path) const {
+            FILE *file = fopen(path, "wb");
+            if (file == nullptr) {
+                elf_warn("failed to create file!");
+                return false;
+            }
+
+            bool success = write(file);
+            if (fclose(file) != 0) success = false;
+            if (!success) elf_warn("failed to write file!");
+
+            return success;
+        }
+
+        bool write(FILE *file) const {
+            usize symbol_count = options.symbol_num + 1;
+
+            /// section names are set once the table is laid out, `.text` shares the tail of `.rela.text`.
+            StringTableBuilder section_names{};
+            std::vector<u32> name_ids(section_num);
+            std::vector<SectionHeaderT> sections(section_num);
+            auto add_name = [&](SectionHeaderT &section, const std::string &name) {
+                name_ids[&section - sections.data()] = section_names.add(name.data(), name.size());
+            };
+
+            usize string_size = 1;
+            for (usize i = 1; i < symbol_count; ++i) string_size += name_length(i) + 1;
+
+            usize position = 0;
+            usize offset = sizeof(ELFHeaderT);
+
+            SectionHeaderT &text = sections[text_index];
+            add_name(text, ".text");
+            text.section_type = SectionHeaderT::PROGRAM_BITS;
+            text.flags = SectionHeaderT::ALLOCATE | SectionHeaderT::EXECUTABLE;
+            text.offset = offset = align(offset, 16);
+            text.size = options.text_size;
+            text.alignment = 16;
+            offset += text.size;
+
+            for (usize i = 0; i < filler_num; ++i) {
+                SectionHeaderT &filler = sections[text_index + 1 + i];
+                add_name(filler, ".text.s" + std::to_string(i));
+                filler.section_type = SectionHeaderT::PROGRAM_BITS;
+                filler.flags = SectionHeaderT::ALLOCATE | SectionHeaderT::EXECUTABLE;
+                filler.offset = offset;
+                filler.alignment = 1;
+            }
+
+            SectionHeaderT &symbol_table = sections[symbol_table_index];
+            add_name(symbol_table, ".symtab");
+            symbol_table.section_type = SectionHeaderT::SYMBOL_TABLE;
+            symbol_table.offset = offset = align(offset, sizeof(USizeT));
+            symbol_table.size = symbol_count * sizeof(SymbolTableEntryT);
+            symbol_table.link = string_table_index;
+            symbol_table.info = local_num + 1;
+            symbol_table.alignment = sizeof(USizeT);
+            symbol_table.entry_size = sizeof(SymbolTableEntryT);
+            offset += symbol_table.size;
+
+            if (extended_symbol_index) {
+                SectionHeaderT &symbol_index_table = sections[symbol_index_table_index];
+                add_name(symbol_index_table, ".symtab_shndx");
+                symbol_index_table.section_type = SectionHeaderT::SYMBOL_TABLE_INDEX;
+                symbol_index_table.offset = offset;
+                symbol_index_table.size = symbol_count * sizeof(u32);
+                symbol_index_table.link = symbol_table_index;
+                symbol_index_table.alignment = sizeof(u32);
+                symbol_index_table.entry_size = sizeof(u32);
+                offset += symbol_index_table.size;
+            }
+
+            if (relocation_index != 0) {
+                SectionHeaderT &relocation = sections[relocation_index];
+                add_name(relocation, ".rela.text");
+                relocation.section_type = SectionHeaderT::RELOCATION_ADDEND_TABLE;
+                relocation.offset = offset = align(offset, sizeof(USizeT));
+                relocation.size = options.relocation_num * sizeof(RelocationAddendEntryT);
+                relocation.link = symbol_table_index;
+                relocation.info = text_index;
+                relocation.alignment = sizeof(USizeT);
+                relocation.entry_size = sizeof(RelocationAddendEntryT);
+                offset += relocation.size;
+            }
+
+            SectionHeaderT &string_table = sections[string_table_index];
+            add_name(string_table, ".strtab");
+            string_table.section_type = SectionHeaderT::STRING_TABLE;
+            string_table.offset = offset;
+            string_table.size = string_size;
+            string_table.alignment = 1;
+            offset += string_table.size;
+
+            SectionHeaderT &section_string_table = sections[section_string_table_index];
+            add_name(section_string_table, ".shstrtab");
+            section_names.finalize();
+            for (usize i = 1; i < section_num; ++i) sections[i].name = section_names.get_offset(name_ids[i]);
+            section_string_table.section_type = SectionHeaderT::STRING_TABLE;
+            section_string_table.offset = offset;
+            section_string_table.size = section_names.size();
+            section_string_table.alignment = 1;
+            offset += section_string_table.size;
+
+            usize section_header_offset = align(offset, sizeof(USizeT));
+
+            if (section_num >= SectionHeaderT::INDEX_LOW_RESERVE) sections[0].size = section_num;
+            if (section_string_table_index >= SectionHeaderT::INDEX_LOW_RESERVE) {
+                sections[0].link = section_string_table_index;
+            }
+
+            u8 header_buffer[sizeof(ELFHeaderT)]{};
+            auto *header = reinterpret_cast<ELFHeaderT *>(header_buffer);
+            header->magic_number[0] = ELFHeaderT::MAGIC_0;
+            header->magic_number[1] = ELFHeaderT::MAGIC_1;
+            header->magic_number[2] = ELFHeaderT::MAGIC_2;
+            header->magic_number[3] = ELFHeaderT::MAGIC_3;
+            header->elf_class = sizeof(USizeT) == 8 ? ELFHeaderT::ELF64 : ELFHeaderT::ELF32;
+            header->data_encoding = options.big_endian ? ELFHeaderT::DATA_BIG_ENDIAN : ELFHeaderT::DATA_LITTLE_ENDIAN;
+            header->identification_version = 1;
+            header->file_type = ELFHeaderT::RELOCATABLE;
+            header->machine_type = machine_type();
+            header->version = 1;
+            header->section_header_offset = section_header_offset;
+            header->elf_header_size = sizeof(ELFHeaderT);
+            header->program_header_size = sizeof(ProgramHeader<USizeT>);
+            header->section_header_size = sizeof(SectionHeaderT);
+            header->section_header_num = section_num >= SectionHeaderT::INDEX_LOW_RESERVE ? 0 : section_num;
+            header->string_table_index = section_string_table_index >= SectionHeaderT::INDEX_LOW_RESERVE ?
+                                         SectionHeaderT::INDEX_EXTENDED : section_string_table_index;
+            to_target(*header);
+
+            if (fwrite(header_buffer, sizeof(header_buffer), 1, file) != 1) return false;
+            position = sizeof(ELFHeaderT);
+
+            if (!seek(file, position, text.offset) || !write_zero(file, text.size)) return false;
+            position += text.size;
+
+            usize name_offset = 1;
+            if (!seek(file, position, symbol_table.offset) ||
+                !write_entries<SymbolTableEntryT>(file, 0, symbol_count, [&](usize i) {
+                    return make_symbol(i, name_offset);
+                }))
+                return false;
+            position += symbol_table.size;
+
+            if (extended_symbol_index) {
+                if (!write_entries<u32>(file, 0, symbol_count, [&](usize i) {
+                    usize section = i == 0 ? 0 : symbol_section(i);
+                    return static_cast<u32>(section >= SectionHeaderT::INDEX_LOW_RESERVE ? section : 0);
+                }))
+                    return false;
+                position += symbol_count * sizeof(u32);
+            }
+
+            if (relocation_index != 0) {
+                const SectionHeaderT &relocation = sections[relocation_index];
+                if (!seek(file, position, relocation.offset) ||
+                    !write_entries<RelocationAddendEntryT>(file, 0, options.relocation_num, [&](usize i) {
+                        return make_relocation(i);
+                    }))
+                    return false;
+                position += relocation.size;
+            }
+
+            std::vector<char> names;
+            names.reserve(CHUNK_SIZE * 2);
+            names.push_back('\0');
+            for (usize i = 1; i < symbol_count; ++i) {
+                usize size = names.size();
+                names.resize(size + name_length(i) + 1);
+                write_name(i, &names[size]);
+                if (names.size() >= CHUNK_SIZE) {
+                    if (!write_array(file, names)) return false;
+                    names.clear();
+                }
+            }
+            if (!write_array(file, names)) return false;
+            position += string_table.size;
+
+            if (!write_array(file, section_names.get_data())) return false;
+            position += section_names.size();
+
+            if (!seek(file, position, section_header_offset)) return false;
+            for (auto &section: sections) to_target(section);
+            return write_array(file, sections);
+        }
+    };
+}
+
+namespace elf32 {
+    using ELFGenerator = elf::ELFGenerator<elf::u32>;
+}
+
+namespace elf64 {
+    using ELFGenerator = elf::ELFGenerator<elf::u64>;
+}
+
+
+#endif //ELF_ELF_GENERATOR_HPP
@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <cstring>
+#include <vector>
 
 #include "elf_utility.hpp"
 #include "section_header.hpp"
@@ -11,6 +12,15 @@
 
 
 namespace elf {
+    /// return 1 for an ELF32 file and 2 for an ELF64 file in host byte order, 0 for anything else. The structures
+    /// are used in host byte order, so this decides which `ELFHeader` specialization may read the file.
+    inline u8 get_elf_class(MappedFileVisitor &visitor) {
+        auto *ident = static_cast<const u8 *>(visitor.address(0, 16));
+        if (ident == nullptr || memcmp(ident, "\x7f" "ELF", 4) != 0) return 0;
+        if (ident[5] != (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? 1 : 2)) return 0;
+        return ident[4] == 1 || ident[4] == 2 ? ident[4] : 0;
+    }
+
     template<typename USizeT>
     class ELFHeader {
     public:
@@ -63,14 +73,16 @@ namespace elf {
 
             Iter end() const {
                 void *ptr = visitor.trusted_address(
-                        header.section_header_offset + header.section_header_num * header.section_header_size);
+                        header.section_header_offset + static_cast<u64>(size()) * header.section_header_size);
                 return Iter{reinterpret_cast<SectionHeaderT *>(ptr), header.section_header_size};
             }
 
             SectionHeaderT &operator[](usize index) const {
-                if (index >= header.section_header_num) elf_abort("index out of boundary!");
+                if (index >= size()) elf_abort("index out of boundary!");
                 return begin()[index];
             }
+
+            usize size() const { return header.get_section_num(visitor); }
         };
 
         elf_enum_display(ELFClass, u8, 2,
@@ -97,7 +109,7 @@ namespace elf {
                          CORE, 4
         );
 
-        elf_enum_display(MachineType, u16, 9,
+        elf_enum_display(MachineType, u16, 12,
                          MACHINE_NONE, 0,       /// No machine
                          SPARC, 2,              /// SPARC
                          INTEL_80386, 3,        /// Intel Architecture
@@ -106,6 +118,9 @@ namespace elf {
                          INTEL_80860, 6,        /// Intel 80860
                          MIPS_RS3000_BE, 8,     /// MIPS RS3000 Big-Endian
                          MIPS_RS4000_BE, 10,    /// MIPS RS4000 Big-Endian
+                         ARM, 40,               /// ARM 32-bit
+                         X86_64, 62,            /// AMD x86-64
+                         AARCH64, 183,          /// ARM 64-bit
                          RISCV, 243             /// RISCV
         );
 
@@ -116,33 +131,75 @@ namespace elf {
 
         static ELFHeader *read(MappedFileVisitor &visitor) {
             ELFHeader *header = reinterpret_cast<ELFHeader *>(visitor.address(0, sizeof(ELFHeader)));
-            if (header == nullptr) return nullptr;
+            if (header == nullptr || !header->check(visitor.get_end())) return nullptr;
+
+            if (header->is_extended()) {
+                auto *first = static_cast<SectionHeaderT *>(visitor.trusted_address(header->section_header_offset));
+                if (!header->check_extended(*first, visitor.get_end())) return nullptr;
+            }
+
+            return header;
+        }
+
+        /// the checks of `read` against a file of `file_size` bytes, for a header obtained otherwise, e.g. through
+        /// a `WindowedFileVisitor`. With extended section numbering, `check_extended` must pass too.
+        bool check(u64 file_size) const {
+            auto in_file = [file_size](u64 offset, u64 len) { return len <= file_size && offset <= file_size - len; };
 
             // check magic number
-            if (header->magic_number[0] != ELFHeader::MAGIC_0 ||
-                header->magic_number[1] != ELFHeader::MAGIC_1 ||
-                header->magic_number[2] != ELFHeader::MAGIC_2 ||
-                header->magic_number[3] != ELFHeader::MAGIC_3)
-                return nullptr;
+            if (magic_number[0] != ELFHeader::MAGIC_0 ||
+                magic_number[1] != ELFHeader::MAGIC_1 ||
+                magic_number[2] != ELFHeader::MAGIC_2 ||
+                magic_number[3] != ELFHeader::MAGIC_3)
+                return false;
 
-            if (header->elf_header_size < sizeof(ELFHeader)) return nullptr;
+            if (elf_header_size < sizeof(ELFHeader)) return false;
 
             // check program header size and location in file
-            if (header->program_header_size < sizeof(ProgramHeaderT)) return nullptr;
-            if (!visitor.check_address(header->program_header_offset,
-                                       header->program_header_num * header->program_header_size))
-                return nullptr;
+            if (program_header_num != 0 && program_header_size < sizeof(ProgramHeaderT)) return false;
+            if (!in_file(program_header_offset, program_header_num * program_header_size)) return false;
 
-            // check section header size and location in file
-            if (header->section_header_size < sizeof(SectionHeaderT)) return nullptr;
-            if (!visitor.check_address(header->section_header_offset,
-                                       header->section_header_num * header->section_header_size))
-                return nullptr;
+            // check section header size and location in file, only section 0 with extended numbering
+            u64 table_num = section_header_num != 0 ? section_header_num : section_header_offset != 0 ? 1 : 0;
+            if (table_num != 0 && section_header_size < sizeof(SectionHeaderT)) return false;
+            if (!in_file(section_header_offset, table_num * section_header_size)) return false;
 
-            // check string table index
-            if (header->string_table_index > header->section_header_num) return nullptr;
+            // check string table index, see `check_extended` with extended numbering
+            if (string_table_index == SectionHeaderT::INDEX_EXTENDED) return table_num != 0;
+            if (section_header_num != 0 && string_table_index > section_header_num) return false;
 
-            return header;
+            return true;
+        }
+
+        /// whether the section number or the section name string table index is stored in section 0, which is the
+        /// case when they do not fit below SHN_LORESERVE.
+        bool is_extended() const {
+            return (section_header_num == 0 && section_header_offset != 0) ||
+                   string_table_index == SectionHeaderT::INDEX_EXTENDED;
+        }
+
+        /// checks of the section header table extent and the section name string table index with extended
+        /// section numbering, `first` is section 0.
+        bool check_extended(const SectionHeaderT &first, u64 file_size) const {
+            u64 num = section_header_num != 0 ? section_header_num : static_cast<u64>(first.size);
+            if (num > static_cast<usize>(-1) / section_header_size) return false;
+            if (num * section_header_size > file_size || section_header_offset > file_size - num * section_header_size)
+                return false;
+
+            u64 index = string_table_index != SectionHeaderT::INDEX_EXTENDED ? string_table_index : first.link;
+            return index == 0 || index < num;
+        }
+
+        /// number of sections, from the size of section 0 with extended section numbering.
+        usize get_section_num(MappedFileVisitor &visitor) const {
+            if (section_header_num != 0 || section_header_offset == 0) return section_header_num;
+            return static_cast<SectionHeaderT *>(visitor.trusted_address(section_header_offset))->size;
+        }
+
+        /// index of the section name string table, from the link of section 0 with extended section numbering.
+        usize get_section_string_table_index(MappedFileVisitor &visitor) const {
+            if (string_table_index != SectionHeaderT::INDEX_EXTENDED) return string_table_index;
+            return static_cast<SectionHeaderT *>(visitor.trusted_address(section_header_offset))->link;
         }
 
         /// contain a “magic number,” identifying the file as an ELF object file. They contain the
@@ -208,6 +265,13 @@ namespace elf {
 
         ELFHeader &operator=(const ELFHeader &other) = delete;
 
+        /// patch a field in place, as `header->set(visitor, &ELFHeaderT::entry_point, address)`. Return false if
+        /// `visitor` is not writable or `val` does not fit the field, see `MappedFileVisitor::open_elf_writable`.
+        template<typename FieldT, typename ValueT>
+        bool set(MappedFileVisitor &visitor, FieldT ELFHeader::*field, ValueT val) {
+            return visitor.write(&(this->*field), val);
+        }
+
         friend std::ostream &operator<<(std::ostream &stream, const ELFHeader &self) {
             stream << "class ELF" << sizeof(USizeT) * 8 << "Header {\n";
             stream << "\tmagic_number: " << self.magic_number << ",\n";
@@ -240,7 +304,52 @@ namespace elf {
 
         StringTableHeader<USizeT> *get_section_string_table_header(MappedFileVisitor &visitor) {
             return SectionHeader<USizeT>::template cast<StringTableHeader<USizeT>>(
-                    &sections(visitor)[string_table_index], visitor);
+                    &sections(visitor)[get_section_string_table_index(visitor)], visitor);
+        }
+
+        /// the SHT_SYMTAB_SHNDX section of the symbol table at `symbol_table_index`, nullptr if there is none.
+        SymbolTableIndexHeader<USizeT> *get_symbol_table_index_header(usize symbol_table_index,
+                                                                      MappedFileVisitor &visitor) {
+            for (auto &section: sections(visitor)) {
+                if (section.section_type != SectionHeaderT::SYMBOL_TABLE_INDEX || section.link != symbol_table_index) {
+                    continue;
+                }
+                return SectionHeaderT::template cast<SymbolTableIndexHeader<USizeT>>(&section, visitor);
+            }
+
+            return nullptr;
+        }
+
+        /// names of the symbol versions by version index, from the SHT_GNU_verdef and SHT_GNU_verneed sections,
+        /// nullptr for indices without a name. Return false if a version section is malformed.
+        bool get_version_names(MappedFileVisitor &visitor, std::vector<const char *> &names) {
+            names.clear();
+            usize section_num = get_section_num(visitor);
+
+            for (auto &section: sections(visitor)) {
+                std::vector<u32> offsets;
+                if (section.section_type == SectionHeaderT::VERSION_DEF) {
+                    auto *header = SectionHeaderT::template cast<VersionDefinitionHeader<USizeT>>(&section, visitor);
+                    if (header == nullptr || !header->get_names(visitor, offsets)) return false;
+                } else if (section.section_type == SectionHeaderT::VERSION_NEED) {
+                    auto *header = SectionHeaderT::template cast<VersionNeedHeader<USizeT>>(&section, visitor);
+                    if (header == nullptr || !header->get_names(visitor, offsets)) return false;
+                } else {
+                    continue;
+                }
+
+                if (section.link >= section_num) return false;
+                auto *strings = SectionHeaderT::template cast<StringTableHeader<USizeT>>(
+                        &sections(visitor)[section.link], visitor);
+                if (strings == nullptr) return false;
+
+                if (names.size() < offsets.size()) names.resize(offsets.size(), nullptr);
+                for (usize i = 0; i < offsets.size(); ++i) {
+                    if (offsets[i] != 0) names[i] = strings->get_table(visitor).get_str(offsets[i], nullptr);
+                }
+            }
+
+            return true;
         }
 
         typename StringTableHeader<USizeT>::TableT get_section_string_table(MappedFileVisitor &visitor) {
@@ -249,6 +358,24 @@ namespace elf {
             return section_header_string_table_header->get_table(visitor);
         }
 
+        /// find the GNU build-id note in the note segments, return false if there is none.
+        bool get_build_id(MappedFileVisitor &visitor, const u8 *&build_id, usize &size) {
+            for (auto &program: programs(visitor)) {
+                auto *note_header = ProgramHeaderT::template cast<NoteHeader<USizeT>>(&program, visitor);
+                if (note_header == nullptr) continue;
+
+                auto notes = note_header->get_table(visitor);
+                const Note *note = notes.find("GNU", Note::GNU_BUILD_ID);
+                if (note == nullptr) continue;
+
+                build_id = note->get_desc(notes.get_alignment());
+                size = note->desc_size;
+                return true;
+            }
+
+            return false;
+        }
+
         /// if the section string table is invalid, this function will abort
         template<typename SectionT>
         SectionT *get_section_header(const char *section_name, MappedFileVisitor &visitor) {
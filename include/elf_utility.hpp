@@ -2,9 +2,14 @@
 #define ELF_UTILITY_HPP
 
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
 #include <cstddef>
+#include <thread>
 #include <type_traits>
+#include <vector>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -74,6 +79,14 @@ namespace elf {
     using usize = u_int32_t;
 #endif
 
+    elf_static_inline u8 byte_swap(u8 val) { return val; }
+
+    elf_static_inline u16 byte_swap(u16 val) { return __builtin_bswap16(val); }
+
+    elf_static_inline u32 byte_swap(u32 val) { return __builtin_bswap32(val); }
+
+    elf_static_inline u64 byte_swap(u64 val) { return __builtin_bswap64(val); }
+
     template<typename T, usize end, usize begin>
     struct bits_mask {
     private:
@@ -117,35 +130,64 @@ namespace elf {
         int fd;
         void *inner;
         usize size;
+        /// file offset of `inner`, 0 unless the visitor maps a window of the file, see `map_range`.
+        u64 origin;
+        /// false for views over memory the visitor does not map itself, see `borrow`.
+        bool owned;
+        /// a shared read-write mapping, see `open_elf_writable`.
+        bool writable;
+        /// range of the mapping written since the last `commit`, empty when `dirty_begin == dirty_end`.
+        usize dirty_begin;
+        usize dirty_end;
 
         void clear() {
             fd = -1;
             inner = nullptr;
             size = 0;
+            origin = 0;
+            owned = false;
+            writable = false;
+            dirty_begin = 0;
+            dirty_end = 0;
         }
 
         void release() {
-            munmap(inner, size);
-            if (fd != -1) { close(fd); }
+            if (owned) {
+                munmap(inner, size);
+                if (fd != -1) { close(fd); }
+            }
             clear();
         }
 
-        bool load_file(int _fd) {
+        bool load_file(int _fd, bool _writable = false) {
             release();
 
             fd = _fd;
+            owned = true;
+            writable = _writable;
 
             struct stat file_stat{};
             if (fstat(fd, &file_stat) != 0) {
                 elf_warn("fstat failed!");
                 return false;
             }
+            if (static_cast<u64>(file_stat.st_size) > static_cast<usize>(-1)) {
+                elf_warn("file too large to be mapped at once, use WindowedFileVisitor!");
+                return false;
+            }
             size = file_stat.st_size;
 
-            inner = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (writable) {
+                inner = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            } else {
+                inner = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
 
             if (inner == MAP_FAILED) {
                 elf_warn("mmap failed!");
+                inner = nullptr;
+                size = 0;
+                writable = false;
                 return false;
             } else {
                 return true;
@@ -170,10 +212,60 @@ namespace elf {
             return open_elf(fd);
         }
 
-        MappedFileVisitor() : fd{-1}, inner{nullptr}, size{0} {}
+        /// map the file shared and writable, so that the setters of the headers patch it in place. Every write is
+        /// in the page cache at once, visible to other readers of the file; `commit` only makes the written pages
+        /// durable on disk. The size of the file is fixed.
+        static MappedFileVisitor open_elf_writable(const char *name) {
+            MappedFileVisitor elf_visitor{};
+            int fd = open(name, O_RDWR);
+            if (fd == -1) {
+                elf_warn("open failed!");
+                return elf_visitor;
+            }
+            elf_visitor.load_file(fd, true);
+            return elf_visitor;
+        }
+
+        /// view over `size` bytes at `address` that stay owned by the caller, such as an image already loaded in
+        /// this process. Nothing is unmapped or closed on release, and `get_fd` returns -1.
+        static MappedFileVisitor borrow(void *address, usize size) {
+            MappedFileVisitor elf_visitor{};
+            elf_visitor.inner = address;
+            elf_visitor.size = size;
+            return elf_visitor;
+        }
+
+        /// map `size` bytes of `fd` from `origin`, a multiple of the page size. Offsets are still file offsets, only
+        /// the ones in the mapped range pass `check_address`. `fd` stays owned by the caller.
+        static MappedFileVisitor map_range(int fd, u64 origin, usize size) {
+            MappedFileVisitor elf_visitor{};
+
+            if (static_cast<u64>(static_cast<off_t>(origin)) != origin) {
+                elf_warn("offset out of off_t, build with _FILE_OFFSET_BITS=64!");
+                return elf_visitor;
+            }
+
+            void *inner = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(origin));
+            if (inner == MAP_FAILED) {
+                elf_warn("mmap failed!");
+                return elf_visitor;
+            }
+
+            elf_visitor.inner = inner;
+            elf_visitor.size = size;
+            elf_visitor.origin = origin;
+            elf_visitor.owned = true;
+            return elf_visitor;
+        }
+
+        MappedFileVisitor() : fd{-1}, inner{nullptr}, size{0}, origin{0}, owned{false}, writable{false},
+                              dirty_begin{0}, dirty_end{0} {}
 
         MappedFileVisitor(MappedFileVisitor &&other) noexcept:
-                fd{other.fd}, inner{other.inner}, size{other.size} { other.clear(); }
+                fd{other.fd}, inner{other.inner}, size{other.size}, origin{other.origin}, owned{other.owned},
+                writable{other.writable}, dirty_begin{other.dirty_begin}, dirty_end{other.dirty_end} {
+            other.clear();
+        }
 
         MappedFileVisitor &operator=(MappedFileVisitor &&other) noexcept {
             if (this != &other) {
@@ -182,6 +274,11 @@ namespace elf {
                 this->fd = other.fd;
                 this->inner = other.inner;
                 this->size = other.size;
+                this->origin = other.origin;
+                this->owned = other.owned;
+                this->writable = other.writable;
+                this->dirty_begin = other.dirty_begin;
+                this->dirty_end = other.dirty_end;
 
                 other.clear();
             }
@@ -189,16 +286,74 @@ namespace elf {
             return *this;
         }
 
-        bool check_address(usize offset, usize len) const { return len <= size && offset <= size - len; }
+        /// offsets are u64 so that ELF64 offsets are never truncated on 32-bit hosts.
+        bool check_address(u64 offset, u64 len) const {
+            return len <= size && offset >= origin && offset - origin <= size - len;
+        }
 
-        void *trusted_address(usize offset) const { return static_cast<u8 *>(inner) + offset; }
+        void *trusted_address(u64 offset) const { return static_cast<u8 *>(inner) + (offset - origin); }
 
-        void *address(usize offset, usize len) const {
+        void *address(u64 offset, u64 len) const {
             return check_address(offset, len) ? trusted_address(offset) : nullptr;
         }
 
+        bool is_writable() const { return writable; }
+
+        /// whether `val` converts to `FieldT` and back unchanged, so that `write` accepts it.
+        template<typename FieldT, typename ValueT>
+        static bool fits(ValueT val) { return static_cast<ValueT>(static_cast<FieldT>(val)) == val; }
+
+        /// store `val` in `field`, which must lie in a writable mapping, return false if it does not or if `val`
+        /// does not fit the type of the field.
+        template<typename FieldT, typename ValueT>
+        bool write(FieldT *field, ValueT val) {
+            if (!fits<FieldT>(val)) return false;
+            auto converted = static_cast<FieldT>(val);
+            return write_bytes(field, &converted, sizeof(converted));
+        }
+
+        /// copy `len` bytes to `destination`, which must lie in a writable mapping.
+        bool write_bytes(void *destination, const void *source, usize len) {
+            if (!writable) return false;
+
+            auto position = static_cast<usize>(static_cast<u8 *>(destination) - static_cast<u8 *>(inner));
+            if (destination < inner || len > size || position > size - len) return false;
+
+            memcpy(destination, source, len);
+            if (dirty_begin == dirty_end) {
+                dirty_begin = position;
+                dirty_end = position + len;
+            } else {
+                dirty_begin = std::min(dirty_begin, position);
+                dirty_end = std::max(dirty_end, position + len);
+            }
+            return true;
+        }
+
+        /// flush the pages changed since the last commit to disk, and wait for them. The changes were visible before.
+        bool commit() {
+            if (dirty_begin == dirty_end) return true;
+
+            auto page_size = static_cast<usize>(sysconf(_SC_PAGESIZE));
+            usize begin = dirty_begin & ~(page_size - 1);
+            if (msync(static_cast<u8 *>(inner) + begin, dirty_end - begin, MS_SYNC) != 0) {
+                elf_warn("msync failed!");
+                return false;
+            }
+
+            dirty_begin = dirty_end = 0;
+            return true;
+        }
+
         int get_fd() const { return fd; }
 
+        usize get_size() const { return size; }
+
+        /// file offset of the first mapped byte, and the one past the last.
+        u64 get_origin() const { return origin; }
+
+        u64 get_end() const { return origin + size; }
+
         ~MappedFileVisitor() { release(); }
     };
 
@@ -248,6 +403,31 @@ namespace elf {
 
         return h;
     }
+
+    /// number of threads to run `task_num` tasks on: `thread_num`, or one per hardware thread if it is 0, but at
+    /// least one and no more than the tasks.
+    inline usize thread_count(usize thread_num, usize task_num) {
+        if (thread_num == 0) thread_num = std::max<usize>(std::thread::hardware_concurrency(), 1);
+        return std::max<usize>(std::min(thread_num, task_num), 1);
+    }
+
+    /// call `function(index, thread)` for every index in [0, count) on `thread_count(thread_num, count)` threads,
+    /// the calling one included. Indices are handed out one at a time, so uneven tasks still balance, and `thread`
+    /// tells which thread makes the call, for per-thread state sized with `thread_count`.
+    template<typename FunctionT>
+    void parallel_for(usize count, usize thread_num, FunctionT function) {
+        thread_num = thread_count(thread_num, count);
+
+        std::atomic<usize> next{0};
+        auto work = [&](usize thread) {
+            for (usize index = next++; index < count; index = next++) function(index, thread);
+        };
+
+        std::vector<std::thread> threads;
+        for (usize i = 1; i < thread_num; ++i) threads.emplace_back(work, i);
+        work(0);
+        for (auto &thread: threads) thread.join();
+    }
 }
 
 
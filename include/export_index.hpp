@@ -0,0 +1,483 @@
+#ifndef ELF_EXPORT_INDEX_HPP
+#define ELF_EXPORT_INDEX_HPP
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+
+
+namespace elf {
+    /// index of the symbols exported by a set of shared objects, answering "which libraries define X" from one
+    /// mapped file. The file holds a library table, a hash table of posting lists keyed by `gnu_hash` of the
+    /// symbol name, and a string pool, all in host byte order. A query hashes the name, and compares the few
+    /// postings of one bucket, without reading anything else.
+    ///
+    /// `write` scans the .dynsym of the libraries in parallel, with their versions from .gnu.version. Given the
+    /// previous index, a library whose inode, modification time and size did not change is not opened, and one
+    /// whose build-id did not change is not scanned, its postings are copied.
+    class ExportIndex {
+    public:
+        struct Definition {
+            const char *library;
+            /// nullptr for unversioned symbols.
+            const char *version;
+            /// STB_GLOBAL, STB_WEAK or STB_GNU_UNIQUE.
+            u8 binding;
+            /// the version is not the default one, the symbol only binds when asked for as name@version.
+            bool hidden;
+        };
+
+        /// identity of an indexed file, the file is scanned again when it changes.
+        struct FileId {
+            u64 inode;
+            i64 modify_time_ns;
+            u64 size;
+
+            bool operator==(const FileId &other) const {
+                return inode == other.inode && modify_time_ns == other.modify_time_ns && size == other.size;
+            }
+        };
+
+        struct Stats {
+            /// libraries scanned, copied from the previous index, and not readable as ELF shared objects.
+            usize scanned;
+            usize reused;
+            usize failed;
+            usize posting_num;
+        };
+
+    private:
+        static constexpr u32 FORMAT_VERSION = 1;
+
+        struct Header {
+            char magic[8];
+            u32 version;
+            u32 library_num;
+            u32 bucket_num;
+            u32 posting_num;
+            u64 library_offset;
+            u64 bucket_offset;
+            u64 posting_offset;
+            u64 string_offset;
+            u64 string_size;
+        };
+
+        struct Library {
+            u32 path;
+            /// string pool offset and size of the raw build-id bytes, which may hold NULs.
+            u32 build_id;
+            u32 build_id_size;
+            u32 reserved;
+            FileId id;
+        };
+
+        struct Posting {
+            u32 hash;
+            u32 name;
+            /// 0 for unversioned symbols.
+            u32 version;
+            u32 library;
+            u8 binding;
+            u8 hidden;
+            u16 reserved;
+        };
+
+        struct Export {
+            std::string name;
+            std::string version;
+            u8 binding;
+            bool hidden;
+        };
+
+        struct Scan {
+            bool exists;
+            bool reused;
+            bool valid;
+            FileId id;
+            std::string build_id;
+            std::vector<Export> exports;
+        };
+
+        MappedFileVisitor visitor;
+        const Header *header;
+        const Library *libraries;
+        const u32 *buckets;
+        const Posting *postings;
+        const char *strings;
+
+        const char *get_string(u32 offset) const { return offset < header->string_size ? strings + offset : nullptr; }
+
+        static bool get_file_id(const char *path, FileId &id) {
+            struct stat file_stat{};
+            if (stat(path, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) return false;
+#if defined(__APPLE__)
+            const struct timespec &time = file_stat.st_mtimespec;
+#else
+            const struct timespec &time = file_stat.st_mtim;
+#endif
+            id = FileId{static_cast<u64>(file_stat.st_ino), static_cast<i64>(time.tv_sec) * 1000000000 + time.tv_nsec,
+                        static_cast<u64>(file_stat.st_size)};
+            return true;
+        }
+
+        template<typename USizeT>
+        static bool scan_exports(ELFHeader<USizeT> *header, MappedFileVisitor &visitor, Scan &scan) {
+            using SectionHeaderT = SectionHeader<USizeT>;
+            using SymbolTableHeaderT = _SymbolTableHeader<USizeT>;
+
+            usize section_num = header->get_section_num(visitor);
+            auto sections = header->sections(visitor);
+
+            usize table_index = 0;
+            for (usize i = 0; i < section_num; ++i) {
+                if (sections[i].section_type == SectionHeaderT::DYNAMIC_SYMBOL_TABLE) {
+                    table_index = i;
+                    break;
+                }
+            }
+            if (table_index == 0) return false;
+
+            auto &table_section = sections[table_index];
+            auto *table = SectionHeaderT::template cast<DynSymbolTableHeader<USizeT>>(&table_section, visitor);
+            if (table == nullptr || table_section.link >= section_num) return false;
+            auto *string_header = SectionHeaderT::template cast<StringTableHeader<USizeT>>(
+                    &sections[table_section.link], visitor);
+            if (string_header == nullptr) return false;
+            auto names = string_header->get_table(visitor);
+
+            VersionSymbolTable versions{};
+            std::vector<const char *> version_names;
+            if (header->get_version_names(visitor, version_names)) {
+                for (auto &section: sections) {
+                    if (section.section_type != SectionHeaderT::VERSION_SYMBOL || section.link != table_index) continue;
+                    auto *version_header = SectionHeaderT::template cast<VersionSymbolHeader<USizeT>>(&section,
+                                                                                                      visitor);
+                    if (version_header != nullptr) versions = version_header->get_table(visitor);
+                    break;
+                }
+            }
+
+            usize index = 0;
+            for (auto &symbol: table->get_table(visitor)) {
+                usize symbol_index = index++;
+                if (symbol.section_header_index == SectionHeaderT::INDEX_UNDEFINED) continue;
+                if (symbol.get_bind() == SymbolTableHeaderT::LOCAL) continue;
+                auto visibility = symbol.get_visibility();
+                if (visibility == SymbolTableHeaderT::HIDDEN || visibility == SymbolTableHeaderT::INTERNAL) continue;
+
+                const char *name = names.get_str(symbol.name, nullptr);
+                if (name == nullptr || name[0] == '\0') continue;
+
+                Export entry{name, "", static_cast<u8>(symbol.get_bind()), versions.is_hidden(symbol_index)};
+                u16 version = versions.get_version(symbol_index);
+                if (version > VersionSymbolTable::GLOBAL && version < version_names.size() &&
+                    version_names[version] != nullptr) {
+                    entry.version = version_names[version];
+                }
+                scan.exports.push_back(std::move(entry));
+            }
+
+            return true;
+        }
+
+        template<typename USizeT>
+        static void read_build_id(ELFHeader<USizeT> *header, MappedFileVisitor &visitor, std::string &build_id) {
+            const u8 *bytes = nullptr;
+            usize size = 0;
+            if (header->get_build_id(visitor, bytes, size)) {
+                build_id.assign(reinterpret_cast<const char *>(bytes), size);
+            }
+        }
+
+        /// scan `path`, or copy its exports from `previous_library` of `previous`, whose postings are `cached`, if
+        /// it did not change.
+        static void scan_library(const std::string &path, const ExportIndex *previous,
+                                 const std::vector<u32> *cached, u32 previous_library, Scan &scan) {
+            scan.exists = get_file_id(path.c_str(), scan.id);
+            if (!scan.exists) return;
+
+            bool has_previous = previous != nullptr && previous_library != NONE;
+            const Library *old = has_previous ? &previous->libraries[previous_library] : nullptr;
+            if (has_previous && old->id == scan.id) {
+                previous->copy_exports(previous_library, *cached, scan);
+                return;
+            }
+
+            MappedFileVisitor file = MappedFileVisitor::open_elf(path.c_str());
+            u8 elf_class = get_elf_class(file);
+            ELFHeader<u32> *header32 = elf_class == 1 ? ELFHeader<u32>::read(file) : nullptr;
+            ELFHeader<u64> *header64 = elf_class == 2 ? ELFHeader<u64>::read(file) : nullptr;
+
+            if (header32 != nullptr) read_build_id(header32, file, scan.build_id);
+            if (header64 != nullptr) read_build_id(header64, file, scan.build_id);
+
+            if (has_previous && !scan.build_id.empty() && old->build_id_size == scan.build_id.size()) {
+                const char *build_id = previous->get_string(old->build_id);
+                if (build_id != nullptr && old->build_id + old->build_id_size <= previous->header->string_size &&
+                    memcmp(build_id, scan.build_id.data(), scan.build_id.size()) == 0) {
+                    FileId id = scan.id;
+                    previous->copy_exports(previous_library, *cached, scan);
+                    scan.id = id;
+                    return;
+                }
+            }
+
+            if (header32 != nullptr) scan.valid = scan_exports(header32, file, scan);
+            if (header64 != nullptr) scan.valid = scan_exports(header64, file, scan);
+        }
+
+        void copy_exports(u32 library, const std::vector<u32> &posting_indices, Scan &scan) const {
+            const Library &old = libraries[library];
+            scan.reused = true;
+            scan.valid = true;
+            scan.id = old.id;
+            if (old.build_id_size > 0 && old.build_id + old.build_id_size <= header->string_size) {
+                scan.build_id.assign(strings + old.build_id, old.build_id_size);
+            }
+
+            for (u32 index: posting_indices) {
+                const Posting &posting = postings[index];
+                const char *name = get_string(posting.name);
+                const char *version = get_string(posting.version);
+                if (name == nullptr || version == nullptr) continue;
+                scan.exports.push_back(Export{name, version, posting.binding, posting.hidden != 0});
+            }
+        }
+
+        static bool write_all(int fd, const void *data, usize size) {
+            auto *ptr = static_cast<const u8 *>(data);
+            while (size > 0) {
+                ssize_t ret = ::write(fd, ptr, size);
+                if (ret <= 0) return false;
+                ptr += ret;
+                size -= ret;
+            }
+            return true;
+        }
+
+        static constexpr u32 NONE = ~static_cast<u32>(0);
+
+    public:
+        ExportIndex() : visitor{}, header{nullptr}, libraries{nullptr}, buckets{nullptr}, postings{nullptr},
+                        strings{nullptr} {}
+
+        /// map the index at `path`, return false if it is missing or malformed.
+        static bool open(const char *path, ExportIndex &index) {
+            index = ExportIndex{};
+            index.visitor = MappedFileVisitor::open_elf(path);
+
+            MappedFileVisitor &visitor = index.visitor;
+            auto *header = static_cast<const Header *>(visitor.address(0, sizeof(Header)));
+            if (header == nullptr || memcmp(header->magic, "ELFSYMIX", 8) != 0) return false;
+            if (header->version != FORMAT_VERSION) return false;
+            if (header->bucket_num == 0 || (header->bucket_num & (header->bucket_num - 1)) != 0) return false;
+
+            auto *libraries = visitor.address(header->library_offset,
+                                              static_cast<u64>(header->library_num) * sizeof(Library));
+            auto *buckets = static_cast<const u32 *>(visitor.address(
+                    header->bucket_offset, (static_cast<u64>(header->bucket_num) + 1) * sizeof(u32)));
+            auto *postings = visitor.address(header->posting_offset,
+                                             static_cast<u64>(header->posting_num) * sizeof(Posting));
+            auto *strings = static_cast<const char *>(visitor.address(header->string_offset, header->string_size));
+            if (libraries == nullptr || buckets == nullptr || postings == nullptr || strings == nullptr) return false;
+            if (header->string_size == 0 || strings[header->string_size - 1] != '\0') return false;
+
+            for (u32 i = 0; i < header->bucket_num; ++i) {
+                if (buckets[i] > buckets[i + 1]) return false;
+            }
+            if (buckets[header->bucket_num] != header->posting_num) return false;
+
+            index.header = header;
+            index.libraries = static_cast<const Library *>(libraries);
+            index.buckets = buckets;
+            index.postings = static_cast<const Posting *>(postings);
+            index.strings = strings;
+            return true;
+        }
+
+        /// call `f` with a `Definition` for every library exporting `name`, return the number of calls.
+        template<typename F>
+        usize find(const char *name, F f) const {
+            u32 hash = gnu_hash(name);
+            u32 bucket = hash & (header->bucket_num - 1);
+
+            usize num = 0;
+            for (u32 i = buckets[bucket]; i < buckets[bucket + 1]; ++i) {
+                const Posting &posting = postings[i];
+                if (posting.hash != hash || posting.library >= header->library_num) continue;
+
+                const char *str = get_string(posting.name);
+                if (str == nullptr || strcmp(str, name) != 0) continue;
+
+                const char *version = posting.version == 0 ? nullptr : get_string(posting.version);
+                f(Definition{get_string(libraries[posting.library].path), version, posting.binding,
+                             posting.hidden != 0});
+                ++num;
+            }
+            return num;
+        }
+
+        usize get_library_num() const { return header->library_num; }
+
+        usize get_posting_num() const { return header->posting_num; }
+
+        const char *get_library_path(usize index) const { return get_string(libraries[index].path); }
+
+        /// index the shared objects at `paths` into a new index file at `output`, replacing it atomically. With
+        /// `previous`, which may map the file being replaced, unchanged libraries are copied. Files that are not
+        /// ELF shared objects are recorded without symbols, so that they are skipped next time too. 0 threads
+        /// means one per hardware thread. Return false if the file cannot be written.
+        static bool write(const std::vector<std::string> &paths, const char *output, const ExportIndex *previous,
+                          usize thread_num, Stats *stats = nullptr) {
+            std::unordered_map<std::string, u32> previous_libraries;
+            std::vector<std::vector<u32>> previous_postings;
+            if (previous != nullptr && previous->header != nullptr) {
+                previous_postings.resize(previous->header->library_num);
+                for (u32 i = 0; i < previous->header->library_num; ++i) {
+                    const char *path = previous->get_string(previous->libraries[i].path);
+                    if (path != nullptr) previous_libraries.emplace(path, i);
+                }
+                for (u32 i = 0; i < previous->header->posting_num; ++i) {
+                    u32 library = previous->postings[i].library;
+                    if (library < previous_postings.size()) previous_postings[library].push_back(i);
+                }
+            } else {
+                previous = nullptr;
+            }
+
+            std::vector<Scan> scans(paths.size());
+            parallel_for(paths.size(), thread_num, [&](usize index, usize) {
+                Scan &scan = scans[index];
+                scan = Scan{false, false, false, FileId{}, {}, {}};
+
+                u32 previous_library = NONE;
+                const std::vector<u32> *cached = nullptr;
+                auto iter = previous_libraries.find(paths[index]);
+                if (iter != previous_libraries.end()) {
+                    previous_library = iter->second;
+                    cached = &previous_postings[previous_library];
+                }
+                scan_library(paths[index], previous, cached, previous_library, scan);
+            });
+
+            std::string pool(1, '\0');
+            std::unordered_map<std::string, u32> pool_offsets;
+            auto intern = [&](const std::string &str) -> u32 {
+                if (str.empty()) return 0;
+                auto iter = pool_offsets.find(str);
+                if (iter != pool_offsets.end()) return iter->second;
+                auto offset = static_cast<u32>(pool.size());
+                pool.append(str).push_back('\0');
+                pool_offsets.emplace(str, offset);
+                return offset;
+            };
+
+            Stats counts{0, 0, 0, 0};
+            std::vector<Library> library_table;
+            std::vector<Posting> posting_list;
+            for (usize i = 0; i < paths.size(); ++i) {
+                Scan &scan = scans[i];
+                if (!scan.exists) continue;
+                if (scan.reused) {
+                    ++counts.reused;
+                } else if (scan.valid) {
+                    ++counts.scanned;
+                } else {
+                    ++counts.failed;
+                }
+
+                auto library = static_cast<u32>(library_table.size());
+                Library entry{intern(paths[i]), 0, static_cast<u32>(scan.build_id.size()), 0, scan.id};
+                if (!scan.build_id.empty()) {
+                    /// raw bytes may hold NULs, so they are not interned.
+                    entry.build_id = static_cast<u32>(pool.size());
+                    pool.append(scan.build_id).push_back('\0');
+                }
+                library_table.push_back(entry);
+
+                for (auto &item: scan.exports) {
+                    posting_list.push_back(Posting{gnu_hash(item.name.c_str()), intern(item.name), intern(item.version),
+                                                   library, item.binding, static_cast<u8>(item.hidden), 0});
+                }
+                std::vector<Export>{}.swap(scan.exports);
+
+                if (pool.size() > NONE || posting_list.size() >= NONE) {
+                    elf_warn("symbol index too large!");
+                    return false;
+                }
+            }
+            counts.posting_num = posting_list.size();
+
+            u32 bucket_num = 1;
+            while (bucket_num < posting_list.size() && bucket_num < (1u << 31)) bucket_num <<= 1;
+
+            /// counting sort of the postings by bucket.
+            std::vector<u32> bucket_table(bucket_num + 1, 0);
+            for (auto &posting: posting_list) ++bucket_table[(posting.hash & (bucket_num - 1)) + 1];
+            for (u32 i = 0; i < bucket_num; ++i) bucket_table[i + 1] += bucket_table[i];
+            std::vector<Posting> sorted(posting_list.size());
+            std::vector<u32> fill(bucket_table.begin(), bucket_table.end() - 1);
+            for (auto &posting: posting_list) sorted[fill[posting.hash & (bucket_num - 1)]++] = posting;
+
+            Header file_header{};
+            memcpy(file_header.magic, "ELFSYMIX", 8);
+            file_header.version = FORMAT_VERSION;
+            file_header.library_num = static_cast<u32>(library_table.size());
+            file_header.bucket_num = bucket_num;
+            file_header.posting_num = static_cast<u32>(sorted.size());
+
+            auto align = [](u64 offset) { return (offset + 7) & ~static_cast<u64>(7); };
+            file_header.library_offset = align(sizeof(Header));
+            file_header.bucket_offset = align(file_header.library_offset + library_table.size() * sizeof(Library));
+            file_header.posting_offset = align(file_header.bucket_offset + bucket_table.size() * sizeof(u32));
+            file_header.string_offset = align(file_header.posting_offset + sorted.size() * sizeof(Posting));
+            file_header.string_size = pool.size();
+
+            /// a unique name next to the output, so that concurrent writers of the same index do not share it.
+            std::string temp = std::string{output} + ".XXXXXX";
+            int fd = mkostemp(&temp[0], O_CLOEXEC);
+            if (fd != -1 && fchmod(fd, 0644) != 0) {
+                close(fd);
+                unlink(temp.c_str());
+                fd = -1;
+            }
+            if (fd == -1) {
+                elf_warn("cannot create the symbol index!");
+                return false;
+            }
+
+            const u8 zeros[8] = {};
+            u64 offset = 0;
+            auto put = [&](u64 at, const void *data, usize size) {
+                if (!write_all(fd, zeros, at - offset) || !write_all(fd, data, size)) return false;
+                offset = at + size;
+                return true;
+            };
+            bool ok = put(0, &file_header, sizeof(file_header)) &&
+                      put(file_header.library_offset, library_table.data(), library_table.size() * sizeof(Library)) &&
+                      put(file_header.bucket_offset, bucket_table.data(), bucket_table.size() * sizeof(u32)) &&
+                      put(file_header.posting_offset, sorted.data(), sorted.size() * sizeof(Posting)) &&
+                      put(file_header.string_offset, pool.data(), pool.size());
+            ok = close(fd) == 0 && ok;
+            if (!ok || rename(temp.c_str(), output) != 0) {
+                elf_warn("cannot write the symbol index!");
+                unlink(temp.c_str());
+                return false;
+            }
+
+            if (stats != nullptr) *stats = counts;
+            return true;
+        }
+    };
+}
+
+
+#endif //ELF_EXPORT_INDEX_HPP
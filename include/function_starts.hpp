@@ -0,0 +1,294 @@
+#ifndef ELF_FUNCTION_STARTS_HPP
+#define ELF_FUNCTION_STARTS_HPP
+
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "validated_elf.hpp"
+#include "byte_reader.hpp"
+#include "symbol_index.hpp"
+
+
+namespace elf {
+    /// function boundaries of binaries without symbols, taken from the call frame information the unwinder needs
+    /// anyway: every FDE of .eh_frame gives the [pc_begin, pc_begin + pc_range) of a function, and the entry point
+    /// starts one too. .eh_frame is found by its section, or through the .eh_frame_hdr of PT_GNU_EH_FRAME when the
+    /// section headers are gone. Starts that a defined function of .symtab or .dynsym already names are dropped,
+    /// the others become synthetic `sub_<hex address>` symbols for `SymbolIndex`.
+    class FunctionStarts {
+    public:
+        /// the size is 0 for an entry point without an FDE, which then extends to the next symbol.
+        using Function = SymbolIndex::Symbol;
+
+    private:
+        /// DW_EH_PE_* pointer encodings.
+        static constexpr u8 ENCODING_OMIT = 0xff;
+        static constexpr u8 ENCODING_PC_RELATIVE = 0x10;
+        static constexpr u8 ENCODING_DATA_RELATIVE = 0x30;
+
+        struct Frame {
+            const u8 *data;
+            u64 address;
+            u64 size;
+        };
+
+        SyntheticSymbols functions;
+
+        /// read a pointer of `encoding` at the cursor of `reader`, whose data starts at `base`. `apply` is false
+        /// for pc_range, which only shares the format of pc_begin. Indirect and text or function relative
+        /// pointers are not supported.
+        static bool read_pointer(ByteReader &reader, u8 encoding, u64 base, u64 data_base, usize address_size,
+                                 bool apply, u64 &val) {
+            u64 field = base + reader.get_position();
+
+            switch (encoding & 0x0fu) {
+                case 0x00:
+                    val = reader.read_unsigned(address_size);
+                    break;
+                case 0x01:
+                    val = reader.read_uleb128();
+                    break;
+                case 0x02:
+                    val = reader.read<u16>();
+                    break;
+                case 0x03:
+                    val = reader.read<u32>();
+                    break;
+                case 0x04:
+                    val = reader.read<u64>();
+                    break;
+                case 0x09:
+                    val = static_cast<u64>(reader.read_sleb128());
+                    break;
+                case 0x0a:
+                    val = static_cast<u64>(static_cast<i64>(reader.read<i16>()));
+                    break;
+                case 0x0b:
+                    val = static_cast<u64>(static_cast<i64>(reader.read<i32>()));
+                    break;
+                case 0x0c:
+                    val = reader.read<u64>();
+                    break;
+                default:
+                    return false;
+            }
+
+            if (!apply) return reader.is_valid();
+
+            switch (encoding & 0xf0u) {
+                case 0x00:
+                    break;
+                case ENCODING_PC_RELATIVE:
+                    val += field;
+                    break;
+                case ENCODING_DATA_RELATIVE:
+                    val += data_base;
+                    break;
+                default:
+                    return false;
+            }
+            if (address_size == 4) val &= 0xffffffffu;
+
+            return reader.is_valid();
+        }
+
+        /// FDE pointer encoding of the CIE at the cursor of `reader`, just past its id.
+        static bool read_cie_encoding(ByteReader &reader, u64 base, usize address_size, u8 &encoding) {
+            encoding = 0;
+
+            u8 version = reader.read<u8>();
+            const char *augmentation = reader.read_str();
+            if (augmentation == nullptr) return false;
+
+            if (strstr(augmentation, "eh") != nullptr) reader.skip(address_size);
+            reader.read_uleb128();
+            reader.read_sleb128();
+            if (version == 1) {
+                reader.read<u8>();
+            } else {
+                reader.read_uleb128();
+            }
+            if (augmentation[0] != 'z') return reader.is_valid();
+
+            reader.read_uleb128();
+            for (const char *c = augmentation + 1; *c != '\0'; ++c) {
+                if (*c == 'R') {
+                    encoding = reader.read<u8>();
+                } else if (*c == 'L') {
+                    reader.read<u8>();
+                } else if (*c == 'P') {
+                    u64 personality = 0;
+                    if (!read_pointer(reader, reader.read<u8>() & 0x7fu, base, 0, address_size, true, personality)) {
+                        return false;
+                    }
+                } else if (*c != 'S' && *c != 'B' && *c != 'G') {
+                    break;
+                }
+            }
+
+            return reader.is_valid();
+        }
+
+        /// call `f(pc_begin, pc_range)` for every FDE of `frame`, up to the zero terminator or the end of `frame`.
+        /// The CIE pointer of an FDE is the distance back from itself to the length of its CIE.
+        template<typename F>
+        static void walk(const Frame &frame, usize address_size, F f) {
+            ByteReader reader{frame.data, static_cast<usize>(frame.size)};
+            std::unordered_map<usize, u8> encodings;
+
+            while (reader.remain() >= 4) {
+                usize record = reader.get_position();
+                u64 length = reader.read<u32>();
+                if (length == 0) break;
+                if (length == 0xffffffffu) length = reader.read<u64>();
+                if (!reader.is_valid() || length > reader.remain() || length < 4) break;
+
+                usize start = reader.get_position();
+                usize next = start + length;
+                u32 id = reader.read<u32>();
+
+                if (id == 0) {
+                    u8 encoding = 0;
+                    if (read_cie_encoding(reader, frame.address, address_size, encoding)) encodings[record] = encoding;
+                } else if (id <= start) {
+                    auto iter = encodings.find(start - id);
+                    u64 pc_begin = 0, pc_range = 0;
+                    if (iter != encodings.end() && iter->second != ENCODING_OMIT &&
+                        read_pointer(reader, iter->second, frame.address, 0, address_size, true, pc_begin) &&
+                        read_pointer(reader, iter->second, frame.address, 0, address_size, false, pc_range)) {
+                        f(pc_begin, pc_range);
+                    }
+                }
+
+                reader.seek(next);
+            }
+        }
+
+        template<typename USizeT>
+        static bool find_frame(const ValidatedELF<USizeT> &elf, Frame &frame) {
+            using SectionHeaderT = SectionHeader<USizeT>;
+            using ProgramHeaderT = ProgramHeader<USizeT>;
+
+            for (auto &section: elf.sections()) {
+                if (section.section_type == SectionHeaderT::NO_BITS) continue;
+                if (strcmp(elf.get_section_name(section), ".eh_frame") != 0) continue;
+                frame = Frame{elf.get_content(section), section.address, section.size};
+                return true;
+            }
+
+            /// version, eh_frame_ptr encoding, fde_count encoding, table encoding, then eh_frame_ptr.
+            for (auto &program: elf.programs()) {
+                if (program.type != ProgramHeaderT::GNU_EH_FRAME || program.file_size < 4) continue;
+
+                ByteReader reader{elf.get_content(program), static_cast<usize>(program.file_size)};
+                u8 version = reader.read<u8>();
+                u8 encoding = reader.read<u8>();
+                reader.skip(2);
+                u64 address = 0;
+                if (version != 1 || !read_pointer(reader, encoding, program.virtual_address,
+                                                  program.virtual_address, sizeof(USizeT), true, address)) {
+                    return false;
+                }
+
+                for (auto &load: elf.programs()) {
+                    if (load.type != ProgramHeaderT::LOADABLE || address < load.virtual_address ||
+                        address - load.virtual_address >= load.file_size) {
+                        continue;
+                    }
+                    u64 offset = address - load.virtual_address;
+                    frame = Frame{elf.get_content(load) + offset, address, load.file_size - offset};
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        template<typename USizeT>
+        static bool is_executable(const ValidatedELF<USizeT> &elf, u64 address) {
+            using ProgramHeaderT = ProgramHeader<USizeT>;
+
+            for (auto &program: elf.programs()) {
+                if (program.type == ProgramHeaderT::LOADABLE && (program.flags & ProgramHeaderT::EXECUTE) != 0 &&
+                    address >= program.virtual_address && address - program.virtual_address < program.mem_size) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    public:
+        /// find the functions of `elf` that no symbol names, replacing any previous content. The `sub_<hex address>`
+        /// names are owned, see `SyntheticSymbols`.
+        template<typename USizeT>
+        void build(const ValidatedELF<USizeT> &elf) {
+            using ELFHeaderT = ELFHeader<USizeT>;
+            using SectionHeaderT = SectionHeader<USizeT>;
+            using SymbolTableHeaderT = _SymbolTableHeader<USizeT>;
+
+            functions.clear();
+
+            auto type = elf.get_header().file_type;
+            if (type != ELFHeaderT::EXECUTABLE && type != ELFHeaderT::SHARED) return;
+
+            std::vector<Function> found;
+            Frame frame{};
+            if (find_frame(elf, frame)) {
+                walk(frame, sizeof(USizeT), [&](u64 pc_begin, u64 pc_range) {
+                    if (pc_range != 0 && is_executable(elf, pc_begin)) {
+                        found.push_back(Function{pc_begin, pc_range, nullptr});
+                    }
+                });
+            }
+
+            u64 entry = elf.get_header().entry_point;
+            if (entry != 0 && is_executable(elf, entry)) found.push_back(Function{entry, 0, nullptr});
+
+            std::sort(found.begin(), found.end(), [](const Function &lhs, const Function &rhs) {
+                if (lhs.address != rhs.address) return lhs.address < rhs.address;
+                return lhs.size > rhs.size;
+            });
+            found.erase(std::unique(found.begin(), found.end(), [](const Function &lhs, const Function &rhs) {
+                return lhs.address == rhs.address;
+            }), found.end());
+
+            std::vector<u64> named;
+            for (auto &section: elf.sections()) {
+                if (section.section_type != SectionHeaderT::SYMBOL_TABLE &&
+                    section.section_type != SectionHeaderT::DYNAMIC_SYMBOL_TABLE)
+                    continue;
+                for (auto &symbol: elf.get_symbol_table(section)) {
+                    if (symbol.get_type() != SymbolTableHeaderT::FUNCTION || symbol.name == 0 ||
+                        symbol.section_header_index == SectionHeaderT::INDEX_UNDEFINED)
+                        continue;
+                    named.push_back(symbol.value);
+                }
+            }
+            std::sort(named.begin(), named.end());
+
+            found.erase(std::remove_if(found.begin(), found.end(), [&](const Function &function) {
+                return std::binary_search(named.begin(), named.end(), function.address);
+            }), found.end());
+
+            for (auto &function: found) {
+                char name[sizeof("sub_") + 16];
+                snprintf(name, sizeof(name), "sub_%" PRIx64, function.address);
+                functions.add(function.address, function.size, name);
+            }
+        }
+
+        /// add the functions to `index`, which borrows the names from this object.
+        void add_to(SymbolIndex &index) const { functions.add_to(index); }
+
+        const std::vector<Function> &get_functions() const { return functions.get_symbols(); }
+    };
+}
+
+
+#endif //ELF_FUNCTION_STARTS_HPP
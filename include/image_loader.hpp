@@ -0,0 +1,273 @@
+#ifndef ELF_IMAGE_LOADER_HPP
+#define ELF_IMAGE_LOADER_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+
+
+namespace elf {
+    /// memory image of an executable or a shared object for an emulator or a sandbox. Every PT_LOAD segment is
+    /// mapped straight from the file, `MAP_PRIVATE | MAP_FIXED` inside one reservation, with the permissions of the
+    /// segment. Pages are copied on write only, so loading does not depend on the size of the file and instances
+    /// loading the same file share the page cache. Only the .bss tail of the last file page is zeroed by hand, the
+    /// rest of the .bss is anonymous memory.
+    template<typename USizeT>
+    class GuestImage {
+    public:
+        using ELFHeaderT = ELFHeader<USizeT>;
+        using ProgramHeaderT = ProgramHeader<USizeT>;
+
+        /// PT_TLS, the initialization image of the thread local storage of the module.
+        struct TlsTemplate {
+            USizeT address;
+            USizeT file_size;
+            USizeT mem_size;
+            USizeT alignment;
+            /// host address of the initialization image, nullptr if the image has no PT_TLS.
+            const u8 *data;
+        };
+
+    private:
+        u8 *base;
+        usize size;
+        /// guest address mapped at `base`.
+        USizeT guest_base;
+        USizeT bias;
+        USizeT entry;
+        USizeT program_address;
+        usize program_num;
+        TlsTemplate tls;
+        const char *interpreter;
+
+        void clear() {
+            base = nullptr;
+            size = 0;
+            guest_base = 0;
+            bias = 0;
+            entry = 0;
+            program_address = 0;
+            program_num = 0;
+            tls = TlsTemplate{};
+            interpreter = nullptr;
+        }
+
+        void release() {
+            if (base != nullptr) munmap(base, size);
+        }
+
+        static int get_protection(const ProgramHeaderT &program) {
+            return (program.is_read() ? PROT_READ : 0) | (program.is_write() ? PROT_WRITE : 0) |
+                   (program.is_execute() ? PROT_EXEC : 0);
+        }
+
+        bool map_segment(const ProgramHeaderT &program, int fd, usize page_size) {
+            USizeT page_mask = ~static_cast<USizeT>(page_size - 1);
+            int protection = get_protection(program);
+
+            USizeT start = program.virtual_address & page_mask;
+            USizeT file_end = program.virtual_address + program.file_size;
+            USizeT file_page_end = (file_end + page_size - 1) & page_mask;
+            USizeT mem_page_end = (program.virtual_address + program.mem_size + page_size - 1) & page_mask;
+            u8 *host = base + (start - (guest_base - bias));
+
+            if (program.file_size > 0) {
+                /// the .bss starting in the last file page needs write access to be zeroed.
+                bool zero_tail = program.mem_size > program.file_size && file_end != file_page_end;
+                void *ret = mmap(host, file_page_end - start, protection | (zero_tail ? PROT_WRITE : 0),
+                                 MAP_PRIVATE | MAP_FIXED, fd, program.offset & page_mask);
+                if (ret == MAP_FAILED) return false;
+
+                if (zero_tail) {
+                    memset(host + (file_end - start), 0, file_page_end - file_end);
+                    if ((protection & PROT_WRITE) == 0 && mprotect(host, file_page_end - start, protection) != 0) {
+                        return false;
+                    }
+                }
+            } else {
+                file_page_end = start;
+            }
+
+            if (mem_page_end > file_page_end) {
+                void *ret = mmap(host + (file_page_end - start), mem_page_end - file_page_end, protection,
+                                 MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0);
+                if (ret == MAP_FAILED) return false;
+            }
+
+            return true;
+        }
+
+    public:
+        GuestImage() : base{nullptr}, size{0}, guest_base{0}, bias{0}, entry{0}, program_address{0}, program_num{0},
+                       tls{}, interpreter{nullptr} {}
+
+        GuestImage(GuestImage &&other) noexcept:
+                base{other.base}, size{other.size}, guest_base{other.guest_base}, bias{other.bias},
+                entry{other.entry}, program_address{other.program_address}, program_num{other.program_num},
+                tls{other.tls}, interpreter{other.interpreter} { other.clear(); }
+
+        GuestImage &operator=(GuestImage &&other) noexcept {
+            if (this != &other) {
+                release();
+                base = other.base;
+                size = other.size;
+                guest_base = other.guest_base;
+                bias = other.bias;
+                entry = other.entry;
+                program_address = other.program_address;
+                program_num = other.program_num;
+                tls = other.tls;
+                interpreter = other.interpreter;
+                other.clear();
+            }
+            return *this;
+        }
+
+        GuestImage(const GuestImage &other) = delete;
+
+        GuestImage &operator=(const GuestImage &other) = delete;
+
+        ~GuestImage() { release(); }
+
+        /// map the image of `visitor`, an executable or a shared object in host byte order whose segments are
+        /// aligned to the host page size. `bias` is added to the addresses of shared objects and must be page
+        /// aligned, it is ignored for executables. Return false on failure. `visitor` must outlive the image, since
+        /// the interpreter path points into it.
+        static bool load(MappedFileVisitor &visitor, USizeT bias, GuestImage &image) {
+            image = GuestImage{};
+
+            ELFHeaderT *header = ELFHeaderT::read(visitor);
+            if (header == nullptr || get_elf_class(visitor) != (sizeof(USizeT) == 8 ? 2 : 1)) return false;
+            if (header->file_type != ELFHeaderT::EXECUTABLE && header->file_type != ELFHeaderT::SHARED) return false;
+            if (visitor.get_fd() == -1) {
+                elf_warn("the image can only be mapped from a file!");
+                return false;
+            }
+
+            usize page_size = sysconf(_SC_PAGESIZE);
+            USizeT page_mask = ~static_cast<USizeT>(page_size - 1);
+            if (header->file_type == ELFHeaderT::EXECUTABLE) bias = 0;
+            if ((bias & ~page_mask) != 0) return false;
+
+            USizeT low = ~static_cast<USizeT>(0), high = 0;
+            for (auto &program: header->programs(visitor)) {
+                if (program.type != ProgramHeaderT::LOADABLE || program.mem_size == 0) continue;
+                if (program.file_size > program.mem_size) return false;
+                if ((program.offset & ~page_mask) != (program.virtual_address & ~page_mask)) {
+                    elf_warn("segment is not aligned to the host page size!");
+                    return false;
+                }
+                if (!visitor.check_address(program.offset, program.file_size)) return false;
+
+                USizeT end = program.virtual_address + program.mem_size;
+                if (end < program.virtual_address) return false;
+                low = std::min<USizeT>(low, program.virtual_address & page_mask);
+                high = std::max<USizeT>(high, (end + page_size - 1) & page_mask);
+            }
+            if (low >= high) return false;
+
+            /// reserve the whole span first, so that segments never land on unrelated host mappings.
+            void *reservation = mmap(nullptr, high - low, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                                     -1, 0);
+            if (reservation == MAP_FAILED) return false;
+
+            image.base = static_cast<u8 *>(reservation);
+            image.size = high - low;
+            image.guest_base = low + bias;
+            image.bias = bias;
+            image.entry = header->entry_point + bias;
+            image.program_num = header->program_header_num;
+
+            for (auto &program: header->programs(visitor)) {
+                switch (program.type) {
+                    case ProgramHeaderT::LOADABLE:
+                        if (program.mem_size == 0) break;
+                        if (!image.map_segment(program, visitor.get_fd(), page_size)) {
+                            image = GuestImage{};
+                            return false;
+                        }
+                        /// the program header table is loaded with the first segment, as the auxiliary vector
+                        /// AT_PHDR expects, unless PT_PHDR says where.
+                        if (image.program_address == 0 && program.offset <= header->program_header_offset &&
+                            header->program_header_offset - program.offset < program.file_size) {
+                            image.program_address =
+                                    program.virtual_address + (header->program_header_offset - program.offset) + bias;
+                        }
+                        break;
+                    case ProgramHeaderT::PROGRAM_HEADER_TABLE:
+                        image.program_address = program.virtual_address + bias;
+                        break;
+                    case ProgramHeaderT::THREAD_LOCAL_STORAGE:
+                        image.tls = TlsTemplate{static_cast<USizeT>(program.virtual_address + bias), program.file_size,
+                                                program.mem_size, program.alignment, nullptr};
+                        break;
+                    case ProgramHeaderT::INTERPRETER_PATH_NAME: {
+                        auto *path = ProgramHeaderT::template cast<InterPathHeader<USizeT>>(&program, visitor);
+                        if (path != nullptr) image.interpreter = path->get_path_name(visitor);
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+
+            if (image.tls.mem_size > 0) {
+                image.tls.data = image.to_host(image.tls.address, image.tls.file_size);
+                if (image.tls.data == nullptr && image.tls.file_size > 0) {
+                    image = GuestImage{};
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        /// host address of `len` bytes at guest `address`, nullptr if they are out of the image.
+        u8 *to_host(USizeT address, usize len) const {
+            if (address < guest_base || address - guest_base > size || len > size - (address - guest_base)) {
+                return nullptr;
+            }
+            return base + (address - guest_base);
+        }
+
+        /// host address and size of the reservation, which starts at guest address `get_guest_base()`. Gaps between
+        /// segments are mapped without any access.
+        u8 *get_base() const { return base; }
+
+        usize get_size() const { return size; }
+
+        USizeT get_guest_base() const { return guest_base; }
+
+        USizeT get_bias() const { return bias; }
+
+        /// guest address of the entry point.
+        USizeT get_entry() const { return entry; }
+
+        /// guest address and number of entries of the program header table, for AT_PHDR and AT_PHNUM. The address
+        /// is 0 if the table is not loaded.
+        USizeT get_program_address() const { return program_address; }
+
+        usize get_program_num() const { return program_num; }
+
+        /// `mem_size` is 0 if the image has no PT_TLS.
+        const TlsTemplate &get_tls() const { return tls; }
+
+        /// path of the program interpreter, nullptr if the image has none.
+        const char *get_interpreter() const { return interpreter; }
+    };
+}
+
+namespace elf32 {
+    using GuestImage = elf::GuestImage<elf::u32>;
+}
+
+namespace elf64 {
+    using GuestImage = elf::GuestImage<elf::u64>;
+}
+
+
+#endif //ELF_IMAGE_LOADER_HPP
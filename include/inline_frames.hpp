@@ -0,0 +1,507 @@
+#ifndef ELF_INLINE_FRAMES_HPP
+#define ELF_INLINE_FRAMES_HPP
+
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "byte_reader.hpp"
+#include "dwarf.hpp"
+#include "unit_index.hpp"
+
+
+namespace elf {
+    /// the chain of inlined functions at an address, from the DW_TAG_inlined_subroutine DIEs of .debug_info. A
+    /// unit is decoded on the first query that falls in it, with `UnitIndex` telling which one: its DIE tree is
+    /// walked once, and the ranges of its subprograms and inlined subroutines are flattened into disjoint
+    /// intervals, each pointing to the innermost one. Abbreviation tables are parsed once per offset, function
+    /// names are resolved on demand through abstract_origin and specification, and the file names of call_file
+    /// come from the header of the line table of the unit. Not thread safe, queries fill the caches.
+    class InlineFrames {
+    public:
+        struct Frame {
+            /// the linkage name, or the name when there is none, nullptr if neither is found.
+            const char *name;
+            /// where this function is inlined into the next frame, nullptr and 0 for the last frame.
+            const char *call_file;
+            u32 call_line;
+            u32 call_column;
+        };
+
+        class Frames {
+        private:
+            const Frame *first;
+            const Frame *last;
+
+        public:
+            Frames(const Frame *first, const Frame *last) : first{first}, last{last} {}
+
+            const Frame *begin() const { return first; }
+
+            const Frame *end() const { return last; }
+
+            usize size() const { return last - first; }
+
+            bool empty() const { return first == last; }
+        };
+
+        /// frames of many addresses, in the order of the addresses.
+        class Batch {
+        private:
+            friend class InlineFrames;
+
+            std::vector<Frame> frames;
+            std::vector<usize> offsets;
+
+        public:
+            usize size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+            Frames operator[](usize i) const {
+                return Frames{frames.data() + offsets[i], frames.data() + offsets[i + 1]};
+            }
+        };
+
+    private:
+        static constexpr u32 NONE = 0xffffffffu;
+        /// bound on abstract_origin and specification chains, which are never long in well formed DWARF.
+        static constexpr usize MAX_INDIRECTION = 8;
+        /// DW_LNCT_* content types of DWARF 5 line table headers.
+        static constexpr u64 CONTENT_PATH = 1;
+        static constexpr u64 CONTENT_DIRECTORY_INDEX = 2;
+
+        struct Record {
+            /// the DIE naming the function, in .debug_info.
+            u64 origin;
+            const char *name;
+            bool named;
+            u32 parent;
+            u32 call_file;
+            u32 call_line;
+            u32 call_column;
+        };
+
+        struct Interval {
+            u64 begin;
+            u64 end;
+            u32 record;
+        };
+
+        struct UnitCache {
+            DWARF::Unit unit;
+            const DWARF::AbbrevTable *table;
+            const char *comp_dir;
+            u64 line_offset;
+            bool has_line;
+            bool decoded;
+            std::vector<Record> records;
+            std::vector<Interval> intervals;
+            std::vector<std::string> files;
+        };
+
+        const DWARF *dwarf;
+        const UnitIndex *index;
+        std::unordered_map<u64, std::unique_ptr<DWARF::AbbrevTable>> tables;
+        std::vector<std::unique_ptr<UnitCache>> units;
+
+        const DWARF::AbbrevTable *get_table(u64 offset) {
+            auto &table = tables[offset];
+            if (table == nullptr) {
+                table.reset(new DWARF::AbbrevTable{});
+                if (!table->parse(dwarf->abbrev, offset)) elf_warn("malformed abbreviation table!");
+            }
+            return table.get();
+        }
+
+        /// the unit with its bases and abbreviations, without its DIE tree.
+        UnitCache *get_unit(u32 unit_index) {
+            auto &cache = units[unit_index];
+            if (cache != nullptr) return cache.get();
+
+            cache.reset(new UnitCache{});
+            cache->unit = index->get_units()[unit_index];
+            cache->table = get_table(cache->unit.abbrev_offset);
+
+            DWARF::PCAttributes pc{};
+            DWARF::Value comp_dir{};
+            bool has_comp_dir = false;
+            dwarf->read_root(cache->unit, *cache->table, pc, [&](u16 attribute, const DWARF::Value &value) {
+                if (attribute == DWARF::COMP_DIR) {
+                    comp_dir = value;
+                    has_comp_dir = true;
+                } else if (attribute == DWARF::STMT_LIST) {
+                    cache->line_offset = value.val;
+                    cache->has_line = true;
+                }
+            });
+            if (has_comp_dir) cache->comp_dir = dwarf->get_string(cache->unit, comp_dir);
+
+            return cache.get();
+        }
+
+        u32 find_unit(u64 offset) const {
+            auto &all = index->get_units();
+            auto iter = std::upper_bound(all.begin(), all.end(), offset, [](u64 val, const DWARF::Unit &unit) {
+                return val < unit.offset;
+            });
+            if (iter == all.begin() || offset >= (--iter)->end) return NONE;
+            return static_cast<u32>(iter - all.begin());
+        }
+
+        /// absolute offset of the DIE a reference points to, false for references to other files or type units.
+        static bool get_reference(const DWARF::Unit &unit, const DWARF::Value &value, u64 &offset) {
+            switch (value.form) {
+                case DWARF::REF1:
+                case DWARF::REF2:
+                case DWARF::REF4:
+                case DWARF::REF8:
+                case DWARF::REF_UDATA:
+                    offset = unit.offset + value.val;
+                    return true;
+                case DWARF::REF_ADDR:
+                    offset = value.val;
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        /// name of the function of the DIE at `offset`, following abstract_origin and specification.
+        const char *resolve_name(u64 offset) {
+            for (usize depth = 0; depth < MAX_INDIRECTION; ++depth) {
+                u32 unit_index = find_unit(offset);
+                if (unit_index == NONE) return nullptr;
+                UnitCache *cache = get_unit(unit_index);
+
+                ByteReader reader{dwarf->info.data, static_cast<usize>(cache->unit.end)};
+                reader.seek(static_cast<usize>(offset));
+                const DWARF::Abbrev *abbrev = cache->table->find(reader.read_uleb128());
+                if (abbrev == nullptr || !reader.is_valid()) return nullptr;
+
+                DWARF::Value name{}, linkage_name{}, next{};
+                bool has_name = false, has_linkage_name = false, has_next = false;
+                if (!dwarf->read_attributes(reader, cache->unit, *cache->table, *abbrev, [&](u16 attribute,
+                                                                                           const DWARF::Value &value) {
+                    if (attribute == DWARF::LINKAGE_NAME || attribute == DWARF::MIPS_LINKAGE_NAME) {
+                        linkage_name = value;
+                        has_linkage_name = true;
+                    } else if (attribute == DWARF::NAME) {
+                        name = value;
+                        has_name = true;
+                    } else if (attribute == DWARF::ABSTRACT_ORIGIN || attribute == DWARF::SPECIFICATION) {
+                        next = value;
+                        has_next = true;
+                    }
+                })) {
+                    return nullptr;
+                }
+
+                if (has_linkage_name) return dwarf->get_string(cache->unit, linkage_name);
+                if (has_name) return dwarf->get_string(cache->unit, name);
+                if (!has_next || !get_reference(cache->unit, next, offset)) return nullptr;
+            }
+
+            return nullptr;
+        }
+
+        /// the file names of the line table header of `cache`, in the numbering of call_file: from 1 before
+        /// DWARF 5, from 0 since.
+        void read_files(UnitCache &cache) {
+            if (!cache.has_line || cache.line_offset >= dwarf->line.size) return;
+            ByteReader reader{dwarf->line.data, dwarf->line.size};
+            reader.seek(static_cast<usize>(cache.line_offset));
+
+            DWARF::Unit unit = cache.unit;
+            unit.offset_size = 4;
+            u64 length = reader.read<u32>();
+            if (length == 0xffffffffu) {
+                unit.offset_size = 8;
+                length = reader.read<u64>();
+            }
+            if (!reader.is_valid() || length > reader.remain()) return;
+            usize start = reader.get_position();
+            reader = ByteReader{dwarf->line.data, start + static_cast<usize>(length)};
+            reader.seek(start);
+
+            unit.version = reader.read<u16>();
+            if (unit.version < 2 || unit.version > 5) return;
+            if (unit.version == 5) {
+                unit.address_size = reader.read<u8>();
+                reader.skip(1);
+            }
+            reader.read_unsigned(unit.offset_size);
+            reader.skip(unit.version >= 4 ? 5 : 4);
+            u8 opcode_base = reader.read<u8>();
+            reader.skip(opcode_base > 0 ? opcode_base - 1u : 0);
+            if (!reader.is_valid()) return;
+
+            std::vector<std::string> directories;
+            if (unit.version < 5) {
+                directories.emplace_back(cache.comp_dir == nullptr ? "" : cache.comp_dir);
+                for (const char *dir = reader.read_str(); dir != nullptr && dir[0] != '\0'; dir = reader.read_str()) {
+                    directories.emplace_back(dir);
+                }
+
+                cache.files.emplace_back();
+                for (const char *name = reader.read_str(); name != nullptr && name[0] != '\0';
+                     name = reader.read_str()) {
+                    u64 dir = reader.read_uleb128();
+                    reader.read_uleb128();
+                    reader.read_uleb128();
+                    cache.files.push_back(join(dir < directories.size() ? directories[dir] : "", name,
+                                               cache.comp_dir));
+                }
+                return;
+            }
+
+            /// DWARF 5: a format of (content type, form) pairs, then the entries, for directories and for files.
+            for (usize table = 0; table < 2; ++table) {
+                std::vector<std::pair<u64, u64>> format(reader.read<u8>());
+                for (auto &pair: format) {
+                    pair.first = reader.read_uleb128();
+                    pair.second = reader.read_uleb128();
+                }
+
+                u64 entry_num = reader.read_uleb128();
+                for (u64 entry = 0; entry < entry_num && reader.is_valid(); ++entry) {
+                    const char *path = nullptr;
+                    u64 dir = 0;
+                    for (auto &pair: format) {
+                        DWARF::Value value{};
+                        if (!dwarf->read_value(reader, unit, static_cast<u16>(pair.second), 0, value)) return;
+                        if (pair.first == CONTENT_PATH) path = dwarf->get_string(unit, value);
+                        if (pair.first == CONTENT_DIRECTORY_INDEX) dir = value.val;
+                    }
+
+                    if (table == 0) {
+                        directories.emplace_back(path == nullptr ? "" : path);
+                    } else {
+                        cache.files.push_back(join(dir < directories.size() ? directories[dir] : "",
+                                                   path == nullptr ? "" : path, cache.comp_dir));
+                    }
+                }
+            }
+        }
+
+        static std::string join(const std::string &dir, const char *name, const char *comp_dir) {
+            if (name[0] == '/') return std::string{name};
+
+            std::string path;
+            if (!dir.empty() && dir[0] != '/' && comp_dir != nullptr) path.append(comp_dir).append("/");
+            if (!dir.empty()) path.append(dir).append("/");
+            return path.append(name);
+        }
+
+        /// walk the DIE tree of the unit, then flatten the nested ranges into disjoint intervals.
+        void decode(UnitCache &cache) {
+            cache.decoded = true;
+            read_files(cache);
+
+            struct Range {
+                u64 begin;
+                u64 end;
+                u32 record;
+                u32 depth;
+            };
+            std::vector<Range> ranges;
+            /// the innermost function enclosing each open DIE, and its depth.
+            std::vector<u32> enclosing;
+            std::vector<u32> depths;
+
+            const DWARF::Unit &unit = cache.unit;
+            ByteReader reader{dwarf->info.data, static_cast<usize>(unit.end)};
+            reader.seek(static_cast<usize>(unit.die_offset));
+
+            while (reader.remain() > 0) {
+                u64 offset = reader.get_position();
+                u64 code = reader.read_uleb128();
+                if (!reader.is_valid()) break;
+                if (code == 0) {
+                    if (enclosing.empty()) break;
+                    enclosing.pop_back();
+                    depths.pop_back();
+                    continue;
+                }
+
+                const DWARF::Abbrev *abbrev = cache.table->find(code);
+                if (abbrev == nullptr) break;
+
+                DWARF::PCAttributes pc{};
+                Record record{offset, nullptr, false, enclosing.empty() ? NONE : enclosing.back(), 0, 0, 0};
+                DWARF::Value origin{};
+                bool has_origin = false;
+                if (!dwarf->read_attributes(reader, unit, *cache.table, *abbrev, [&](u16 attribute,
+                                                                                   const DWARF::Value &value) {
+                    if (pc.collect(attribute, value)) return;
+                    switch (attribute) {
+                        case DWARF::ABSTRACT_ORIGIN:
+                            origin = value;
+                            has_origin = true;
+                            break;
+                        case DWARF::CALL_FILE:
+                            record.call_file = static_cast<u32>(value.val);
+                            break;
+                        case DWARF::CALL_LINE:
+                            record.call_line = static_cast<u32>(value.val);
+                            break;
+                        case DWARF::CALL_COLUMN:
+                            record.call_column = static_cast<u32>(value.val);
+                            break;
+                        default:
+                            break;
+                    }
+                })) {
+                    break;
+                }
+
+                u32 inner = enclosing.empty() ? NONE : enclosing.back();
+                u32 depth = depths.empty() ? 0 : depths.back();
+                if ((abbrev->tag == DWARF::SUBPROGRAM || abbrev->tag == DWARF::INLINED_SUBROUTINE) &&
+                    (pc.has_ranges || pc.has_low_pc)) {
+                    if (abbrev->tag == DWARF::INLINED_SUBROUTINE && has_origin) {
+                        get_reference(unit, origin, record.origin);
+                    } else if (abbrev->tag == DWARF::SUBPROGRAM) {
+                        /// a nested function is not inlined into its parent.
+                        record.parent = NONE;
+                    }
+
+                    usize first = ranges.size();
+                    u32 record_index = static_cast<u32>(cache.records.size());
+                    dwarf->for_each_range(unit, pc, [&](u64 begin, u64 end) {
+                        ranges.push_back(Range{begin, end, record_index, depth + 1});
+                    });
+                    if (ranges.size() > first) {
+                        cache.records.push_back(record);
+                        inner = record_index;
+                        ++depth;
+                    }
+                }
+
+                if (abbrev->has_children) {
+                    enclosing.push_back(inner);
+                    depths.push_back(depth);
+                }
+            }
+
+            /// outer ranges first at the same address, then a stack of the open ranges.
+            std::sort(ranges.begin(), ranges.end(), [](const Range &lhs, const Range &rhs) {
+                if (lhs.begin != rhs.begin) return lhs.begin < rhs.begin;
+                return lhs.depth < rhs.depth;
+            });
+
+            std::vector<Range> open;
+            u64 cursor = 0;
+            auto emit = [&](u64 end, u32 record) {
+                if (cursor >= end) return;
+                auto &intervals = cache.intervals;
+                if (!intervals.empty() && intervals.back().end == cursor && intervals.back().record == record) {
+                    intervals.back().end = end;
+                } else {
+                    intervals.push_back(Interval{cursor, end, record});
+                }
+                cursor = end;
+            };
+
+            for (auto range: ranges) {
+                while (!open.empty() && open.back().end <= range.begin) {
+                    emit(open.back().end, open.back().record);
+                    open.pop_back();
+                }
+                if (!open.empty()) {
+                    emit(range.begin, open.back().record);
+                    range.end = std::min(range.end, open.back().end);
+                }
+                cursor = std::max(cursor, range.begin);
+                if (range.begin < range.end) open.push_back(range);
+            }
+            while (!open.empty()) {
+                emit(open.back().end, open.back().record);
+                open.pop_back();
+            }
+            cache.intervals.shrink_to_fit();
+        }
+
+        void append(u64 address, std::vector<Frame> &frames) {
+            const DWARF::Unit *unit = index->find(address);
+            if (unit == nullptr) return;
+
+            u32 unit_index = static_cast<u32>(unit - index->get_units().data());
+            UnitCache *cache = get_unit(unit_index);
+            if (!cache->decoded) decode(*cache);
+
+            auto &intervals = cache->intervals;
+            auto iter = std::upper_bound(intervals.begin(), intervals.end(), address, [](u64 val,
+                                                                                        const Interval &interval) {
+                return val < interval.begin;
+            });
+            if (iter == intervals.begin() || address >= (--iter)->end) return;
+
+            for (u32 i = iter->record; i != NONE; i = cache->records[i].parent) {
+                Record &record = cache->records[i];
+                if (!record.named) {
+                    record.name = resolve_name(record.origin);
+                    record.named = true;
+                }
+
+                Frame frame{record.name, nullptr, 0, 0};
+                if (record.parent != NONE) {
+                    if (record.call_file < cache->files.size()) {
+                        frame.call_file = cache->files[record.call_file].c_str();
+                    }
+                    frame.call_line = record.call_line;
+                    frame.call_column = record.call_column;
+                }
+                frames.push_back(frame);
+            }
+        }
+
+    public:
+        /// `dwarf` and `index` are borrowed and must outlive this object.
+        InlineFrames(const DWARF &dwarf, const UnitIndex &index) :
+                dwarf{&dwarf}, index{&index}, units(index.get_units().size()) {}
+
+        /// frames at `address`, from the innermost inlined function to the function containing it, empty if no
+        /// function covers it. The names stay valid while the file is mapped, the call files while this lives.
+        void find(u64 address, std::vector<Frame> &frames) {
+            frames.clear();
+            append(address, frames);
+        }
+
+        /// frames of every address of `addresses`. They are decoded in address order, so that each unit is
+        /// walked while its DIEs are still in cache.
+        void find(const u64 *addresses, usize address_num, Batch &batch) {
+            std::vector<u32> order(address_num);
+            for (u32 i = 0; i < address_num; ++i) order[i] = i;
+            std::sort(order.begin(), order.end(), [&](u32 lhs, u32 rhs) { return addresses[lhs] < addresses[rhs]; });
+
+            std::vector<usize> firsts(address_num), lasts(address_num);
+            std::vector<Frame> frames;
+            for (u32 i: order) {
+                firsts[i] = frames.size();
+                append(addresses[i], frames);
+                lasts[i] = frames.size();
+            }
+
+            batch.frames.clear();
+            batch.frames.reserve(frames.size());
+            batch.offsets.assign(1, 0);
+            for (usize i = 0; i < address_num; ++i) {
+                batch.frames.insert(batch.frames.end(), frames.begin() + firsts[i], frames.begin() + lasts[i]);
+                batch.offsets.push_back(batch.frames.size());
+            }
+        }
+
+        /// number of units whose DIE tree has been walked.
+        usize decoded_num() const {
+            usize num = 0;
+            for (auto &unit: units) num += unit != nullptr && unit->decoded;
+            return num;
+        }
+    };
+}
+
+
+#endif //ELF_INLINE_FRAMES_HPP
@@ -0,0 +1,341 @@
+#ifndef ELF_LOADED_IMAGE_HPP
+#define ELF_LOADED_IMAGE_HPP
+
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <link.h>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+#include "validated_elf.hpp"
+
+
+namespace elf {
+    /// string table in memory with a known size, checked like `StringTableHeader::StringTable`.
+    class MemoryStringTable {
+    private:
+        const char *inner;
+        usize size;
+
+    public:
+        MemoryStringTable(const char *inner, usize size) : inner{inner}, size{size} {}
+
+        const char *get_str(usize index, const char *no_name = "") const {
+            if (index >= size) return nullptr;
+            if (index == 0) return no_name;
+            if (strnlen(inner + index, size - index) == size - index) return nullptr;
+            return inner + index;
+        }
+    };
+
+    /// an ELF image already loaded in this process, as reported by `dl_iterate_phdr`. Nothing is read from disk:
+    /// the program headers, PT_DYNAMIC, the dynamic symbol and string tables and the hash tables are used where
+    /// the dynamic loader put them, so every lookup works from loaded addresses instead of file offsets.
+    template<typename USizeT>
+    class LoadedImage {
+    public:
+        using ELFHeaderT = ELFHeader<USizeT>;
+        using ProgramHeaderT = ProgramHeader<USizeT>;
+        using SymbolTableEntryT = typename _SymbolTableHeader<USizeT>::SymbolTableEntry;
+        using DynLinkingTableHeaderT = DynLinkingTableHeader<USizeT>;
+        using DynEntryT = typename DynLinkingTableHeaderT::Entry;
+
+    private:
+        const char *name;
+        USizeT bias;
+        const ProgramHeaderT *program_headers;
+        usize program_num;
+        const DynEntryT *dynamic;
+        usize dynamic_num;
+        const u8 *symbols;
+        /// number of entries from `symbols` to the end of its segment, which bounds hash table lookups.
+        usize symbol_limit;
+        /// counted from the hash tables on first use, the GNU one takes a scan of all its buckets.
+        mutable usize symbol_num;
+        mutable bool symbol_counted;
+        usize symbol_entry_size;
+        const char *strings;
+        usize string_size;
+        const void *hash;
+        const void *gnu_hash;
+        /// borrowed view of the segment mapping file offset 0, so that file offsets below its size are valid.
+        MappedFileVisitor header_visitor;
+
+        /// number of bytes from `address` to the end of the loaded segment containing it, 0 if none does.
+        usize remain(USizeT address) const {
+            for (usize i = 0; i < program_num; ++i) {
+                const ProgramHeaderT &program = program_headers[i];
+                if (program.type != ProgramHeaderT::LOADABLE) continue;
+                USizeT start = bias + program.virtual_address;
+                if (address >= start && address - start < program.mem_size) return program.mem_size - (address - start);
+            }
+            return 0;
+        }
+
+        /// dynamic loaders relocate most address entries of PT_DYNAMIC in place, but not in read only dynamic
+        /// sections such as the one of the vDSO. Accept both, preferring the already relocated value.
+        const void *resolve(USizeT pointer, usize len) const {
+            if (remain(pointer) >= len && len > 0) return reinterpret_cast<const void *>(pointer);
+            if (remain(bias + pointer) >= len && len > 0) return reinterpret_cast<const void *>(bias + pointer);
+            return nullptr;
+        }
+
+        usize resolve_remain(USizeT pointer) const {
+            if (remain(pointer) > 0) return remain(pointer);
+            return remain(bias + pointer);
+        }
+
+        void load() {
+            for (usize i = 0; i < program_num; ++i) {
+                const ProgramHeaderT &program = program_headers[i];
+
+                if (program.type == ProgramHeaderT::LOADABLE && program.offset == 0) {
+                    header_visitor = MappedFileVisitor::borrow(
+                            reinterpret_cast<void *>(bias + program.virtual_address), program.file_size);
+                } else if (program.type == ProgramHeaderT::DYNAMIC_LINK_TABLE) {
+                    dynamic = reinterpret_cast<const DynEntryT *>(bias + program.virtual_address);
+                    dynamic_num = program.mem_size / sizeof(DynEntryT);
+                }
+            }
+
+            USizeT symbol_pointer = 0, string_pointer = 0, hash_pointer = 0, gnu_hash_pointer = 0;
+            symbol_entry_size = sizeof(SymbolTableEntryT);
+
+            for (usize i = 0; i < dynamic_num; ++i) {
+                const DynEntryT &entry = dynamic[i];
+                if (entry.tag == DynLinkingTableHeaderT::DYNAMIC_LINK_NULL) {
+                    dynamic_num = i;
+                    break;
+                }
+
+                switch (entry.tag) {
+                    case DynLinkingTableHeaderT::SYMBOL_TABLE:
+                        symbol_pointer = entry.val;
+                        break;
+                    case DynLinkingTableHeaderT::STRING_TABLE:
+                        string_pointer = entry.val;
+                        break;
+                    case DynLinkingTableHeaderT::STRING_TABLE_SIZE:
+                        string_size = entry.val;
+                        break;
+                    case DynLinkingTableHeaderT::SYMBOL_ENTRY_SIZE:
+                        symbol_entry_size = entry.val;
+                        break;
+                    case DynLinkingTableHeaderT::HASH:
+                        hash_pointer = entry.val;
+                        break;
+                    case DynLinkingTableHeaderT::GNU_HASH:
+                        gnu_hash_pointer = entry.val;
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            if (symbol_entry_size < sizeof(SymbolTableEntryT)) return;
+
+            strings = static_cast<const char *>(resolve(string_pointer, string_size));
+            if (strings == nullptr) string_size = 0;
+
+            if (gnu_hash_pointer != 0) gnu_hash = resolve(gnu_hash_pointer, 1);
+            if (hash_pointer != 0) hash = resolve(hash_pointer, 1);
+            if (gnu_hash == nullptr && hash == nullptr) return;
+
+            symbols = static_cast<const u8 *>(resolve(symbol_pointer, symbol_entry_size));
+            if (symbols != nullptr) symbol_limit = remain(reinterpret_cast<USizeT>(symbols)) / symbol_entry_size;
+        }
+
+        usize get_symbol_num() const {
+            if (!symbol_counted) {
+                usize num = gnu_hash == nullptr ? 0 : get_gnu_hash_table().symbol_num();
+                if (num == 0 && hash != nullptr) num = get_hash_table().symbol_num();
+                symbol_num = std::min(num, symbol_limit);
+                symbol_counted = true;
+            }
+            return symbol_num;
+        }
+
+    public:
+        LoadedImage(const char *name, USizeT bias, const void *program_headers, usize program_num) :
+                name{name}, bias{bias}, program_headers{static_cast<const ProgramHeaderT *>(program_headers)},
+                program_num{program_num}, dynamic{nullptr}, dynamic_num{0}, symbols{nullptr}, symbol_limit{0},
+                symbol_num{0}, symbol_counted{false}, symbol_entry_size{0}, strings{nullptr}, string_size{0},
+                hash{nullptr}, gnu_hash{nullptr}, header_visitor{} { load(); }
+
+        explicit LoadedImage(const struct dl_phdr_info *info) :
+                LoadedImage{info->dlpi_name, static_cast<USizeT>(info->dlpi_addr), info->dlpi_phdr, info->dlpi_phnum} {}
+
+        LoadedImage(LoadedImage &&other) noexcept = default;
+
+        LoadedImage &operator=(LoadedImage &&other) noexcept = default;
+
+        /// name given by the dynamic loader, empty for the main executable.
+        const char *get_name() const { return name; }
+
+        USizeT get_bias() const { return bias; }
+
+        /// file offset view of the first loaded segment, which covers the ELF and program headers.
+        MappedFileVisitor &get_visitor() { return header_visitor; }
+
+        /// return nullptr if the ELF header is not mapped. Not `ELFHeader::read`, the section header table is
+        /// usually outside of the loaded segments.
+        const ELFHeaderT *get_header() const {
+            auto *header = static_cast<const ELFHeaderT *>(header_visitor.address(0, sizeof(ELFHeaderT)));
+            if (header == nullptr || memcmp(header->magic_number, "\x7f" "ELF", 4) != 0) return nullptr;
+            return header;
+        }
+
+        TrustedTable<ProgramHeaderT> programs() const {
+            return TrustedTable<ProgramHeaderT>{const_cast<ProgramHeaderT *>(program_headers),
+                                                sizeof(ProgramHeaderT), program_num};
+        }
+
+        /// entries of PT_DYNAMIC up to DT_NULL.
+        TrustedTable<DynEntryT> dynamic_entries() const {
+            return TrustedTable<DynEntryT>{const_cast<DynEntryT *>(dynamic), sizeof(DynEntryT), dynamic_num};
+        }
+
+        /// the dynamic symbol table, empty if the image has no hash table to tell its size.
+        TrustedTable<SymbolTableEntryT> symbol_table() const {
+            return TrustedTable<SymbolTableEntryT>{const_cast<u8 *>(symbols), symbol_entry_size, get_symbol_num()};
+        }
+
+        MemoryStringTable string_table() const { return MemoryStringTable{strings, string_size}; }
+
+        HashTable get_hash_table() const {
+            return HashTable{hash, hash == nullptr ? 0 : resolve_remain(reinterpret_cast<USizeT>(hash))};
+        }
+
+        GnuHashTable<USizeT> get_gnu_hash_table() const {
+            return GnuHashTable<USizeT>{gnu_hash,
+                                        gnu_hash == nullptr ? 0 : resolve_remain(reinterpret_cast<USizeT>(gnu_hash))};
+        }
+
+        /// look up a symbol by name through the GNU hash table, or the SysV one. Return nullptr if not found. The
+        /// chains end the lookup, so the symbols are not counted.
+        const SymbolTableEntryT *find_symbol(const char *symbol_name) const {
+            TrustedTable<SymbolTableEntryT> table{const_cast<u8 *>(symbols), symbol_entry_size, symbol_limit};
+            usize index = 0;
+            if (gnu_hash != nullptr) {
+                index = get_gnu_hash_table().find(symbol_name, table, symbol_limit, string_table());
+            } else if (hash != nullptr) {
+                index = get_hash_table().find(symbol_name, table, symbol_limit, string_table());
+            }
+            return index == 0 ? nullptr : &table[index];
+        }
+
+        /// return the defined function or object symbol covering the run time `address`, nullptr if there is none.
+        /// A linear scan of the dynamic symbol table, it does not allocate.
+        const SymbolTableEntryT *find_symbol(USizeT address) const {
+            using SymbolTableHeaderT = _SymbolTableHeader<USizeT>;
+
+            const SymbolTableEntryT *found = nullptr;
+            for (auto &symbol: symbol_table()) {
+                if (symbol.section_header_index == SectionHeader<USizeT>::INDEX_UNDEFINED) continue;
+                if (symbol.get_type() != SymbolTableHeaderT::FUNCTION &&
+                    symbol.get_type() != SymbolTableHeaderT::OBJECT)
+                    continue;
+
+                USizeT start = bias + symbol.value;
+                if (address < start) continue;
+
+                /// a symbol with a size covering the address wins, otherwise the closest one without size.
+                if (symbol.size != 0) {
+                    if (address - start < symbol.size) return &symbol;
+                } else if (found == nullptr || symbol.value > found->value) {
+                    found = &symbol;
+                }
+            }
+            return found;
+        }
+
+        /// whether the run time `address` is in one of the loaded segments.
+        bool contains(USizeT address) const { return remain(address) > 0; }
+
+        USizeT get_address(const SymbolTableEntryT &symbol) const { return bias + symbol.value; }
+    };
+
+    using HostLoadedImage = LoadedImage<std::conditional<sizeof(void *) == 8, u64, u32>::type>;
+
+    /// snapshot of the images loaded in this process, the first one is the main executable.
+    inline std::vector<HostLoadedImage> loaded_images() {
+        std::vector<HostLoadedImage> images;
+        dl_iterate_phdr([](struct dl_phdr_info *info, size_t, void *data) -> int {
+            static_cast<std::vector<HostLoadedImage> *>(data)->emplace_back(info);
+            return 0;
+        }, &images);
+        return images;
+    }
+
+    struct LoadedSymbol {
+        const char *image;
+        const char *name;
+        u64 address;
+        u64 size;
+    };
+
+    /// find which loaded image defines `name`, in load order like the dynamic loader. Neither allocates nor makes
+    /// a system call.
+    inline bool find_loaded_symbol(const char *name, LoadedSymbol &result) {
+        struct Query {
+            const char *name;
+            LoadedSymbol *result;
+            bool found;
+        } query{name, &result, false};
+
+        dl_iterate_phdr([](struct dl_phdr_info *info, size_t, void *data) -> int {
+            auto *query = static_cast<Query *>(data);
+            HostLoadedImage image{info};
+
+            auto *symbol = image.find_symbol(query->name);
+            if (symbol == nullptr || symbol->section_header_index == 0) return 0;
+
+            *query->result = LoadedSymbol{image.get_name(), query->name, image.get_address(*symbol), symbol->size};
+            query->found = true;
+            return 1;
+        }, &query);
+
+        return query.found;
+    }
+
+    /// symbolize a run time address against the dynamic symbols of the loaded images, without allocation or
+    /// system calls.
+    inline bool symbolize_loaded(u64 address, LoadedSymbol &result) {
+        struct Query {
+            u64 address;
+            LoadedSymbol *result;
+            bool found;
+        } query{address, &result, false};
+
+        dl_iterate_phdr([](struct dl_phdr_info *info, size_t, void *data) -> int {
+            auto *query = static_cast<Query *>(data);
+            HostLoadedImage image{info};
+            if (!image.contains(query->address)) return 0;
+
+            auto *symbol = image.find_symbol(static_cast<decltype(image.get_bias())>(query->address));
+            *query->result = LoadedSymbol{image.get_name(), nullptr, 0, 0};
+            if (symbol != nullptr) {
+                query->result->name = image.string_table().get_str(symbol->name);
+                query->result->address = image.get_address(*symbol);
+                query->result->size = symbol->size;
+            }
+            query->found = true;
+            return 1;
+        }, &query);
+
+        return query.found;
+    }
+}
+
+namespace elf32 {
+    using LoadedImage = elf::LoadedImage<elf::u32>;
+}
+
+namespace elf64 {
+    using LoadedImage = elf::LoadedImage<elf::u64>;
+}
+
+
+#endif //ELF_LOADED_IMAGE_HPP
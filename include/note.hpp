@@ -0,0 +1,132 @@
+#ifndef ELF_NOTE_HPP
+#define ELF_NOTE_HPP
+
+
+#include <cstring>
+
+#include "elf_utility.hpp"
+
+
+namespace elf {
+    /// header of an entry of a note segment or section, followed by the name and the descriptor, each padded to
+    /// the alignment of the note table.
+    class Note {
+    public:
+        static constexpr u32 GNU_ABI_TAG = 1;
+        static constexpr u32 GNU_HASH_CAP = 2;
+        static constexpr u32 GNU_BUILD_ID = 3;
+        static constexpr u32 GNU_GOLD_VERSION = 4;
+        static constexpr u32 GNU_PROPERTY_TYPE_0 = 5;
+
+        /// types of the "CORE" notes of core files.
+        static constexpr u32 CORE_PRSTATUS = 1;
+        static constexpr u32 CORE_FPREGSET = 2;
+        static constexpr u32 CORE_PRPSINFO = 3;
+        static constexpr u32 CORE_AUXV = 6;
+        static constexpr u32 CORE_SIGINFO = 0x53494749;
+        static constexpr u32 CORE_FILE = 0x46494c45;
+
+        /// contains the size, in bytes, of the name, including the terminating zero.
+        u32 name_size;
+        /// contains the size, in bytes, of the descriptor.
+        u32 desc_size;
+        /// interpretation of the descriptor, depends on the name.
+        u32 type;
+
+        static usize align(usize val, usize alignment) { return (val + alignment - 1) & ~(alignment - 1); }
+
+        const char *get_name() const { return reinterpret_cast<const char *>(this + 1); }
+
+        bool is_name(const char *name) const {
+            return name_size == strlen(name) + 1 && memcmp(get_name(), name, name_size) == 0;
+        }
+
+        const u8 *get_desc(usize alignment) const {
+            return reinterpret_cast<const u8 *>(this + 1) + align(name_size, alignment);
+        }
+
+        usize total_size(usize alignment) const {
+            return sizeof(Note) + align(name_size, alignment) + align(desc_size, alignment);
+        }
+
+        friend std::ostream &operator<<(std::ostream &stream, const Note &self) {
+            stream << "Note {\n";
+            stream << "\tname_size: " << self.name_size << ",\n";
+            stream << "\tdesc_size: " << self.desc_size << ",\n";
+            stream << "\ttype: " << self.type << ",\n";
+            stream << '}';
+
+            return stream;
+        }
+    };
+
+    /// notes packed in a segment or a section. Every entry is checked to fit in the table before it is handed out,
+    /// iteration stops at the first malformed entry.
+    class NoteIterable {
+    private:
+        const u8 *inner;
+        const u8 *limit;
+        usize alignment;
+
+    public:
+        class Iter {
+        private:
+            const u8 *inner;
+            const u8 *limit;
+            usize alignment;
+
+            void check() {
+                usize remain = limit - inner;
+                if (remain < sizeof(Note)) {
+                    inner = limit;
+                    return;
+                }
+
+                const Note *note = reinterpret_cast<const Note *>(inner);
+                if (Note::align(note->name_size, alignment) > remain - sizeof(Note) ||
+                    Note::align(note->desc_size, alignment) >
+                    remain - sizeof(Note) - Note::align(note->name_size, alignment)) {
+                    inner = limit;
+                }
+            }
+
+        public:
+            Iter(const u8 *inner, const u8 *limit, usize alignment) :
+                    inner{inner}, limit{limit}, alignment{alignment} { check(); }
+
+            bool operator!=(const Iter &other) const { return inner != other.inner; }
+
+            Iter &operator++() {
+                inner += reinterpret_cast<const Note *>(inner)->total_size(alignment);
+                check();
+                return *this;
+            }
+
+            const Note &operator*() const { return *reinterpret_cast<const Note *>(inner); }
+
+            const Note *operator->() const { return reinterpret_cast<const Note *>(inner); }
+        };
+
+        /// `alignment` is the alignment of the segment or section, notes are aligned to 4 bytes unless it is 8.
+        NoteIterable(const void *inner, usize size, usize alignment) :
+                inner{static_cast<const u8 *>(inner)}, limit{static_cast<const u8 *>(inner) + size},
+                alignment{alignment == 8 ? 8u : 4u} {}
+
+        Iter begin() const { return Iter{inner, limit, alignment}; }
+
+        Iter end() const { return Iter{limit, limit, alignment}; }
+
+        usize get_alignment() const { return alignment; }
+
+        /// find the first note with `name` and `type`, return nullptr if there is none.
+        const Note *find(const char *name, u32 type) const {
+            for (auto &note: *this) {
+                if (note.type == type && note.is_name(name)) return &note;
+            }
+            return nullptr;
+        }
+    };
+}
+
+
+#endif //ELF_NOTE_HPP
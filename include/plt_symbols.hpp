@@ -0,0 +1,182 @@
+#ifndef ELF_PLT_SYMBOLS_HPP
+#define ELF_PLT_SYMBOLS_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "validated_elf.hpp"
+#include "symbol_index.hpp"
+
+
+namespace elf {
+    /// synthetic `name@plt` symbols for the stubs of .plt, .plt.sec and .plt.got, which have no symbols of their
+    /// own. Each stub loads its target from a GOT slot, and the JUMP_SLOT relocation of .rela.plt, or the GLOB_DAT
+    /// relocation of .rela.dyn for .plt.got, that fills the slot names the .dynsym symbol it calls. Stubs are
+    /// paired with their slots by decoding the one load every stub layout has in common, `jmp *slot(%rip)` on
+    /// x86-64 and `adrp x16, slot; ldr x17, [x16, #slot]` on AArch64, so lazy, BIND_NOW, IBT and BTI layouts are
+    /// all handled and the order of the stubs does not matter. Other machines have no stubs.
+    class PltSymbols {
+    public:
+        using Stub = SymbolIndex::Symbol;
+
+    private:
+        struct Slot {
+            u64 address;
+            const char *name;
+        };
+
+        /// relocation types filling a GOT slot with the address of a function.
+        static constexpr u32 X86_64_GLOB_DAT = 6;
+        static constexpr u32 X86_64_JUMP_SLOT = 7;
+        static constexpr u32 AARCH64_GLOB_DAT = 1025;
+        static constexpr u32 AARCH64_JUMP_SLOT = 1026;
+
+        SyntheticSymbols symbols;
+
+        template<typename USizeT, typename EntryT>
+        static void add_slots(const ValidatedELF<USizeT> &elf, const SectionHeader<USizeT> &section,
+                              u32 glob_dat, u32 jump_slot, std::vector<Slot> &slots) {
+            auto symbols = elf.get_symbol_table(elf.sections()[section.link]);
+            auto strings = elf.get_linked_string_table(elf.sections()[section.link]);
+
+            for (auto &relocation: elf.template get_entries<EntryT>(section)) {
+                usize type = relocation.get_type(), symbol = relocation.get_symbol();
+                if ((type != glob_dat && type != jump_slot) || symbol == 0) continue;
+
+                const char *name = strings.get_str(symbols[symbol].name);
+                if (name[0] != '\0') slots.push_back(Slot{relocation.offset, name});
+            }
+        }
+
+        static const char *find_slot(const std::vector<Slot> &slots, u64 address) {
+            auto iter = std::lower_bound(slots.begin(), slots.end(), address, [](const Slot &slot, u64 val) {
+                return slot.address < val;
+            });
+            return iter != slots.end() && iter->address == address ? iter->name : nullptr;
+        }
+
+        /// `jmp *disp(%rip)`, possibly after endbr64 and a bnd prefix, at the start of each entry.
+        static void scan_x86_64(const u8 *content, u64 address, u64 size, u64 entry_size,
+                                const std::vector<Slot> &slots, std::vector<Stub> &stubs) {
+            static const usize starts[] = {0, 1, 4, 5};
+
+            for (u64 offset = 0; entry_size <= size - offset; offset += entry_size) {
+                for (usize start: starts) {
+                    if (start + 6 > entry_size) break;
+
+                    const u8 *jump = content + offset + start;
+                    if (jump[0] != 0xff || jump[1] != 0x25) continue;
+
+                    i32 displacement;
+                    memcpy(&displacement, jump + 2, sizeof(displacement));
+                    const char *name = find_slot(slots, address + offset + start + 6 + displacement);
+                    if (name != nullptr) stubs.push_back(Stub{address + offset, entry_size, name});
+                    break;
+                }
+            }
+        }
+
+        /// `adrp x16, slot` followed by `ldr x17, [x16, #slot]`, possibly after `bti c`. A stub extends to the next
+        /// one, or to the end of the section.
+        static void scan_aarch64(const u8 *content, u64 address, u64 size, const std::vector<Slot> &slots,
+                                 std::vector<Stub> &stubs) {
+            usize first = stubs.size();
+
+            for (u64 offset = 0; offset + 8 <= size; offset += 4) {
+                u32 adrp, ldr;
+                memcpy(&adrp, content + offset, sizeof(adrp));
+                memcpy(&ldr, content + offset + 4, sizeof(ldr));
+                if ((adrp & 0x9f00001fu) != 0x90000010u || (ldr & 0xffc003ffu) != 0xf9400211u) continue;
+
+                /// 21 bit signed page delta, and the scaled 12 bit offset of the load.
+                u64 immediate = (static_cast<u64>(get_bits<u32, 24, 5>(adrp)) << 2u) | get_bits<u32, 31, 29>(adrp);
+                i64 page_delta = static_cast<i64>(immediate << 43u) >> 31;
+                u64 page = (address + offset) & ~static_cast<u64>(0xfff);
+                u64 slot = page + page_delta + get_bits<u32, 22, 10>(ldr) * 8;
+
+                const char *name = find_slot(slots, slot);
+                if (name == nullptr) continue;
+
+                u64 start = offset;
+                u32 previous = 0;
+                if (offset >= 4) memcpy(&previous, content + offset - 4, sizeof(previous));
+                if (previous == 0xd503245fu) start -= 4;
+
+                stubs.push_back(Stub{address + start, 0, name});
+            }
+
+            for (usize i = first; i < stubs.size(); ++i) {
+                u64 end = i + 1 < stubs.size() ? stubs[i + 1].address : address + size;
+                stubs[i].size = end - stubs[i].address;
+            }
+        }
+
+    public:
+        /// find the stubs of `elf`, replacing any previous content. The `name@plt` names are owned, see
+        /// `SyntheticSymbols`.
+        template<typename USizeT>
+        void build(const ValidatedELF<USizeT> &elf) {
+            using ELFHeaderT = ELFHeader<USizeT>;
+            using SectionHeaderT = SectionHeader<USizeT>;
+
+            symbols.clear();
+
+            auto machine = elf.get_header().machine_type;
+            if (machine != ELFHeaderT::X86_64 && machine != ELFHeaderT::AARCH64) return;
+            bool x86_64 = machine == ELFHeaderT::X86_64;
+            u32 glob_dat = x86_64 ? X86_64_GLOB_DAT : AARCH64_GLOB_DAT;
+            u32 jump_slot = x86_64 ? X86_64_JUMP_SLOT : AARCH64_JUMP_SLOT;
+
+            auto sections = elf.sections();
+            std::vector<Slot> slots;
+
+            for (auto &section: sections) {
+                if (section.link == 0 || section.link >= sections.size()) continue;
+                if (section.section_type == SectionHeaderT::RELOCATION_ADDEND_TABLE) {
+                    add_slots<USizeT, RelocationAddendEntry<USizeT>>(elf, section, glob_dat, jump_slot, slots);
+                } else if (section.section_type == SectionHeaderT::RELOCATION_TABLE) {
+                    add_slots<USizeT, RelocationEntry<USizeT>>(elf, section, glob_dat, jump_slot, slots);
+                }
+            }
+            if (slots.empty()) return;
+
+            std::sort(slots.begin(), slots.end(), [](const Slot &lhs, const Slot &rhs) {
+                return lhs.address < rhs.address;
+            });
+
+            /// stubs with the names of the symbols they call, `name@plt` is added once they are all found.
+            std::vector<Stub> stubs;
+
+            for (auto &section: sections) {
+                if (section.section_type == SectionHeaderT::NO_BITS) continue;
+                if ((section.flags & SectionHeaderT::EXECUTABLE) == 0) continue;
+                if (strncmp(elf.get_section_name(section), ".plt", 4) != 0) continue;
+
+                const u8 *content = elf.get_content(section);
+                if (x86_64) {
+                    /// 16 byte entries, except for .plt.got without IBT.
+                    u64 entry_size = section.entry_size == 8 || section.entry_size == 16 ? section.entry_size : 16;
+                    if (section.entry_size == 0 && strcmp(elf.get_section_name(section), ".plt.got") == 0) {
+                        entry_size = 8;
+                    }
+                    scan_x86_64(content, section.address, section.size, entry_size, slots, stubs);
+                } else {
+                    scan_aarch64(content, section.address, section.size, slots, stubs);
+                }
+            }
+
+            for (auto &stub: stubs) symbols.add(stub.address, stub.size, stub.name, "@plt");
+        }
+
+        /// add the stubs to `index`, which borrows the names from this object.
+        void add_to(SymbolIndex &index) const { symbols.add_to(index); }
+
+        const std::vector<Stub> &get_stubs() const { return symbols.get_symbols(); }
+    };
+}
+
+
+#endif //ELF_PLT_SYMBOLS_HPP
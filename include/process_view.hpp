@@ -0,0 +1,349 @@
+#ifndef ELF_PROCESS_VIEW_HPP
+#define ELF_PROCESS_VIEW_HPP
+
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+#include "validated_elf.hpp"
+#include "symbol_index.hpp"
+#include "plt_symbols.hpp"
+#include "function_starts.hpp"
+
+
+namespace elf {
+    /// an ELF file mapped into one or more processes, parsed once and shared through `ModuleCache`.
+    class Module {
+    public:
+        struct Segment {
+            u64 offset;
+            u64 file_size;
+            u64 virtual_address;
+        };
+
+    private:
+        MappedFileVisitor visitor;
+        std::string path;
+        std::string build_id;
+        std::vector<Segment> segments;
+        SymbolIndex symbols;
+        PltSymbols plt;
+        FunctionStarts functions;
+
+        template<typename USizeT>
+        bool parse() {
+            ValidatedELF<USizeT> elf = validate<USizeT>(visitor);
+            if (!elf.is_valid()) return false;
+
+            for (auto &program: elf.programs()) {
+                if (program.type != ProgramHeader<USizeT>::LOADABLE) continue;
+                segments.push_back(Segment{program.offset, program.file_size, program.virtual_address});
+            }
+
+            symbols.add_symbols(elf);
+            plt.build(elf);
+            plt.add_to(symbols);
+            functions.build(elf);
+            functions.add_to(symbols);
+            symbols.build();
+
+            return true;
+        }
+
+        template<typename USizeT>
+        static std::string build_id_of(MappedFileVisitor &visitor) {
+            static const char digits[] = "0123456789abcdef";
+
+            std::string build_id;
+            ELFHeader<USizeT> *header = ELFHeader<USizeT>::read(visitor);
+            const u8 *id = nullptr;
+            usize id_size = 0;
+
+            if (header != nullptr && header->get_build_id(visitor, id, id_size)) {
+                for (usize i = 0; i < id_size; ++i) {
+                    build_id += digits[id[i] >> 4u];
+                    build_id += digits[id[i] & 0xfu];
+                }
+            }
+
+            return build_id;
+        }
+
+    public:
+        /// hex encoded GNU build-id of the file, empty if it has none or is not an ELF file. Cheap, only the note
+        /// segments are read.
+        static std::string read_build_id(MappedFileVisitor &visitor) {
+            switch (get_elf_class(visitor)) {
+                case 1:
+                    return build_id_of<u32>(visitor);
+                case 2:
+                    return build_id_of<u64>(visitor);
+                default:
+                    return std::string{};
+            }
+        }
+
+        /// validate the file and build the symbol index, return nullptr if `visitor` is not a valid ELF file.
+        static std::unique_ptr<Module> load(MappedFileVisitor &&visitor, const std::string &path,
+                                            const std::string &build_id) {
+            std::unique_ptr<Module> module{new Module{}};
+            module->visitor = std::move(visitor);
+            module->path = path;
+            module->build_id = build_id;
+
+            bool success = false;
+            switch (get_elf_class(module->visitor)) {
+                case 1:
+                    success = module->parse<u32>();
+                    break;
+                case 2:
+                    success = module->parse<u64>();
+                    break;
+                default:
+                    break;
+            }
+
+            if (!success) module.reset();
+            return module;
+        }
+
+        /// load bias of a mapping of this file at `start` with file offset `offset`, that is, the difference
+        /// between run time addresses and the virtual addresses in the file. Return false if no loadable segment
+        /// covers the offset.
+        bool get_bias(u64 start, u64 offset, u64 page_size, u64 &bias) const {
+            /// a page may be shared by two segments, the segment starting in the page is preferred.
+            for (usize pass = 0; pass < 2; ++pass) {
+                for (auto &segment: segments) {
+                    u64 page_offset = segment.offset & ~(page_size - 1);
+                    if (pass == 0 ? offset != page_offset :
+                        offset < page_offset || offset - page_offset >= segment.file_size) {
+                        continue;
+                    }
+                    u64 page_address = segment.virtual_address & ~(page_size - 1);
+                    bias = start - (page_address + (offset - page_offset));
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        const std::string &get_path() const { return path; }
+
+        /// hex encoded GNU build-id, empty if the file has none.
+        const std::string &get_build_id() const { return build_id; }
+
+        const SymbolIndex &get_symbols() const { return symbols; }
+
+        const std::vector<Segment> &get_segments() const { return segments; }
+    };
+
+    /// owner of every `Module`, shared by all the process views of a host. A file is looked up by its identity
+    /// (device, inode, size and modification time) first, so a library mapped by thousands of processes is opened
+    /// and checked, but parsed only once. Distinct files with the same build-id share one module as well.
+    class ModuleCache {
+    private:
+        struct FileKey {
+            u64 device;
+            u64 inode;
+            u64 size;
+            i64 modify_sec;
+            i64 modify_nsec;
+
+            bool operator<(const FileKey &other) const {
+                if (device != other.device) return device < other.device;
+                if (inode != other.inode) return inode < other.inode;
+                if (size != other.size) return size < other.size;
+                if (modify_sec != other.modify_sec) return modify_sec < other.modify_sec;
+                return modify_nsec < other.modify_nsec;
+            }
+        };
+
+        std::vector<std::unique_ptr<Module>> modules;
+        std::unordered_map<std::string, Module *> by_build_id;
+        /// nullptr for files known not to be valid ELF files.
+        std::map<FileKey, Module *> by_file;
+        usize parsed;
+
+    public:
+        ModuleCache() : parsed{0} {}
+
+        /// take the ownership of `fd`, return nullptr if it is not a valid ELF file.
+        Module *get(int fd, const std::string &path) {
+            struct stat file_stat{};
+            if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+                close(fd);
+                return nullptr;
+            }
+
+            FileKey key{static_cast<u64>(file_stat.st_dev), static_cast<u64>(file_stat.st_ino),
+                        static_cast<u64>(file_stat.st_size), file_stat.st_mtim.tv_sec, file_stat.st_mtim.tv_nsec};
+
+            auto file_iter = by_file.find(key);
+            if (file_iter != by_file.end()) {
+                close(fd);
+                return file_iter->second;
+            }
+
+            MappedFileVisitor visitor = MappedFileVisitor::open_elf(fd);
+            std::string build_id = Module::read_build_id(visitor);
+
+            if (!build_id.empty()) {
+                auto build_id_iter = by_build_id.find(build_id);
+                if (build_id_iter != by_build_id.end()) return by_file[key] = build_id_iter->second;
+            }
+
+            ++parsed;
+            std::unique_ptr<Module> module = Module::load(std::move(visitor), path, build_id);
+            if (module == nullptr) return by_file[key] = nullptr;
+
+            if (!build_id.empty()) by_build_id[build_id] = module.get();
+            modules.push_back(std::move(module));
+            return by_file[key] = modules.back().get();
+        }
+
+        /// number of modules loaded, and number of files parsed, including the ones that are not valid ELF files.
+        usize module_num() const { return modules.size(); }
+
+        usize parsed_num() const { return parsed; }
+    };
+
+    /// file backed mappings of a live process, resolving absolute addresses to (module, symbol, offset).
+    class ProcessView {
+    public:
+        struct Mapping {
+            u64 start;
+            u64 end;
+            u64 offset;
+            u64 bias;
+            Module *module;
+        };
+
+        struct Location {
+            const Module *module;
+            /// nullptr if no symbol covers the address.
+            const SymbolIndex::Symbol *symbol;
+            /// virtual address in the module.
+            u64 address;
+            /// offset from the start of the symbol.
+            u64 offset;
+        };
+
+    private:
+        std::vector<Mapping> mappings;
+
+        static bool read_file(const char *path, std::string &content) {
+            int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+            if (fd == -1) return false;
+
+            char buffer[16384];
+            for (;;) {
+                ssize_t size = read(fd, buffer, sizeof(buffer));
+                if (size < 0) {
+                    close(fd);
+                    return false;
+                }
+                if (size == 0) break;
+                content.append(buffer, size);
+            }
+
+            close(fd);
+            return true;
+        }
+
+        /// open through `map_files` first, which keeps working when the file has been deleted or replaced on disk.
+        static int open_mapping(pid_t pid, u64 start, u64 end, const char *path) {
+            char map_file[64];
+            snprintf(map_file, sizeof(map_file), "/proc/%d/map_files/%llx-%llx", static_cast<int>(pid),
+                     static_cast<unsigned long long>(start), static_cast<unsigned long long>(end));
+
+            int fd = ::open(map_file, O_RDONLY | O_CLOEXEC);
+            if (fd != -1) return fd;
+
+            if (strstr(path, " (deleted)") != nullptr) return -1;
+            return ::open(path, O_RDONLY | O_CLOEXEC);
+        }
+
+    public:
+        /// parse `/proc/<pid>/maps` and load every mapped ELF file through `cache`, which must outlive the view.
+        static bool open(pid_t pid, ModuleCache &cache, ProcessView &view) {
+            char maps_path[32];
+            snprintf(maps_path, sizeof(maps_path), "/proc/%d/maps", static_cast<int>(pid));
+
+            std::string content;
+            if (!read_file(maps_path, content)) {
+                elf_warn("failed to read process maps!");
+                return false;
+            }
+
+            u64 page_size = sysconf(_SC_PAGESIZE);
+            view.mappings.clear();
+
+            /// "start-end perms offset major:minor inode path", the path may contain spaces.
+            usize line_begin = 0;
+            while (line_begin < content.size()) {
+                usize line_end = content.find('\n', line_begin);
+                if (line_end == std::string::npos) line_end = content.size();
+                std::string line = content.substr(line_begin, line_end - line_begin);
+                line_begin = line_end + 1;
+
+                unsigned long long start, end, offset, inode;
+                unsigned major, minor;
+                char perms[8];
+                int path_begin = 0;
+                if (sscanf(line.c_str(), "%llx-%llx %7s %llx %x:%x %llu %n", &start, &end, perms, &offset,
+                           &major, &minor, &inode, &path_begin) != 7)
+                    continue;
+                if (inode == 0 || line[path_begin] != '/') continue;
+
+                const char *path = line.c_str() + path_begin;
+                int fd = open_mapping(pid, start, end, path);
+                if (fd == -1) continue;
+
+                Module *module = cache.get(fd, path);
+                if (module == nullptr) continue;
+
+                u64 bias = 0;
+                if (!module->get_bias(start, offset, page_size, bias)) continue;
+
+                view.mappings.push_back(Mapping{start, end, offset, bias, module});
+            }
+
+            std::sort(view.mappings.begin(), view.mappings.end(), [](const Mapping &a, const Mapping &b) {
+                return a.start < b.start;
+            });
+
+            return true;
+        }
+
+        /// return false if `address` is not in a mapped ELF file.
+        bool symbolize(u64 address, Location &location) const {
+            auto iter = std::upper_bound(mappings.begin(), mappings.end(), address, [](u64 val, const Mapping &m) {
+                return val < m.start;
+            });
+
+            if (iter == mappings.begin()) return false;
+            --iter;
+            if (address >= iter->end) return false;
+
+            location.module = iter->module;
+            location.address = address - iter->bias;
+            location.symbol = iter->module->get_symbols().find(location.address);
+            location.offset = location.symbol == nullptr ? 0 : location.address - location.symbol->address;
+
+            return true;
+        }
+
+        const std::vector<Mapping> &get_mappings() const { return mappings; }
+    };
+}
+
+
+#endif //ELF_PROCESS_VIEW_HPP
@@ -2,6 +2,10 @@
 #define ELF_PROGRAM_HEADER_HPP
 
 
+#include "elf_utility.hpp"
+#include "note.hpp"
+
+
 namespace elf {
     template<typename USizeT>
     class _ProgramHeader;
@@ -35,7 +39,7 @@ namespace elf {
     template<typename USizeT>
     class ProgramHeader : public _ProgramHeader<USizeT> {
     public:
-        elf_enum_display(ProgramHeaderType, u32, 8,
+        elf_enum_display(ProgramHeaderType, u32, 9,
                          PROGRAM_NULL, 0,
                          LOADABLE, 1,
                          DYNAMIC_LINK_TABLE, 2,
@@ -43,7 +47,8 @@ namespace elf {
                          NOTE, 4,
                          SHARED_LIBRARY, 5,
                          PROGRAM_HEADER_TABLE, 6,
-                         THREAD_LOCAL_STORAGE, 7
+                         THREAD_LOCAL_STORAGE, 7,
+                         GNU_EH_FRAME, 0x6474e550
         );
 
         template<typename T>
@@ -91,6 +96,12 @@ namespace elf {
 
         bool is_read() const { return (this->flags & READ) > 0; }
 
+        /// patch a field in place, see `ELFHeader::set`.
+        template<typename FieldT, typename ValueT>
+        bool set(MappedFileVisitor &visitor, FieldT _ProgramHeader<USizeT>::*field, ValueT val) {
+            return visitor.write(&(this->*field), val);
+        }
+
         friend std::ostream &operator<<(std::ostream &stream, const ProgramHeader &self) {
             stream << "ELF" << sizeof(USizeT) * 8 << "ProgramHeader {\n";
             stream << "\ttype: " << self.get_type() << ",\n";
@@ -113,6 +124,18 @@ namespace elf {
         static constexpr u32 TYPE = ProgramHeader<USizeT>::LOADABLE;
     };
 
+    template<typename USizeT>
+    class NoteHeader : public ProgramHeader<USizeT> {
+    public:
+        static constexpr u32 TYPE = ProgramHeader<USizeT>::NOTE;
+
+        using TableT = NoteIterable;
+
+        TableT get_table(MappedFileVisitor &visitor) {
+            return TableT{visitor.trusted_address(this->offset), this->file_size, this->alignment};
+        }
+    };
+
     template<typename USizeT>
     class InterPathHeader : public ExecutableHeader<USizeT> {
     public:
@@ -130,12 +153,14 @@ namespace elf32 {
     using ProgramHeader = elf::ProgramHeader<elf::u32>;
     using ExecutableHeader = elf::ExecutableHeader<elf::u32>;
     using InterPathHeader = elf::InterPathHeader<elf::u32>;
+    using NoteHeader = elf::NoteHeader<elf::u32>;
 }
 
 namespace elf64 {
     using ProgramHeader = elf::ProgramHeader<elf::u64>;
     using ExecutableHeader = elf::ExecutableHeader<elf::u64>;
     using InterPathHeader = elf::InterPathHeader<elf::u64>;
+    using NoteHeader = elf::NoteHeader<elf::u64>;
 }
 
 
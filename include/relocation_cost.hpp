@@ -0,0 +1,361 @@
+#ifndef ELF_RELOCATION_COST_HPP
+#define ELF_RELOCATION_COST_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+#include "address_space.hpp"
+
+
+namespace elf {
+    /// startup cost of the dynamic relocations of an executable or shared object, as the dynamic loader sees
+    /// them: the tables are found through PT_DYNAMIC (DT_RELA, DT_REL, DT_JMPREL and DT_RELR), so .rela.dyn,
+    /// .rela.plt and packed relative relocations are all covered, with or without section headers. Relocations
+    /// are classified by type, the pages they write are counted per PT_LOAD segment, since each one is copied on
+    /// write in every process, and the relocations that make the loader look a symbol up before the program
+    /// starts are counted per symbol. JUMP_SLOT relocations only count as lookups with BIND_NOW.
+    class RelocationCost {
+    public:
+        elf_enum_display(Kind, u8, 8,
+                         RELATIVE, 0,       /// base plus addend, including the packed ones
+                         IRELATIVE, 1,      /// a call to an ifunc resolver
+                         GLOB_DAT, 2,       /// GOT entry of a data symbol or of a function called without the PLT
+                         JUMP_SLOT, 3,      /// GOT entry of a PLT stub
+                         SYMBOLIC, 4,       /// absolute address of a symbol stored in data
+                         COPY, 5,           /// copy of a shared library variable into the executable
+                         TLS, 6,            /// module id or offset of a thread local symbol
+                         OTHER, 7           /// unknown machine or type
+        );
+
+        static constexpr usize KIND_NUM = 8;
+
+        struct Segment {
+            /// index in the program header table.
+            usize index;
+            u64 address;
+            u64 mem_size;
+            u32 flags;
+            u64 page_num;
+            u64 dirty_page_num;
+            u64 relocation_num;
+        };
+
+        struct Lookup {
+            /// borrowed from the file, empty if the dynamic string table is not readable.
+            const char *name;
+            u64 count;
+        };
+
+        u64 counts[KIND_NUM];
+        /// relative relocations packed in DT_RELR, included in counts[RELATIVE].
+        u64 relr_num;
+        /// words of DT_RELR.
+        u64 relr_word_num;
+        /// relocations writing outside of every PT_LOAD segment.
+        u64 unmapped_num;
+        /// relocations resolving a symbol at load time, the sum of the counts of `lookups`.
+        u64 lookup_num;
+        /// JUMP_SLOT relocations left to be resolved on first call.
+        u64 lazy_num;
+        bool bind_now;
+        bool text_relocations;
+        std::vector<Segment> segments;
+        /// symbols looked up at load time, the most referenced first.
+        std::vector<Lookup> lookups;
+
+    private:
+        static constexpr u64 DF_TEXTREL = 0x4;
+        static constexpr u64 DF_BIND_NOW = 0x8;
+        static constexpr u64 DF_1_NOW = 0x1;
+
+        template<typename USizeT>
+        struct Tables {
+            USizeT rela, rela_size, rela_entry_size;
+            USizeT rel, rel_size, rel_entry_size;
+            USizeT jump_rel, jump_rel_size, plt_rel;
+            USizeT relr, relr_size;
+            USizeT symbols, symbol_entry_size, strings, string_size;
+        };
+
+        struct Pages {
+            u64 first_page;
+            std::vector<u64> bits;
+        };
+
+        static Kind classify(u16 machine, usize type) {
+            /// RELATIVE, IRELATIVE, GLOB_DAT, JUMP_SLOT and COPY types, then the symbolic and TLS ones.
+            struct Types {
+                u16 machine;
+                u32 relative, irelative, glob_dat, jump_slot, copy;
+                u32 symbolic[2];
+                u32 tls[4];
+            };
+            static const Types machines[] = {
+                    {62, 8, 37, 6, 7, 5, {1, 0}, {16, 17, 18, 0}},                  // X86_64
+                    {3, 8, 42, 6, 7, 5, {1, 0}, {14, 35, 36, 37}},                  // INTEL_80386
+                    {183, 1027, 1032, 1025, 1026, 1024, {257, 0}, {1028, 1029, 1030, 1031}},  // AARCH64
+                    {40, 23, 160, 21, 22, 20, {2, 0}, {17, 18, 19, 0}},             // ARM
+                    {243, 3, 58, 0, 5, 4, {1, 2}, {7, 9, 11, 0}},                   // RISCV
+            };
+
+            for (auto &types: machines) {
+                if (types.machine != machine) continue;
+                if (type == types.relative) return RELATIVE;
+                if (type == types.irelative) return IRELATIVE;
+                if (type != 0 && type == types.glob_dat) return GLOB_DAT;
+                if (type == types.jump_slot) return JUMP_SLOT;
+                if (type == types.copy) return COPY;
+                for (u32 symbolic: types.symbolic) {
+                    if (type != 0 && type == symbolic) return SYMBOLIC;
+                }
+                for (u32 tls: types.tls) {
+                    if (type != 0 && type == tls) return TLS;
+                }
+                return OTHER;
+            }
+
+            return OTHER;
+        }
+
+        void mark(u64 address, u64 page_size, std::vector<Pages> &pages, usize &last) {
+            if (last >= segments.size() || address - segments[last].address >= segments[last].mem_size) {
+                last = 0;
+                while (last < segments.size() && address - segments[last].address >= segments[last].mem_size) ++last;
+                if (last == segments.size()) {
+                    ++unmapped_num;
+                    return;
+                }
+            }
+
+            ++segments[last].relocation_num;
+            u64 page = address / page_size - pages[last].first_page;
+            pages[last].bits[page / 64] |= static_cast<u64>(1) << (page % 64);
+        }
+
+        /// count the relocations of one table, `addend` telling whether its entries are Elf_Rela.
+        template<typename USizeT>
+        bool add_table(const AddressSpace<USizeT> &space, u16 machine, USizeT address, USizeT size,
+                       USizeT entry_size, bool addend, u64 page_size, std::vector<Pages> &pages,
+                       std::unordered_map<usize, u64> &symbol_counts) {
+            if (size == 0) return true;
+
+            usize min_size = addend ? sizeof(RelocationAddendEntry<USizeT>) : sizeof(RelocationEntry<USizeT>);
+            if (entry_size == 0) entry_size = min_size;
+            if (entry_size < min_size) return false;
+
+            const u8 *data = space.read(address, size);
+            if (data == nullptr) return false;
+
+            usize last = 0;
+            for (USizeT offset = 0; entry_size <= size - offset; offset += entry_size) {
+                RelocationEntry<USizeT> entry{};
+                memcpy(&entry, data + offset, sizeof(entry));
+
+                Kind kind = classify(machine, entry.get_type());
+                ++counts[kind];
+                mark(entry.offset, page_size, pages, last);
+
+                usize symbol = entry.get_symbol();
+                if (symbol == 0) continue;
+                if (kind == JUMP_SLOT && !bind_now) {
+                    ++lazy_num;
+                    continue;
+                }
+
+                /// keyed by index, which comes straight from the file and may be far past the symbol table.
+                ++symbol_counts[symbol];
+                ++lookup_num;
+            }
+
+            return true;
+        }
+
+        template<typename USizeT>
+        const char *get_symbol_name(const AddressSpace<USizeT> &space, const Tables<USizeT> &tables,
+                                    const char *strings, usize symbol) const {
+            using SymbolTableEntryT = typename _SymbolTableHeader<USizeT>::SymbolTableEntry;
+
+            if (strings == nullptr || tables.symbol_entry_size < sizeof(SymbolTableEntryT)) return "";
+
+            SymbolTableEntryT entry{};
+            if (!space.read_value(tables.symbols + symbol * tables.symbol_entry_size, entry)) return "";
+            if (entry.name >= tables.string_size) return "";
+            if (strnlen(strings + entry.name, tables.string_size - entry.name) == tables.string_size - entry.name) {
+                return "";
+            }
+            return strings + entry.name;
+        }
+
+    public:
+        /// analyze the dynamic relocations of `header`, whose segments are mapped at page granularity `page_size`.
+        /// A file without PT_DYNAMIC has none. Return false if a relocation table is not readable.
+        template<typename USizeT>
+        static bool analyze(ELFHeader<USizeT> *header, MappedFileVisitor &visitor, RelocationCost &result,
+                            u64 page_size = 4096) {
+            using ProgramHeaderT = ProgramHeader<USizeT>;
+            using DynLinkingTableHeaderT = DynLinkingTableHeader<USizeT>;
+            using DynEntryT = typename DynLinkingTableHeaderT::Entry;
+
+            result = RelocationCost{};
+            AddressSpace<USizeT> space = AddressSpace<USizeT>::build(header, visitor);
+
+            std::vector<Pages> pages;
+            const DynEntryT *dynamic = nullptr;
+            usize dynamic_num = 0;
+            usize index = 0;
+
+            for (auto &program: header->programs(visitor)) {
+                usize program_index = index++;
+
+                if (program.type == ProgramHeaderT::DYNAMIC_LINK_TABLE) {
+                    dynamic = static_cast<const DynEntryT *>(visitor.address(program.offset, program.file_size));
+                    dynamic_num = dynamic == nullptr ? 0 : program.file_size / sizeof(DynEntryT);
+                }
+
+                if (program.type != ProgramHeaderT::LOADABLE || program.mem_size == 0) continue;
+                if (program.virtual_address + program.mem_size < program.virtual_address) continue;
+
+                u64 first_page = program.virtual_address / page_size;
+                u64 page_num = (program.virtual_address + program.mem_size - 1) / page_size - first_page + 1;
+                result.segments.push_back(Segment{program_index, program.virtual_address, program.mem_size,
+                                                  program.flags, page_num, 0, 0});
+                pages.push_back(Pages{first_page, std::vector<u64>((page_num + 63) / 64, 0)});
+            }
+
+            Tables<USizeT> tables{};
+            u64 flags = 0, flags_1 = 0;
+
+            for (usize i = 0; i < dynamic_num && dynamic[i].tag != DynLinkingTableHeaderT::DYNAMIC_LINK_NULL; ++i) {
+                USizeT val = dynamic[i].val;
+                switch (dynamic[i].tag) {
+                    case DynLinkingTableHeaderT::RELA:
+                        tables.rela = val;
+                        break;
+                    case DynLinkingTableHeaderT::RELA_SIZE:
+                        tables.rela_size = val;
+                        break;
+                    case DynLinkingTableHeaderT::RELA_ENTRY_SIZE:
+                        tables.rela_entry_size = val;
+                        break;
+                    case DynLinkingTableHeaderT::REL_TABLE:
+                        tables.rel = val;
+                        break;
+                    case DynLinkingTableHeaderT::REL_SIZE:
+                        tables.rel_size = val;
+                        break;
+                    case DynLinkingTableHeaderT::REL_ENTRY_SIZE:
+                        tables.rel_entry_size = val;
+                        break;
+                    case DynLinkingTableHeaderT::JUMP_REL:
+                        tables.jump_rel = val;
+                        break;
+                    case DynLinkingTableHeaderT::PLT_ENTRY_SIZE:
+                        tables.jump_rel_size = val;
+                        break;
+                    case DynLinkingTableHeaderT::PLT_REL:
+                        tables.plt_rel = val;
+                        break;
+                    case DynLinkingTableHeaderT::RELR:
+                        tables.relr = val;
+                        break;
+                    case DynLinkingTableHeaderT::RELR_SIZE:
+                        tables.relr_size = val;
+                        break;
+                    case DynLinkingTableHeaderT::SYMBOL_TABLE:
+                        tables.symbols = val;
+                        break;
+                    case DynLinkingTableHeaderT::SYMBOL_ENTRY_SIZE:
+                        tables.symbol_entry_size = val;
+                        break;
+                    case DynLinkingTableHeaderT::STRING_TABLE:
+                        tables.strings = val;
+                        break;
+                    case DynLinkingTableHeaderT::STRING_TABLE_SIZE:
+                        tables.string_size = val;
+                        break;
+                    case DynLinkingTableHeaderT::BIND_NOW:
+                        result.bind_now = true;
+                        break;
+                    case DynLinkingTableHeaderT::TEXT_REL:
+                        result.text_relocations = true;
+                        break;
+                    case DynLinkingTableHeaderT::FLAGS:
+                        flags = val;
+                        break;
+                    case DynLinkingTableHeaderT::FLAGS_1: flags_1 = val; break;
+                    default:
+                        break;
+                }
+            }
+
+            if ((flags & DF_BIND_NOW) != 0 || (flags_1 & DF_1_NOW) != 0) result.bind_now = true;
+            if ((flags & DF_TEXTREL) != 0) result.text_relocations = true;
+
+            /// some linkers let DT_RELA or DT_REL cover DT_JMPREL as well, the loader then skips the overlap.
+            bool plt_addend = tables.plt_rel == DynLinkingTableHeaderT::RELA;
+            USizeT &plt_table = plt_addend ? tables.rela : tables.rel;
+            USizeT &plt_table_size = plt_addend ? tables.rela_size : tables.rel_size;
+            if (tables.jump_rel_size != 0 && tables.jump_rel >= plt_table &&
+                tables.jump_rel - plt_table < plt_table_size) {
+                plt_table_size = tables.jump_rel - plt_table;
+            }
+
+            u16 machine = header->machine_type;
+            std::unordered_map<usize, u64> symbol_counts;
+
+            if (!result.add_table(space, machine, tables.rela, tables.rela_size, tables.rela_entry_size, true,
+                                  page_size, pages, symbol_counts) ||
+                !result.add_table(space, machine, tables.rel, tables.rel_size, tables.rel_entry_size, false,
+                                  page_size, pages, symbol_counts) ||
+                !result.add_table(space, machine, tables.jump_rel, tables.jump_rel_size,
+                                  plt_addend ? tables.rela_entry_size : tables.rel_entry_size, plt_addend,
+                                  page_size, pages, symbol_counts)) {
+                return false;
+            }
+
+            if (tables.relr_size != 0) {
+                const void *words = space.read(tables.relr, tables.relr_size);
+                if (words == nullptr) return false;
+
+                result.relr_word_num = tables.relr_size / sizeof(USizeT);
+                usize last = 0;
+                RelrTable<USizeT>{words, static_cast<usize>(result.relr_word_num)}.for_each([&](USizeT address) {
+                    ++result.relr_num;
+                    result.mark(address, page_size, pages, last);
+                });
+                result.counts[RELATIVE] += result.relr_num;
+            }
+
+            for (usize i = 0; i < pages.size(); ++i) {
+                for (u64 bits: pages[i].bits) result.segments[i].dirty_page_num += __builtin_popcountll(bits);
+            }
+
+            const char *strings = reinterpret_cast<const char *>(space.read(tables.strings, tables.string_size));
+            for (auto &count: symbol_counts) {
+                result.lookups.push_back(Lookup{result.get_symbol_name(space, tables, strings, count.first),
+                                                count.second});
+            }
+            std::sort(result.lookups.begin(), result.lookups.end(), [](const Lookup &lhs, const Lookup &rhs) {
+                if (lhs.count != rhs.count) return lhs.count > rhs.count;
+                return strcmp(lhs.name, rhs.name) < 0;
+            });
+
+            return true;
+        }
+
+        /// relocations of all kinds, packed ones included.
+        u64 get_relocation_num() const {
+            u64 num = 0;
+            for (u64 count: counts) num += count;
+            return num;
+        }
+    };
+}
+
+
+#endif //ELF_RELOCATION_COST_HPP
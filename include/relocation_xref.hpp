@@ -0,0 +1,151 @@
+#ifndef ELF_RELOCATION_XREF_HPP
+#define ELF_RELOCATION_XREF_HPP
+
+
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "validated_elf.hpp"
+
+
+namespace elf {
+    /// symbol to relocation cross reference, the reverse of `RelocationEntry::get_symbol`: every relocation of every
+    /// SHT_REL and SHT_RELA section linked to a symbol table, .rela.dyn and .rela.plt included, listed under the
+    /// symbol it refers to. The symbols of all symbol tables are numbered consecutively in section order, and the
+    /// sites are stored in CSR form, one array of sites grouped by symbol and one array of offsets into it. Both are
+    /// filled by a counting sort in two passes over the relocations, so building allocates three arrays and keeps
+    /// the sites of a symbol in file order.
+    class RelocationXRef {
+    public:
+        struct Site {
+            /// r_offset, a section offset in relocatable files and a virtual address otherwise.
+            u64 offset;
+            /// 0 for SHT_REL relocations.
+            i64 addend;
+            /// index of the relocation section, whose `info` is the section the relocation applies to if any.
+            u32 section;
+            u32 type;
+        };
+
+        class Sites {
+        private:
+            const Site *first;
+            const Site *last;
+
+        public:
+            Sites(const Site *first, const Site *last) : first{first}, last{last} {}
+
+            const Site *begin() const { return first; }
+
+            const Site *end() const { return last; }
+
+            usize size() const { return last - first; }
+
+            bool empty() const { return first == last; }
+        };
+
+    private:
+        static constexpr usize NONE = static_cast<usize>(-1);
+
+        /// number of the first symbol of every section that is a symbol table, NONE for the other sections.
+        std::vector<usize> table_bases;
+        /// sites of symbol n are sites[offsets[n], offsets[n + 1]).
+        std::vector<usize> offsets;
+        std::vector<Site> sites;
+
+        template<typename USizeT, typename EntryT, typename F>
+        static void visit_entries(const ValidatedELF<USizeT> &elf, const SectionHeader<USizeT> &section, F f) {
+            for (auto &relocation: elf.template get_entries<EntryT>(section)) f(relocation);
+        }
+
+        /// call `f(section_index, base, relocation, addend)` on the relocations of every relocation section linked
+        /// to a symbol table, `base` being the number of the first symbol of that table.
+        template<typename USizeT, typename F>
+        void visit_relocations(const ValidatedELF<USizeT> &elf, F f) const {
+            using SectionHeaderT = SectionHeader<USizeT>;
+
+            auto sections = elf.sections();
+            for (usize i = 0; i < sections.size(); ++i) {
+                auto &section = sections[i];
+                bool addend = section.section_type == SectionHeaderT::RELOCATION_ADDEND_TABLE;
+                if (!addend && section.section_type != SectionHeaderT::RELOCATION_TABLE) continue;
+                if (section.link == 0) continue;
+
+                usize base = table_bases[section.link];
+                auto index = static_cast<u32>(i);
+
+                if (!addend) {
+                    visit_entries<USizeT, RelocationEntry<USizeT>>(elf, section, [&](RelocationEntry<USizeT> &entry) {
+                        f(index, base, entry, 0);
+                    });
+                } else {
+                    visit_entries<USizeT, RelocationAddendEntry<USizeT>>(
+                            elf, section, [&](RelocationAddendEntry<USizeT> &entry) {
+                                f(index, base, entry, static_cast<i64>(entry.addend));
+                            });
+                }
+            }
+        }
+
+    public:
+        /// index the relocations of `elf`, replacing any previous content.
+        template<typename USizeT>
+        void build(const ValidatedELF<USizeT> &elf) {
+            using SectionHeaderT = SectionHeader<USizeT>;
+
+            auto sections = elf.sections();
+            table_bases.assign(sections.size(), static_cast<usize>(NONE));
+
+            usize symbol_num = 0;
+            for (usize i = 0; i < sections.size(); ++i) {
+                auto &section = sections[i];
+                if (section.section_type != SectionHeaderT::SYMBOL_TABLE &&
+                    section.section_type != SectionHeaderT::DYNAMIC_SYMBOL_TABLE)
+                    continue;
+                table_bases[i] = symbol_num;
+                symbol_num += section.size / section.entry_size;
+            }
+
+            /// counts go two slots ahead so that after the prefix sum offsets[n + 1] is the start of symbol n, and
+            /// after the fill, which advances it, the end of symbol n.
+            offsets.assign(symbol_num + 2, 0);
+            visit_relocations(elf, [&](u32, usize base, RelocationEntry<USizeT> &entry, i64) {
+                usize symbol = entry.get_symbol();
+                if (symbol != 0) ++offsets[base + symbol + 2];
+            });
+
+            for (usize i = 2; i < offsets.size(); ++i) offsets[i] += offsets[i - 1];
+            sites.resize(offsets.back());
+
+            visit_relocations(elf, [&](u32 section, usize base, RelocationEntry<USizeT> &entry, i64 addend) {
+                usize symbol = entry.get_symbol();
+                if (symbol == 0) return;
+                sites[offsets[base + symbol + 1]++] = Site{entry.offset, addend, section,
+                                                           static_cast<u32>(entry.get_type())};
+            });
+
+            offsets.pop_back();
+        }
+
+        /// sites referring to symbol `symbol` of the symbol table in section `symbol_table`, empty if that section
+        /// is not a symbol table.
+        Sites find(usize symbol_table, usize symbol) const {
+            if (symbol_table >= table_bases.size() || table_bases[symbol_table] == NONE) {
+                return Sites{nullptr, nullptr};
+            }
+
+            usize index = table_bases[symbol_table] + symbol;
+            if (index + 1 >= offsets.size()) return Sites{nullptr, nullptr};
+            return Sites{sites.data() + offsets[index], sites.data() + offsets[index + 1]};
+        }
+
+        /// number of relocations referring to a symbol.
+        usize size() const { return sites.size(); }
+
+        /// number of symbols over all symbol tables.
+        usize get_symbol_num() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    };
+}
+
+
+#endif //ELF_RELOCATION_XREF_HPP
@@ -2,14 +2,19 @@
 #define ELF_SECTION_HEADER_HPP
 
 
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
 #include "elf_utility.hpp"
+#include "note.hpp"
 
 
 namespace elf {
     template<typename USizeT>
     class SectionHeader {
     public:
-        elf_enum_display(SectionHeaderType, u32, 15,
+        elf_enum_display(SectionHeaderType, u32, 21,
                          SECTION_NULL, 0,               /// marks an unused section header
                          PROGRAM_BITS, 1,               /// information defined by the program
                          SYMBOL_TABLE, 2,               /// a linker symbol table
@@ -24,12 +29,28 @@ namespace elf {
                          DYNAMIC_SYMBOL_TABLE, 11,      /// a dynamic loader symbol table
                          INITIALIZE_ARRAY, 14,          /// an array of pointers to initialization functions
                          TERMINATION_ARRAY, 15,         /// an array of pointers to termination functions
-                         PRE_INITIALIZE_ARRAY, 16       /// an array of pointers to pre-initialization functions
+                         PRE_INITIALIZE_ARRAY, 16,      /// an array of pointers to pre-initialization functions
+                         SYMBOL_TABLE_INDEX, 18,        /// extended section indices of a symbol table
+                         RELR_TABLE, 19,                /// packed relative relocations
+                         GNU_HASH, 0x6ffffff6,          /// a GNU style symbol hash table
+                         VERSION_DEF, 0x6ffffffd,       /// symbol versions defined by the object
+                         VERSION_NEED, 0x6ffffffe,      /// symbol versions required from other objects
+                         VERSION_SYMBOL, 0x6fffffff     /// the version index of each dynamic symbol
         );
 
         static constexpr USizeT WRITE = 1;
         static constexpr USizeT ALLOCATE = 2;
         static constexpr USizeT EXECUTABLE = 4;
+        /// the content starts with a compression header, as debug sections linked with --compress-debug-sections.
+        static constexpr USizeT COMPRESSED = 0x800;
+
+        /// reserved section indices, values in [INDEX_LOW_RESERVE, INDEX_HIGH_RESERVE] never refer to a section.
+        static constexpr u32 INDEX_UNDEFINED = 0;
+        static constexpr u32 INDEX_LOW_RESERVE = 0xff00;
+        static constexpr u32 INDEX_ABSOLUTE = 0xfff1;
+        static constexpr u32 INDEX_COMMON = 0xfff2;
+        static constexpr u32 INDEX_EXTENDED = 0xffff;
+        static constexpr u32 INDEX_HIGH_RESERVE = 0xffff;
 
         template<typename T>
         static T *cast(SectionHeader *self, MappedFileVisitor &visitor) {
@@ -74,6 +95,12 @@ namespace elf {
 
         bool is_executable() const { return (flags & EXECUTABLE) > 0; }
 
+        /// patch a field in place, see `ELFHeader::set`.
+        template<typename FieldT, typename ValueT>
+        bool set(MappedFileVisitor &visitor, FieldT SectionHeader::*field, ValueT val) {
+            return visitor.write(&(this->*field), val);
+        }
+
         friend std::ostream &operator<<(std::ostream &stream, const SectionHeader &self) {
             stream << "ELF" << sizeof(USizeT) * 8 << "SectionHeader {\n";
             stream << "\tname: " << self.name << ",\n";
@@ -150,6 +177,19 @@ namespace elf {
         TableT get_table(MappedFileVisitor &visitor) { return TableT{*this, visitor}; }
     };
 
+    template<typename USizeT>
+    class NoteSectionHeader : public SectionHeader<USizeT> {
+    public:
+        static constexpr u32 TYPE = SectionHeader<USizeT>::NOTE;
+        static constexpr usize ENTRY_SIZE = 0;
+
+        using TableT = NoteIterable;
+
+        TableT get_table(MappedFileVisitor &visitor) {
+            return TableT{visitor.trusted_address(this->offset), this->size, this->alignment};
+        }
+    };
+
     template<typename USizeT>
     class _SymbolTableEntry;
 
@@ -213,7 +253,8 @@ namespace elf {
             ///
             /// section_header_index: contains the section index of the section in which the symbol is “defined.” For
             ///     undefined symbols, this field contains SHN_UNDEF; for absolute symbols, it contains SHN_ABS; and
-            ///     for common symbols, it contains SHN_COMMON.
+            ///     for common symbols, it contains SHN_COMMON. If it contains SHN_XINDEX, the index is in the
+            ///     SHT_SYMTAB_SHNDX section of the symbol table, see `SymbolTableIndex`.
             ///
             /// value: contains the value of the symbol. This may be an absolute value or a relocatable address.
             ///
@@ -228,6 +269,13 @@ namespace elf {
                 return static_cast<SymbolVisibility>(get_bits<u8, 2, 0>(this->other));
             }
 
+            /// patch a field in place, as `symbol.set(visitor, &SymbolTableEntry::value, address)`, see
+            /// `ELFHeader::set`.
+            template<typename FieldT, typename ValueT>
+            bool set(MappedFileVisitor &visitor, FieldT _SymbolTableEntry<USizeT>::*field, ValueT val) {
+                return visitor.write(&(this->*field), val);
+            }
+
             friend std::ostream &operator<<(std::ostream &stream, const SymbolTableEntry &self) {
                 stream << "ELF" << sizeof(USizeT) * 8 << "SymbolTableEntry {\n";
                 stream << "\tname: " << self.name << ",\n";
@@ -262,6 +310,338 @@ namespace elf {
         static constexpr u32 TYPE = SectionHeader<USizeT>::DYNAMIC_SYMBOL_TABLE;
     };
 
+    /// content of a SHT_SYMTAB_SHNDX section, a u32 for each entry of the linked symbol table in parallel. It holds
+    /// the section index of the symbols whose `section_header_index` is SHN_XINDEX, and zero for the others.
+    class SymbolTableIndex {
+    private:
+        const u32 *inner;
+        usize num;
+
+    public:
+        /// empty table, for symbol tables without a section index table.
+        SymbolTableIndex() : inner{nullptr}, num{0} {}
+
+        SymbolTableIndex(const void *inner, usize num) : inner{static_cast<const u32 *>(inner)}, num{num} {}
+
+        usize size() const { return num; }
+
+        /// section index of the `index`-th `symbol` of the linked symbol table, SHN_XINDEX if the table misses it.
+        template<typename EntryT>
+        u32 get_section_index(const EntryT &symbol, usize index) const {
+            /// SHN_XINDEX is the same in both classes.
+            if (symbol.section_header_index != SectionHeader<u64>::INDEX_EXTENDED) return symbol.section_header_index;
+            return index < num ? inner[index] : u32{SectionHeader<u64>::INDEX_EXTENDED};
+        }
+    };
+
+    template<typename USizeT>
+    class SymbolTableIndexHeader : public SectionHeader<USizeT> {
+    public:
+        static constexpr u32 TYPE = SectionHeader<USizeT>::SYMBOL_TABLE_INDEX;
+        static constexpr usize ENTRY_SIZE = sizeof(u32);
+
+        using TableT = SymbolTableIndex;
+
+        TableT get_table(MappedFileVisitor &visitor) {
+            return TableT{visitor.trusted_address(this->offset), static_cast<usize>(this->size / sizeof(u32))};
+        }
+    };
+
+    /// content of a SHT_GNU_versym section, a u16 version index for each entry of the linked dynamic symbol
+    /// table in parallel. Index 0 is local, 1 is global without version, the others are defined in the
+    /// SHT_GNU_verdef or SHT_GNU_verneed sections.
+    class VersionSymbolTable {
+    private:
+        const u16 *inner;
+        usize num;
+
+    public:
+        static constexpr u16 LOCAL = 0;
+        static constexpr u16 GLOBAL = 1;
+        static constexpr u16 HIDDEN = 0x8000;
+
+        /// empty table, every symbol is global.
+        VersionSymbolTable() : inner{nullptr}, num{0} {}
+
+        VersionSymbolTable(const void *inner, usize num) : inner{static_cast<const u16 *>(inner)}, num{num} {}
+
+        usize size() const { return num; }
+
+        /// version index of the `index`-th symbol, without the hidden bit.
+        u16 get_version(usize index) const { return index < num ? inner[index] & ~HIDDEN : GLOBAL; }
+
+        /// a hidden version is not the default version of the symbol, it binds only when asked for by name@version.
+        bool is_hidden(usize index) const { return index < num && (inner[index] & HIDDEN) != 0; }
+    };
+
+    template<typename USizeT>
+    class VersionSymbolHeader : public SectionHeader<USizeT> {
+    public:
+        static constexpr u32 TYPE = SectionHeader<USizeT>::VERSION_SYMBOL;
+        static constexpr usize ENTRY_SIZE = sizeof(u16);
+
+        using TableT = VersionSymbolTable;
+
+        TableT get_table(MappedFileVisitor &visitor) {
+            return TableT{visitor.trusted_address(this->offset), static_cast<usize>(this->size / sizeof(u16))};
+        }
+    };
+
+    /// Elf_Verdef, a version defined by the object, its name is the first auxiliary entry.
+    struct VersionDefinition {
+        u16 version;
+        u16 flags;
+        u16 index;
+        u16 aux_num;
+        u32 hash;
+        u32 aux;
+        u32 next;
+    };
+
+    /// Elf_Verdaux
+    struct VersionDefinitionAux {
+        u32 name;
+        u32 next;
+    };
+
+    /// Elf_Verneed, a file the object needs versions from, the versions are the auxiliary entries.
+    struct VersionNeed {
+        u16 version;
+        u16 aux_num;
+        u32 file;
+        u32 aux;
+        u32 next;
+    };
+
+    /// Elf_Vernaux
+    struct VersionNeedAux {
+        u32 hash;
+        u16 flags;
+        u16 index;
+        u32 name;
+        u32 next;
+    };
+
+    /// SHT_GNU_verdef and SHT_GNU_verneed, linked lists of records chained by byte offsets. `info` is the number of
+    /// records and `link` the string table of the names.
+    template<typename USizeT, u32 Type, typename EntryT, typename AuxT>
+    class _VersionHeader : public SectionHeader<USizeT> {
+    private:
+        template<typename T>
+        const T *at(MappedFileVisitor &visitor, u64 offset) const {
+            if (offset > this->size || this->size - offset < sizeof(T)) return nullptr;
+            return reinterpret_cast<const T *>(visitor.trusted_address(this->offset + offset));
+        }
+
+        static u16 get_index(const VersionDefinition &entry, const VersionDefinitionAux &) { return entry.index; }
+
+        static u16 get_index(const VersionNeed &, const VersionNeedAux &aux) { return aux.index; }
+
+        static bool is_named(const VersionDefinition &, usize aux_index) { return aux_index == 0; }
+
+        static bool is_named(const VersionNeed &, usize) { return true; }
+
+    public:
+        static constexpr u32 TYPE = Type;
+        static constexpr usize ENTRY_SIZE = 0;
+
+        /// store the string table offset of the name of each version at its index in `names`, growing it as
+        /// needed, 0 for indices without a name. Return false if a record is out of the section.
+        bool get_names(MappedFileVisitor &visitor, std::vector<u32> &names) const {
+            u64 offset = 0;
+            for (u32 i = 0; i < this->info; ++i) {
+                const EntryT *entry = at<EntryT>(visitor, offset);
+                if (entry == nullptr) return false;
+
+                u64 aux_offset = offset + entry->aux;
+                for (usize j = 0; j < entry->aux_num; ++j) {
+                    const AuxT *aux = at<AuxT>(visitor, aux_offset);
+                    if (aux == nullptr) return false;
+
+                    if (is_named(*entry, j)) {
+                        u16 index = get_index(*entry, *aux) & ~VersionSymbolTable::HIDDEN;
+                        if (names.size() <= index) names.resize(index + 1, 0);
+                        names[index] = aux->name;
+                    }
+
+                    if (aux->next == 0) break;
+                    aux_offset += aux->next;
+                }
+
+                if (entry->next == 0) break;
+                offset += entry->next;
+            }
+
+            return true;
+        }
+    };
+
+    template<typename USizeT>
+    using VersionDefinitionHeader = _VersionHeader<USizeT, SectionHeader<USizeT>::VERSION_DEF,
+            VersionDefinition, VersionDefinitionAux>;
+
+    template<typename USizeT>
+    using VersionNeedHeader = _VersionHeader<USizeT, SectionHeader<USizeT>::VERSION_NEED, VersionNeed,
+            VersionNeedAux>;
+
+    /// SysV symbol hash table, the words are nbucket, nchain, bucket[nbucket] and chain[nchain]. nchain equals
+    /// the number of symbols of the associated symbol table.
+    class HashTable {
+    private:
+        const u32 *inner;
+        usize bucket_num;
+        usize chain_num;
+
+    public:
+        /// `size` is the size of the table in bytes, an invalid table looks up nothing.
+        HashTable(const void *inner, usize size) : inner{static_cast<const u32 *>(inner)}, bucket_num{0}, chain_num{0} {
+            if (size < 2 * sizeof(u32)) return;
+            usize num = size / sizeof(u32) - 2;
+            if (this->inner[0] > num || this->inner[1] > num - this->inner[0]) return;
+            bucket_num = this->inner[0];
+            chain_num = this->inner[1];
+        }
+
+        usize symbol_num() const { return chain_num; }
+
+        /// return the index of the symbol named `name`, 0 if there is none. `symbols` and `strings` are the symbol
+        /// table and its string table, only their `operator[]` and `get_str` are used.
+        template<typename SymbolsT, typename StringsT>
+        usize find(const char *name, const SymbolsT &symbols, usize symbol_num, const StringsT &strings) const {
+            if (bucket_num == 0) return 0;
+
+            const u32 *buckets = inner + 2;
+            const u32 *chains = buckets + bucket_num;
+            usize limit = std::min(symbol_num, chain_num);
+
+            /// a chain longer than the table has a loop.
+            usize index = buckets[elf_hash(name) % bucket_num];
+            for (usize step = 0; index != 0 && index < limit && step < limit; ++step) {
+                const char *str = strings.get_str(symbols[index].name);
+                if (str != nullptr && strcmp(str, name) == 0) return index;
+                index = chains[index];
+            }
+
+            return 0;
+        }
+    };
+
+    elf_static_inline u32 gnu_hash(const char *name) {
+        u32 h = 5381;
+        for (; *name != '\0'; ++name) h = h * 33 + static_cast<u8>(*name);
+        return h;
+    }
+
+    /// GNU symbol hash table: nbucket, symoffset, bloom_size and bloom_shift words, a bloom filter of bloom_size
+    /// address sized words, bucket[nbucket] and a chain word per hashed symbol. Symbols below symoffset are not
+    /// hashed, the hashed ones are sorted by bucket and the low bit of a chain word marks the end of a bucket.
+    template<typename USizeT>
+    class GnuHashTable {
+    private:
+        const u32 *inner;
+        usize bucket_num;
+        usize symbol_offset;
+        usize bloom_size;
+        u32 bloom_shift;
+        const USizeT *bloom;
+        const u32 *buckets;
+        const u32 *chains;
+        usize chain_num;
+
+    public:
+        /// `size` is the size of the table in bytes, an invalid table looks up nothing.
+        GnuHashTable(const void *inner, usize size) :
+                inner{static_cast<const u32 *>(inner)}, bucket_num{0}, symbol_offset{0}, bloom_size{0},
+                bloom_shift{0}, bloom{nullptr}, buckets{nullptr}, chains{nullptr}, chain_num{0} {
+            if (size < 4 * sizeof(u32)) return;
+            usize remain = size - 4 * sizeof(u32);
+            if (this->inner[2] == 0 || this->inner[2] > remain / sizeof(USizeT)) return;
+            remain -= this->inner[2] * sizeof(USizeT);
+            if (this->inner[0] == 0 || this->inner[0] > remain / sizeof(u32)) return;
+            remain -= this->inner[0] * sizeof(u32);
+
+            bucket_num = this->inner[0];
+            symbol_offset = this->inner[1];
+            bloom_size = this->inner[2];
+            bloom_shift = this->inner[3];
+            bloom = reinterpret_cast<const USizeT *>(this->inner + 4);
+            buckets = reinterpret_cast<const u32 *>(bloom + bloom_size);
+            chains = buckets + bucket_num;
+            chain_num = remain / sizeof(u32);
+        }
+
+        bool is_valid() const { return bucket_num != 0; }
+
+        /// number of symbols of the associated symbol table, which the dynamic section does not record, 0 if the
+        /// table is invalid.
+        usize symbol_num() const {
+            if (bucket_num == 0) return 0;
+
+            usize last = 0;
+            for (usize i = 0; i < bucket_num; ++i) last = std::max<usize>(last, buckets[i]);
+            if (last < symbol_offset) return symbol_offset;
+
+            for (usize i = last - symbol_offset; i < chain_num; ++i) {
+                if ((chains[i] & 1u) != 0) return symbol_offset + i + 1;
+            }
+            return 0;
+        }
+
+        /// return the index of the symbol named `name`, 0 if there is none. See `HashTable::find`.
+        template<typename SymbolsT, typename StringsT>
+        usize find(const char *name, const SymbolsT &symbols, usize symbol_num, const StringsT &strings) const {
+            static constexpr u32 BITS = sizeof(USizeT) * 8;
+
+            if (bucket_num == 0) return 0;
+
+            u32 hash = gnu_hash(name);
+            USizeT word = bloom[(hash / BITS) % bloom_size];
+            USizeT mask = (static_cast<USizeT>(1) << (hash % BITS)) |
+                          (static_cast<USizeT>(1) << ((hash >> bloom_shift) % BITS));
+            if ((word & mask) != mask) return 0;
+
+            usize index = buckets[hash % bucket_num];
+            if (index < symbol_offset) return 0;
+
+            for (; index < symbol_num && index - symbol_offset < chain_num; ++index) {
+                u32 chain = chains[index - symbol_offset];
+                if ((chain | 1u) == (hash | 1u)) {
+                    const char *str = strings.get_str(symbols[index].name);
+                    if (str != nullptr && strcmp(str, name) == 0) return index;
+                }
+                if ((chain & 1u) != 0) break;
+            }
+
+            return 0;
+        }
+    };
+
+    template<typename USizeT>
+    class HashTableHeader : public SectionHeader<USizeT> {
+    public:
+        static constexpr u32 TYPE = SectionHeader<USizeT>::HASH_TABLE;
+        static constexpr usize ENTRY_SIZE = sizeof(u32);
+
+        using TableT = HashTable;
+
+        TableT get_table(MappedFileVisitor &visitor) {
+            return TableT{visitor.trusted_address(this->offset), this->size};
+        }
+    };
+
+    template<typename USizeT>
+    class GnuHashTableHeader : public SectionHeader<USizeT> {
+    public:
+        static constexpr u32 TYPE = SectionHeader<USizeT>::GNU_HASH;
+        static constexpr usize ENTRY_SIZE = 0;
+
+        using TableT = GnuHashTable<USizeT>;
+
+        TableT get_table(MappedFileVisitor &visitor) {
+            return TableT{visitor.trusted_address(this->offset), this->size};
+        }
+    };
+
     template<typename USizeT, typename EntryT>
     class _RelocationTableHeader : public SectionHeader<USizeT> {
     public:
@@ -323,10 +703,63 @@ namespace elf {
         static constexpr u32 TYPE = SectionHeader<USizeT>::RELOCATION_ADDEND_TABLE;
     };
 
+    /// packed relative relocations of SHT_RELR and DT_RELR, a sequence of USizeT words. An even word is the
+    /// address of one relocation and sets the base, an odd word is a bitmap whose bit i, for i from 1, relocates
+    /// the word at base + (i - 1) words, after which the base moves past the 8 * sizeof(USizeT) - 1 words the
+    /// bitmap covers.
+    template<typename USizeT>
+    class RelrTable {
+    private:
+        const USizeT *inner;
+        usize num;
+
+    public:
+        RelrTable(const void *inner, usize num) : inner{static_cast<const USizeT *>(inner)}, num{num} {}
+
+        /// number of words, not of relocations.
+        usize size() const { return num; }
+
+        /// call `f(address)` on every relocated address in order, one word at a time and without expanding the
+        /// table first.
+        template<typename F>
+        void for_each(F f) const {
+            USizeT base = 0;
+
+            for (usize i = 0; i < num; ++i) {
+                USizeT word = inner[i];
+
+                if ((word & 1u) == 0) {
+                    f(word);
+                    base = word + sizeof(USizeT);
+                    continue;
+                }
+
+                USizeT address = base;
+                for (word >>= 1u; word != 0; word >>= 1u, address += sizeof(USizeT)) {
+                    if ((word & 1u) != 0) f(address);
+                }
+                base += (8 * sizeof(USizeT) - 1) * sizeof(USizeT);
+            }
+        }
+    };
+
+    template<typename USizeT>
+    class RelrTableHeader : public SectionHeader<USizeT> {
+    public:
+        static constexpr u32 TYPE = SectionHeader<USizeT>::RELR_TABLE;
+        static constexpr usize ENTRY_SIZE = sizeof(USizeT);
+
+        using TableT = RelrTable<USizeT>;
+
+        TableT get_table(MappedFileVisitor &visitor) {
+            return TableT{visitor.trusted_address(this->offset), static_cast<usize>(this->size / sizeof(USizeT))};
+        }
+    };
+
     template<typename USizeT>
     class DynLinkingTableHeader : public SectionHeader<USizeT> {
     public:
-        elf_enum_display(DynLinkingTag, USizeT, 35,
+        elf_enum_display(DynLinkingTag, USizeT, 42,
                          DYNAMIC_LINK_NULL, 0,      /// Marks the end of the dynamic array
                          NEEDED, 1,                 /// The string table offset of the name of a needed library.
                          PLT_ENTRY_SIZE, 2,         /// Total size, in bytes, of the relocation entries associated
@@ -367,10 +800,18 @@ namespace elf {
                          TERMINATION_ARRAY, 26,     /// Pointer to an array of pointers to termination functions.
                          INITIALIZE_SIZE, 27,       /// Size, in bytes, of the array of initialization functions.
                          TERMINATION_SIZE, 28,      /// Size, in bytes, of the array of termination functions.
+                         RUNPATH, 29,               /// The string table offset of a library search path string,
+                                                    /// searched after LD_LIBRARY_PATH unlike RPATH.
+                         FLAGS, 30,                 /// DF_* flags of the object, DF_BIND_NOW among them.
                          PRE_INITIALIZE_ARRAY, 32,
                          PRE_INITIALIZE_SIZE, 33,
+                         RELR_SIZE, 35,             /// Total size, in bytes, of the packed relative relocations.
+                         RELR, 36,                  /// Address of the packed relative relocations.
+                         RELR_ENTRY_SIZE, 37,       /// Size, in bytes, of each packed relative relocation word.
                          GNU_HASH, 0x6ffffef5,
                          VER_SYM, 0x6ffffff0,
+                         RELA_COUNT, 0x6ffffff9,    /// Number of R_*_RELATIVE relocations at the start of DT_RELA.
+                         FLAGS_1, 0x6ffffffb,       /// DF_1_* flags of the object, DF_1_NOW among them.
                          VER_NEED, 0x6ffffffe,
                          VER_NEEDNUM, 0x6fffffff
         );
@@ -378,6 +819,12 @@ namespace elf {
         struct Entry {
             DynLinkingTag tag;
             USizeT val;
+
+            /// patch a field in place, see `ELFHeader::set`.
+            template<typename FieldT, typename ValueT>
+            bool set(MappedFileVisitor &visitor, FieldT Entry::*field, ValueT new_val) {
+                return visitor.write(&(this->*field), new_val);
+            }
         };
 
         static constexpr usize ENTRY_SIZE = sizeof(Entry);
@@ -396,7 +843,15 @@ namespace elf32 {
     using DynSymbolTableHeader = elf::DynSymbolTableHeader<elf::u32>;
     using RelocationTableHeader = elf::RelocationTableHeader<elf::u32>;
     using RelocationTableAddendHeader = elf::RelocationTableAddendHeader<elf::u32>;
+    using RelrTableHeader = elf::RelrTableHeader<elf::u32>;
     using DynLinkingTableHeader = elf::DynLinkingTableHeader<elf::u32>;
+    using NoteSectionHeader = elf::NoteSectionHeader<elf::u32>;
+    using HashTableHeader = elf::HashTableHeader<elf::u32>;
+    using GnuHashTableHeader = elf::GnuHashTableHeader<elf::u32>;
+    using SymbolTableIndexHeader = elf::SymbolTableIndexHeader<elf::u32>;
+    using VersionSymbolHeader = elf::VersionSymbolHeader<elf::u32>;
+    using VersionDefinitionHeader = elf::VersionDefinitionHeader<elf::u32>;
+    using VersionNeedHeader = elf::VersionNeedHeader<elf::u32>;
 }
 
 namespace elf64 {
@@ -406,7 +861,15 @@ namespace elf64 {
     using DynSymbolTableHeader = elf::DynSymbolTableHeader<elf::u64>;
     using RelocationTableHeader = elf::RelocationTableHeader<elf::u64>;
     using RelocationTableAddendHeader = elf::RelocationTableAddendHeader<elf::u64>;
+    using RelrTableHeader = elf::RelrTableHeader<elf::u64>;
     using DynLinkingTableHeader = elf::DynLinkingTableHeader<elf::u64>;
+    using NoteSectionHeader = elf::NoteSectionHeader<elf::u64>;
+    using HashTableHeader = elf::HashTableHeader<elf::u64>;
+    using GnuHashTableHeader = elf::GnuHashTableHeader<elf::u64>;
+    using SymbolTableIndexHeader = elf::SymbolTableIndexHeader<elf::u64>;
+    using VersionSymbolHeader = elf::VersionSymbolHeader<elf::u64>;
+    using VersionDefinitionHeader = elf::VersionDefinitionHeader<elf::u64>;
+    using VersionNeedHeader = elf::VersionNeedHeader<elf::u64>;
 }
 
 
@@ -0,0 +1,435 @@
+#ifndef ELF_SIZE_REPORT_HPP
+#define ELF_SIZE_REPORT_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+
+
+namespace elf {
+    /// attribution of every byte of the file and of the memory image to a PT_LOAD segment, a section and a
+    /// symbol, the way bloaty reports binary size. Each level is turned into a sorted list of disjoint intervals,
+    /// an earlier or larger interval winning an overlap, and the three lists are swept together once per domain.
+    ///
+    /// Bytes out of any PT_LOAD segment are "[unmapped]". Bytes out of any section are "[ELF header]",
+    /// "[program headers]" or "[section headers]" when they hold those tables, "[padding]" when the gap is smaller
+    /// than the alignment of what follows it, and "[unattributed]" otherwise. Bytes of a section out of any symbol
+    /// are "[no symbol]", such a node is only listed when the section has symbols.
+    class SizeReport {
+    public:
+        struct Node {
+            std::string name;
+            u64 file_size;
+            u64 vm_size;
+            std::vector<Node> children;
+        };
+
+    private:
+        static constexpr u32 NONE = ~static_cast<u32>(0);
+
+        /// pseudo sections, numbered past the real ones.
+        enum Pseudo : u32 {
+            ELF_HEADER,
+            PROGRAM_HEADERS,
+            SECTION_HEADERS,
+            PADDING,
+            UNATTRIBUTED,
+            PSEUDO_NUM
+        };
+
+        struct Interval {
+            u64 start;
+            u64 end;
+            u64 alignment;
+            u32 id;
+        };
+
+        struct Record {
+            u32 segment;
+            u32 section;
+            u32 symbol;
+            u64 file_size;
+            u64 vm_size;
+        };
+
+        struct Level {
+            const std::vector<Interval> &intervals;
+            usize index;
+
+            /// id of the interval covering `pos`, NONE in a gap, and the position where that changes.
+            u32 locate(u64 pos, u64 &next) {
+                while (index < intervals.size() && intervals[index].end <= pos) ++index;
+                if (index == intervals.size()) return NONE;
+
+                const Interval &interval = intervals[index];
+                if (interval.start <= pos) {
+                    next = std::min(next, interval.end);
+                    return interval.id;
+                }
+                next = std::min(next, interval.start);
+                return NONE;
+            }
+        };
+
+        /// sort by start, larger first, and clip every interval to the end of the previous one.
+        static void normalize(std::vector<Interval> &intervals) {
+            auto less = [](const Interval &a, const Interval &b) {
+                if (a.start != b.start) return a.start < b.start;
+                if (a.end != b.end) return a.end > b.end;
+                return a.id < b.id;
+            };
+            /// symbol tables are mostly in address order already.
+            if (!std::is_sorted(intervals.begin(), intervals.end(), less)) {
+                std::sort(intervals.begin(), intervals.end(), less);
+            }
+
+            usize num = 0;
+            for (usize i = 0; i < intervals.size(); ++i) {
+                Interval interval = intervals[i];
+                if (num > 0) interval.start = std::max(interval.start, intervals[num - 1].end);
+                if (interval.start >= interval.end) continue;
+                intervals[num++] = interval;
+            }
+            intervals.resize(num);
+        }
+
+        static void add(std::vector<Record> &records, u32 segment, u32 section, u32 symbol, u64 size, bool vm) {
+            if (!records.empty()) {
+                Record &last = records.back();
+                if (last.segment == segment && last.section == section && last.symbol == symbol) {
+                    (vm ? last.vm_size : last.file_size) += size;
+                    return;
+                }
+            }
+            records.push_back(Record{segment, section, symbol, vm ? 0 : size, vm ? size : 0});
+        }
+
+        /// attribute [begin, end), `vm` skips the bytes out of segments, which are not part of the memory image.
+        static void sweep(const std::vector<Interval> &segments, const std::vector<Interval> &sections,
+                          const std::vector<Interval> &symbols, u64 begin, u64 end, u32 section_num, bool vm,
+                          std::vector<Record> &records) {
+            Level segment_level{segments, 0}, section_level{sections, 0}, symbol_level{symbols, 0};
+
+            u64 pos = begin;
+            while (pos < end) {
+                u64 next = end;
+                u32 segment = segment_level.locate(pos, next);
+                if (segment == NONE && vm) {
+                    pos = next;
+                    continue;
+                }
+
+                u32 section = section_level.locate(pos, next);
+                u32 symbol = section == NONE ? NONE : symbol_level.locate(pos, next);
+
+                if (section == NONE) {
+                    usize index = section_level.index;
+                    u64 gap_start = index > 0 ? std::max(sections[index - 1].end, begin) : begin;
+                    bool padding = index < sections.size() &&
+                                   sections[index].start - gap_start < sections[index].alignment;
+                    section = section_num + (padding ? PADDING : UNATTRIBUTED);
+                }
+
+                add(records, segment, section, symbol, next - pos, vm);
+                pos = next;
+            }
+        }
+
+        /// largest first, down to `depth` levels.
+        static void sort_nodes(std::vector<Node> &nodes, usize depth) {
+            std::stable_sort(nodes.begin(), nodes.end(), [](const Node &a, const Node &b) {
+                return std::max(a.file_size, a.vm_size) > std::max(b.file_size, b.vm_size);
+            });
+            if (depth > 1) {
+                for (auto &node: nodes) sort_nodes(node.children, depth - 1);
+            }
+        }
+
+        static void write_json_string(std::ostream &stream, const std::string &str) {
+            stream << '"';
+            for (char c: str) {
+                if (c == '"' || c == '\\') {
+                    stream << '\\' << c;
+                } else if (static_cast<u8>(c) < 0x20) {
+                    const char *digits = "0123456789abcdef";
+                    stream << "\\u00" << digits[c >> 4] << digits[c & 0xf];
+                } else {
+                    stream << c;
+                }
+            }
+            stream << '"';
+        }
+
+    public:
+        /// build the report of `header`, `root` gets one child per segment, each with one child per section, each
+        /// with one child per symbol. Symbols are read from .symtab, or from .dynsym when the file is stripped.
+        /// Relocatable files have no memory image, all their vm sizes are 0.
+        template<typename USizeT>
+        static void build(ELFHeader<USizeT> *header, MappedFileVisitor &visitor, Node &root) {
+            using ELFHeaderT = ELFHeader<USizeT>;
+            using SectionHeaderT = SectionHeader<USizeT>;
+            using ProgramHeaderT = ProgramHeader<USizeT>;
+            using SymbolTableHeaderT = _SymbolTableHeader<USizeT>;
+
+            root = Node{"", 0, 0, {}};
+            u64 file_size = visitor.get_end();
+            u32 section_num = header->sections(visitor).size();
+            bool relocatable = header->file_type == ELFHeaderT::RELOCATABLE;
+            auto sections = header->sections(visitor);
+
+            std::vector<Interval> file_segments, vm_segments;
+            std::vector<const ProgramHeaderT *> loads;
+            for (auto &program: header->programs(visitor)) {
+                if (program.type != ProgramHeaderT::LOADABLE) continue;
+                auto id = static_cast<u32>(loads.size());
+                loads.push_back(&program);
+                file_segments.push_back(Interval{program.offset, program.offset + program.file_size, 1, id});
+                vm_segments.push_back(Interval{program.virtual_address, program.virtual_address + program.mem_size,
+                                               1, id});
+            }
+
+            std::vector<Interval> file_sections, vm_sections;
+            file_sections.push_back(Interval{0, header->elf_header_size, 1, section_num + ELF_HEADER});
+            file_sections.push_back(Interval{header->program_header_offset, header->program_header_offset +
+                    static_cast<u64>(header->program_header_num) * header->program_header_size, 8,
+                                             section_num + PROGRAM_HEADERS});
+            file_sections.push_back(Interval{header->section_header_offset, header->section_header_offset +
+                    static_cast<u64>(section_num) * header->section_header_size, 8, section_num + SECTION_HEADERS});
+
+            /// the headers loaded with a segment are part of the memory image too.
+            for (auto &interval: file_sections) {
+                for (auto *program: loads) {
+                    if (interval.start < program->offset || interval.end > program->offset + program->file_size) {
+                        continue;
+                    }
+                    u64 address = program->virtual_address + (interval.start - program->offset);
+                    vm_sections.push_back(Interval{address, address + (interval.end - interval.start),
+                                                   interval.alignment, interval.id});
+                    break;
+                }
+            }
+
+            for (u32 i = 0; i < section_num; ++i) {
+                auto &section = sections[i];
+                if (section.section_type == SectionHeaderT::SECTION_NULL) continue;
+                if (section.section_type != SectionHeaderT::NO_BITS) {
+                    file_sections.push_back(Interval{section.offset, section.offset + section.size,
+                                                     section.alignment, i});
+                }
+                if (!relocatable && section.is_allocate()) {
+                    vm_sections.push_back(Interval{section.address, section.address + section.size,
+                                                   section.alignment, i});
+                }
+            }
+
+            std::vector<Interval> file_symbols, vm_symbols;
+            std::vector<const char *> symbol_names;
+
+            u32 table_index = 0;
+            for (u32 i = 0; i < section_num; ++i) {
+                if (sections[i].section_type == SectionHeaderT::SYMBOL_TABLE) {
+                    table_index = i;
+                    break;
+                }
+                if (sections[i].section_type == SectionHeaderT::DYNAMIC_SYMBOL_TABLE && table_index == 0) {
+                    table_index = i;
+                }
+            }
+
+            SymbolTableHeaderT *table_header = nullptr;
+            StringTableHeader<USizeT> *string_header = nullptr;
+            if (table_index != 0) {
+                auto &table_section = sections[table_index];
+                if (table_section.section_type == SectionHeaderT::SYMBOL_TABLE) {
+                    table_header = SectionHeaderT::template cast<SymbolTableHeader<USizeT>>(&table_section, visitor);
+                } else {
+                    table_header = SectionHeaderT::template cast<DynSymbolTableHeader<USizeT>>(&table_section,
+                                                                                                visitor);
+                }
+                if (table_section.link < section_num) {
+                    string_header = SectionHeaderT::template cast<StringTableHeader<USizeT>>(
+                            &sections[table_section.link], visitor);
+                }
+            }
+
+            if (table_header != nullptr && string_header != nullptr) {
+                auto strings = string_header->get_table(visitor);
+
+                SymbolTableIndex section_indices{};
+                auto *index_header = header->get_symbol_table_index_header(table_index, visitor);
+                if (index_header != nullptr) section_indices = index_header->get_table(visitor);
+
+                usize index = 0;
+                for (auto &symbol: table_header->get_table(visitor)) {
+                    usize symbol_index = index++;
+                    if (symbol.size == 0) continue;
+                    auto type = symbol.get_type();
+                    if (type == SymbolTableHeaderT::SECTION || type == SymbolTableHeaderT::FILE) continue;
+                    if (symbol.section_header_index >= SectionHeaderT::INDEX_LOW_RESERVE &&
+                        symbol.section_header_index != SectionHeaderT::INDEX_EXTENDED) {
+                        continue;
+                    }
+
+                    u32 section_index = section_indices.get_section_index(symbol, symbol_index);
+                    if (section_index == SectionHeaderT::INDEX_UNDEFINED || section_index >= section_num) continue;
+
+                    const char *name = strings.get_str(symbol.name, nullptr);
+                    if (name == nullptr || name[0] == '\0') continue;
+
+                    auto &section = sections[section_index];
+                    u64 start = relocatable ? symbol.value : symbol.value - section.address;
+                    if (start > section.size || symbol.size > section.size - start) continue;
+
+                    auto id = static_cast<u32>(symbol_names.size());
+                    symbol_names.push_back(name);
+                    if (section.section_type != SectionHeaderT::NO_BITS) {
+                        file_symbols.push_back(Interval{section.offset + start, section.offset + start + symbol.size,
+                                                        1, id});
+                    }
+                    if (!relocatable && section.is_allocate()) {
+                        vm_symbols.push_back(Interval{symbol.value, symbol.value + symbol.size, 1, id});
+                    }
+                }
+            }
+
+            normalize(file_segments);
+            normalize(vm_segments);
+            normalize(file_sections);
+            normalize(vm_sections);
+            normalize(file_symbols);
+            normalize(vm_symbols);
+
+            std::vector<Record> records;
+            sweep(file_segments, file_sections, file_symbols, 0, file_size, section_num, false, records);
+            if (!vm_segments.empty()) {
+                sweep(vm_segments, vm_sections, vm_symbols, vm_segments.front().start, vm_segments.back().end,
+                      section_num, true, records);
+            }
+
+            const char *pseudo_names[PSEUDO_NUM] = {"[ELF header]", "[program headers]", "[section headers]",
+                                                    "[padding]", "[unattributed]"};
+            auto *names = section_num == 0 ? nullptr : header->get_section_string_table_header(visitor);
+
+            /// the records are grouped by hashing, there are few (segment, section) pairs, and the two records of a
+            /// symbol, one per domain, meet in `symbol_slots`. Symbols are sorted as plain leaves before they become
+            /// nodes, sorting millions of records or nodes costs more.
+            struct Leaf {
+                u32 symbol;
+                u64 file_size;
+                u64 vm_size;
+            };
+            struct Slot {
+                u32 section;
+                u32 leaf;
+            };
+            std::vector<Slot> symbol_slots(symbol_names.size(), Slot{NONE, NONE});
+            std::unordered_map<u64, u32> section_slots;
+            std::vector<std::pair<u32, u32>> section_places;
+            std::vector<std::vector<Leaf>> section_leaves;
+            auto unmapped = static_cast<u32>(loads.size());
+            root.children.resize(loads.size() + 1);
+
+            u64 last_key = ~static_cast<u64>(0);
+            u32 section_slot = NONE;
+            for (auto &record: records) {
+                u32 segment = record.segment == NONE ? unmapped : record.segment;
+                Node &segment_node = root.children[segment];
+
+                u64 key = static_cast<u64>(segment) << 32 | record.section;
+                if (key != last_key) {
+                    auto iter = section_slots.find(key);
+                    if (iter == section_slots.end()) {
+                        const char *name = nullptr;
+                        if (record.section >= section_num) {
+                            name = pseudo_names[record.section - section_num];
+                        } else if (names != nullptr) {
+                            name = names->get_table(visitor).get_str(sections[record.section].name, nullptr);
+                        }
+                        iter = section_slots.emplace(key, static_cast<u32>(section_leaves.size())).first;
+                        section_leaves.emplace_back();
+                        section_places.emplace_back(segment, static_cast<u32>(segment_node.children.size()));
+                        segment_node.children.push_back(Node{name == nullptr ? "[unnamed]" : name, 0, 0, {}});
+                    }
+                    last_key = key;
+                    section_slot = iter->second;
+                }
+
+                if (record.symbol != NONE) {
+                    std::vector<Leaf> &leaves = section_leaves[section_slot];
+                    Slot &slot = symbol_slots[record.symbol];
+                    if (slot.section != section_slot) {
+                        slot = Slot{section_slot, static_cast<u32>(leaves.size())};
+                        leaves.push_back(Leaf{record.symbol, 0, 0});
+                    }
+                    leaves[slot.leaf].file_size += record.file_size;
+                    leaves[slot.leaf].vm_size += record.vm_size;
+                }
+
+                Node &section_node = segment_node.children[section_places[section_slot].second];
+                section_node.file_size += record.file_size;
+                section_node.vm_size += record.vm_size;
+                segment_node.file_size += record.file_size;
+                segment_node.vm_size += record.vm_size;
+                root.file_size += record.file_size;
+                root.vm_size += record.vm_size;
+            }
+
+            /// bytes of a section out of any symbol, listed only next to symbols.
+            for (usize i = 0; i < section_leaves.size(); ++i) {
+                std::vector<Leaf> &leaves = section_leaves[i];
+                Node &section_node = root.children[section_places[i].first].children[section_places[i].second];
+                if (leaves.empty()) continue;
+
+                u64 file = section_node.file_size, vm = section_node.vm_size;
+                for (auto &leaf: leaves) {
+                    file -= leaf.file_size;
+                    vm -= leaf.vm_size;
+                }
+                if (file > 0 || vm > 0) leaves.push_back(Leaf{NONE, file, vm});
+
+                std::stable_sort(leaves.begin(), leaves.end(), [](const Leaf &a, const Leaf &b) {
+                    return std::max(a.file_size, a.vm_size) > std::max(b.file_size, b.vm_size);
+                });
+
+                section_node.children.reserve(leaves.size());
+                for (auto &leaf: leaves) {
+                    const char *name = leaf.symbol == NONE ? "[no symbol]" : symbol_names[leaf.symbol];
+                    section_node.children.push_back(Node{name, leaf.file_size, leaf.vm_size, {}});
+                }
+            }
+
+            for (u32 i = 0; i < loads.size(); ++i) {
+                const ProgramHeaderT &program = *loads[i];
+                root.children[i].name = "LOAD #" + std::to_string(i) + " [" + (program.is_read() ? "R" : "") +
+                                        (program.is_write() ? "W" : "") + (program.is_execute() ? "X" : "") + "]";
+            }
+            root.children[unmapped].name = "[unmapped]";
+            root.children.erase(std::remove_if(root.children.begin(), root.children.end(), [](const Node &node) {
+                return node.children.empty();
+            }), root.children.end());
+
+            sort_nodes(root.children, 2);
+        }
+
+        /// write `root` as nested {"name", "file_size", "vm_size", "children"} objects.
+        static void write_json(std::ostream &stream, const Node &node) {
+            stream << "{\"name\":";
+            write_json_string(stream, node.name);
+            stream << ",\"file_size\":" << node.file_size << ",\"vm_size\":" << node.vm_size << ",\"children\":[";
+            for (usize i = 0; i < node.children.size(); ++i) {
+                if (i > 0) stream << ',';
+                write_json(stream, node.children[i]);
+            }
+            stream << "]}";
+        }
+    };
+}
+
+
+#endif //ELF_SIZE_REPORT_HPP
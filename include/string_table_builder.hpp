@@ -0,0 +1,178 @@
+#ifndef ELF_STRING_TABLE_BUILDER_HPP
+#define ELF_STRING_TABLE_BUILDER_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "content_hash.hpp"
+
+
+namespace elf {
+    /// builds the content of a string table (.strtab, .dynstr, .shstrtab) from names added one at a time. Equal
+    /// names are stored once: they are copied into an arena and interned in an open addressing hash set keyed by
+    /// XXH3. `finalize` then merges tails, as lld does: a name that is a suffix of another, like `.text` of
+    /// `.rela.text`, points into the longer one. Names are sorted by their reversed characters with a multikey
+    /// quicksort, in descending order, which puts every name right after the names it is a suffix of, so one
+    /// pass over the sorted names finds all the suffixes.
+    class StringTableBuilder {
+    private:
+        struct Entry {
+            /// position of the name in `arena`, then its offset in the table.
+            u64 position;
+            u64 offset;
+            u32 size;
+            u32 hash;
+        };
+
+        /// an entry to sort, with the end of its name so that the sort reads nothing else.
+        struct Item {
+            const char *end;
+            u32 size;
+            u32 index;
+        };
+
+        static constexpr u32 EMPTY = 0;
+
+        std::vector<char> arena;
+        std::vector<Entry> entries;
+        /// index + 1 of an entry, or `EMPTY`, with linear probing.
+        std::vector<u32> slots;
+        std::vector<char> data;
+        bool finalized;
+
+        void grow() {
+            std::vector<u32> new_slots(slots.empty() ? 1024 : slots.size() * 2, u32{EMPTY});
+            usize mask = new_slots.size() - 1;
+
+            for (u32 i = 0; i < entries.size(); ++i) {
+                usize slot = entries[i].hash & mask;
+                while (new_slots[slot] != EMPTY) slot = (slot + 1) & mask;
+                new_slots[slot] = i + 1;
+            }
+            slots.swap(new_slots);
+        }
+
+        /// the character `depth` places from the end of the name of `item`, -1 past its start.
+        static int tail_at(const Item &item, usize depth) {
+            if (depth >= item.size) return -1;
+            return static_cast<u8>(item.end[-1 - static_cast<isize>(depth)]);
+        }
+
+        /// sort `items` in descending order of the reversed names, from the character `depth` places from the end.
+        /// Items in [0, greater) are above the pivot character, in [greater, less) equal to it.
+        static void sort(Item *items, usize num, usize depth) {
+            while (num > 1) {
+                std::swap(items[0], items[num / 2]);
+                int pivot = tail_at(items[0], depth);
+
+                usize greater = 0, less = num;
+                for (usize i = 1; i < less;) {
+                    int c = tail_at(items[i], depth);
+                    if (c > pivot) {
+                        std::swap(items[greater++], items[i++]);
+                    } else if (c < pivot) {
+                        std::swap(items[--less], items[i]);
+                    } else {
+                        ++i;
+                    }
+                }
+
+                sort(items, greater, depth);
+                sort(items + less, num - less, depth);
+                if (pivot == -1) return;
+
+                items += greater;
+                num = less - greater;
+                ++depth;
+            }
+        }
+
+    public:
+        StringTableBuilder() : finalized{false} {}
+
+        /// add `str` of `size` bytes, not containing zero, and return its id. Equal strings get the same id.
+        u32 add(const char *str, usize size) {
+            if (finalized) elf_unreachable("string added after finalize!");
+            if ((entries.size() + 1) * 2 > slots.size()) grow();
+
+            auto hash = static_cast<u32>(XXH3::hash(str, size));
+            usize mask = slots.size() - 1;
+            usize slot = hash & mask;
+
+            for (; slots[slot] != EMPTY; slot = (slot + 1) & mask) {
+                const Entry &entry = entries[slots[slot] - 1];
+                if (entry.hash == hash && entry.size == size && memcmp(&arena[entry.position], str, size) == 0) {
+                    return slots[slot] - 1;
+                }
+            }
+
+            entries.push_back(Entry{arena.size(), 0, static_cast<u32>(size), hash});
+            arena.insert(arena.end(), str, str + size);
+            slots[slot] = static_cast<u32>(entries.size());
+            return static_cast<u32>(entries.size() - 1);
+        }
+
+        u32 add(const char *str) { return add(str, strlen(str)); }
+
+        /// lay the table out, merging tails if `tail_merge`. The table starts with a zero byte, so that offset 0 is
+        /// the empty name, and no string can be added afterwards.
+        void finalize(bool tail_merge = true) {
+            finalized = true;
+            slots = std::vector<u32>{};
+            data.assign(1, '\0');
+
+            std::vector<Item> items(entries.size());
+            for (u32 i = 0; i < items.size(); ++i) {
+                items[i] = Item{arena.data() + entries[i].position + entries[i].size, entries[i].size, i};
+            }
+            if (tail_merge) sort(items.data(), items.size(), 0);
+
+            usize total = 1;
+            for (auto &entry: entries) total += entry.size + 1;
+            data.reserve(total);
+
+            const Entry *previous = nullptr;
+            for (auto &item: items) {
+                Entry &entry = entries[item.index];
+                if (entry.size == 0) {
+                    entry.offset = 0;
+                    continue;
+                }
+
+                if (tail_merge && previous != nullptr && previous->size >= entry.size &&
+                    memcmp(&arena[previous->position + previous->size - entry.size], &arena[entry.position],
+                           entry.size) == 0) {
+                    entry.offset = previous->offset + previous->size - entry.size;
+                    continue;
+                }
+
+                entry.offset = data.size();
+                data.insert(data.end(), arena.begin() + static_cast<isize>(entry.position),
+                            arena.begin() + static_cast<isize>(entry.position + entry.size));
+                data.push_back('\0');
+                previous = &entry;
+            }
+
+            arena = std::vector<char>{};
+        }
+
+        /// offset of string `id` in the table, for the name field of a symbol or a section. Valid after
+        /// `finalize`.
+        u64 get_offset(u32 id) const { return entries[id].offset; }
+
+        /// content of the table, valid after `finalize`.
+        const std::vector<char> &get_data() const { return data; }
+
+        usize size() const { return data.size(); }
+
+        /// number of distinct strings added.
+        usize string_num() const { return entries.size(); }
+    };
+}
+
+
+#endif //ELF_STRING_TABLE_BUILDER_HPP
@@ -0,0 +1,157 @@
+#ifndef ELF_SYMBOL_INDEX_HPP
+#define ELF_SYMBOL_INDEX_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "validated_elf.hpp"
+
+
+namespace elf {
+    /// address to symbol index, a flat array sorted by address. Addresses are stored as u64 so that one index
+    /// serves both ELF classes. Names are borrowed, the mapped file has to outlive the index.
+    class SymbolIndex {
+    public:
+        struct Symbol {
+            u64 address;
+            u64 size;
+            const char *name;
+        };
+
+    private:
+        static constexpr u32 NONE = ~static_cast<u32>(0);
+
+        std::vector<Symbol> symbols;
+        /// index of the innermost earlier sized symbol containing the address of each symbol, or `NONE`, so that an
+        /// address past the end of a nested symbol, like a sized local label, falls back to the enclosing function.
+        std::vector<u32> parents;
+
+        /// among symbols at the same address, prefer the one with a size, then the one added first.
+        static bool less(const Symbol &a, const Symbol &b) {
+            if (a.address != b.address) return a.address < b.address;
+            return a.size > b.size;
+        }
+
+    public:
+        void add(u64 address, u64 size, const char *name) { symbols.push_back(Symbol{address, size, name}); }
+
+        /// add the defined function and object symbols of every symbol table of `elf`.
+        template<typename USizeT>
+        void add_symbols(const ValidatedELF<USizeT> &elf) {
+            using SectionHeaderT = SectionHeader<USizeT>;
+            using SymbolTableHeaderT = _SymbolTableHeader<USizeT>;
+
+            for (auto &section: elf.sections()) {
+                if (section.section_type != SectionHeaderT::SYMBOL_TABLE &&
+                    section.section_type != SectionHeaderT::DYNAMIC_SYMBOL_TABLE)
+                    continue;
+
+                auto strings = elf.get_linked_string_table(section);
+
+                for (auto &symbol: elf.get_symbol_table(section)) {
+                    if (symbol.section_header_index == SectionHeaderT::INDEX_UNDEFINED ||
+                        symbol.section_header_index == SectionHeaderT::INDEX_ABSOLUTE ||
+                        symbol.section_header_index == SectionHeaderT::INDEX_COMMON)
+                        continue;
+                    if (symbol.name == 0) continue;
+
+                    auto type = symbol.get_type();
+                    if (type != SymbolTableHeaderT::FUNCTION && type != SymbolTableHeaderT::OBJECT) continue;
+
+                    add(symbol.value, symbol.size, strings.get_str(symbol.name));
+                }
+            }
+        }
+
+        /// sort the symbols and drop duplicates, must be called before `find`.
+        void build() {
+            std::stable_sort(symbols.begin(), symbols.end(), less);
+            symbols.erase(std::unique(symbols.begin(), symbols.end(), [](const Symbol &a, const Symbol &b) {
+                return a.address == b.address;
+            }), symbols.end());
+            symbols.shrink_to_fit();
+
+            /// the stack holds the chain of sized symbols containing the current address, innermost on top.
+            std::vector<u32> stack;
+            parents.assign(symbols.size(), u32{NONE});
+            for (u32 i = 0; i < symbols.size(); ++i) {
+                while (!stack.empty() && symbols[i].address - symbols[stack.back()].address >=
+                                         symbols[stack.back()].size) {
+                    stack.pop_back();
+                }
+                if (!stack.empty()) parents[i] = stack.back();
+                if (symbols[i].size != 0) stack.push_back(i);
+            }
+            parents.shrink_to_fit();
+        }
+
+        /// return the innermost symbol covering `address`, nullptr if there is none. A symbol without size is taken
+        /// to extend to the next symbol. Never allocates.
+        const Symbol *find(u64 address) const {
+            auto iter = std::upper_bound(symbols.begin(), symbols.end(), address, [](u64 val, const Symbol &symbol) {
+                return val < symbol.address;
+            });
+
+            if (iter == symbols.begin()) return nullptr;
+            auto index = static_cast<u32>(iter - symbols.begin() - 1);
+
+            while (symbols[index].size != 0 && address - symbols[index].address >= symbols[index].size) {
+                index = parents[index];
+                if (index == NONE) return nullptr;
+            }
+            return &symbols[index];
+        }
+
+        usize size() const { return symbols.size(); }
+
+        const Symbol *begin() const { return symbols.data(); }
+
+        const Symbol *end() const { return symbols.data() + symbols.size(); }
+    };
+
+    /// symbols made up for code that has none of its own, such as PLT stubs or functions found in .eh_frame. The
+    /// names are owned: they stay valid while this object lives, even when it is moved, so a `SymbolIndex` can
+    /// borrow them.
+    class SyntheticSymbols {
+    private:
+        std::vector<SymbolIndex::Symbol> symbols;
+        std::vector<char> names;
+        /// offsets of the names in `names`, to point the symbols at it again when it grows.
+        std::vector<usize> offsets;
+
+    public:
+        void clear() {
+            symbols.clear();
+            names.clear();
+            offsets.clear();
+        }
+
+        /// add a symbol named `name` followed by `suffix`, which are copied.
+        void add(u64 address, u64 size, const char *name, const char *suffix = "") {
+            usize name_size = strlen(name), suffix_size = strlen(suffix);
+            bool grow = names.size() + name_size + suffix_size + 1 > names.capacity();
+
+            offsets.push_back(names.size());
+            names.insert(names.end(), name, name + name_size);
+            names.insert(names.end(), suffix, suffix + suffix_size + 1);
+
+            if (grow) {
+                for (usize i = 0; i < symbols.size(); ++i) symbols[i].name = names.data() + offsets[i];
+            }
+            symbols.push_back(SymbolIndex::Symbol{address, size, names.data() + offsets.back()});
+        }
+
+        /// add the symbols to `index`, which borrows the names from this object.
+        void add_to(SymbolIndex &index) const {
+            for (auto &symbol: symbols) index.add(symbol.address, symbol.size, symbol.name);
+        }
+
+        const std::vector<SymbolIndex::Symbol> &get_symbols() const { return symbols; }
+    };
+}
+
+
+#endif //ELF_SYMBOL_INDEX_HPP
@@ -0,0 +1,182 @@
+#ifndef ELF_UNIT_INDEX_HPP
+#define ELF_UNIT_INDEX_HPP
+
+
+#include <algorithm>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "byte_reader.hpp"
+#include "dwarf.hpp"
+
+
+namespace elf {
+    /// which compilation unit covers an address, so that line tables and DIEs are only decoded for that unit.
+    /// Ranges come from .debug_aranges. Units it does not list, all of them when the linker or compiler left it
+    /// out as clang does by default, are read in parallel, but only their unit DIE: low_pc, high_pc and ranges.
+    /// The result is one flat array of disjoint intervals sorted by address.
+    class UnitIndex {
+    public:
+        struct Interval {
+            u64 begin;
+            u64 end;
+            /// index in `get_units`.
+            u32 unit;
+        };
+
+        struct Stats {
+            usize aranges_unit_num;
+            usize scanned_unit_num;
+        };
+
+    private:
+        /// compile and partial units, in the order of .debug_info. Their bases are not read.
+        std::vector<DWARF::Unit> units;
+        std::vector<Interval> intervals;
+        Stats stats;
+
+        static u32 find_unit(const std::vector<DWARF::Unit> &units, u64 offset) {
+            auto iter = std::lower_bound(units.begin(), units.end(), offset, [](const DWARF::Unit &unit, u64 val) {
+                return unit.offset < val;
+            });
+            return iter != units.end() && iter->offset == offset ? static_cast<u32>(iter - units.begin()) :
+                   static_cast<u32>(units.size());
+        }
+
+        /// add the ranges of every set of .debug_aranges, marking their units as covered.
+        void read_aranges(const DWARF &dwarf, std::vector<bool> &covered) {
+            ByteReader reader{dwarf.aranges.data, dwarf.aranges.size};
+
+            while (reader.remain() >= 4) {
+                usize set = reader.get_position();
+                usize offset_size = 4;
+                u64 length = reader.read<u32>();
+                if (length == 0xffffffffu) {
+                    offset_size = 8;
+                    length = reader.read<u64>();
+                }
+                if (!reader.is_valid() || length > reader.remain()) break;
+                usize next = reader.get_position() + static_cast<usize>(length);
+
+                u16 version = reader.read<u16>();
+                u64 unit_offset = reader.read_unsigned(offset_size);
+                u8 address_size = reader.read<u8>();
+                u8 segment_size = reader.read<u8>();
+                u32 unit = find_unit(units, unit_offset);
+
+                if (reader.is_valid() && version == 2 && (address_size == 4 || address_size == 8) &&
+                    unit < units.size()) {
+                    /// tuples are aligned to their size from the start of the set.
+                    usize tuple_size = segment_size + 2 * address_size;
+                    reader.seek(set + (reader.get_position() - set + tuple_size - 1) / tuple_size * tuple_size);
+
+                    while (reader.get_position() + tuple_size <= next) {
+                        reader.skip(segment_size);
+                        u64 begin = reader.read_unsigned(address_size), size = reader.read_unsigned(address_size);
+                        if (begin == 0 && size == 0) break;
+                        if (size != 0) intervals.push_back(Interval{begin, begin + size, unit});
+                    }
+                    if (!covered[unit]) ++stats.aranges_unit_num;
+                    covered[unit] = true;
+                }
+
+                reader.seek(next);
+            }
+        }
+
+        /// read the unit DIEs of `todo` from several threads.
+        void scan_units(const DWARF &dwarf, const std::vector<u32> &todo, usize thread_num) {
+            /// a unit DIE takes about a microsecond, a thread is only worth it for a few hundred of them.
+            thread_num = thread_count(thread_num, todo.size() / 256);
+
+            std::vector<std::vector<Interval>> found(thread_num);
+            /// the abbreviation table last parsed by each thread, units of a file mostly share one.
+            std::vector<DWARF::AbbrevTable> tables(thread_num);
+            std::vector<u64> abbrev_offsets(thread_num, ~static_cast<u64>(0));
+
+            parallel_for(todo.size(), thread_num, [&](usize index, usize thread) {
+                u32 unit_index = todo[index];
+                DWARF::Unit unit = units[unit_index];
+                if (unit.abbrev_offset != abbrev_offsets[thread]) {
+                    abbrev_offsets[thread] = unit.abbrev_offset;
+                    if (!tables[thread].parse(dwarf.abbrev, unit.abbrev_offset)) {
+                        abbrev_offsets[thread] = ~static_cast<u64>(0);
+                    }
+                }
+
+                DWARF::PCAttributes pc{};
+                if (!dwarf.read_root(unit, tables[thread], pc, [](u16, const DWARF::Value &) {})) return;
+                dwarf.for_each_range(unit, pc, [&](u64 begin, u64 end) {
+                    found[thread].push_back(Interval{begin, end, unit_index});
+                });
+            });
+
+            for (auto &part: found) intervals.insert(intervals.end(), part.begin(), part.end());
+        }
+
+    public:
+        UnitIndex() : stats{} {}
+
+        /// index the units of `dwarf`, replacing any previous content. 0 threads means one per hardware thread.
+        void build(const DWARF &dwarf, usize thread_num = 0) {
+            units.clear();
+            intervals.clear();
+            stats = Stats{};
+
+            DWARF::Unit unit{};
+            for (u64 offset = 0; dwarf.read_unit(offset, unit); offset = unit.end) {
+                if (unit.unit_type == DWARF::UNIT_COMPILE || unit.unit_type == DWARF::UNIT_PARTIAL) {
+                    units.push_back(unit);
+                }
+            }
+
+            std::vector<bool> covered(units.size(), false);
+            read_aranges(dwarf, covered);
+
+            std::vector<u32> todo;
+            for (u32 i = 0; i < units.size(); ++i) {
+                if (!covered[i]) todo.push_back(i);
+            }
+            stats.scanned_unit_num = todo.size();
+            if (!todo.empty()) scan_units(dwarf, todo, thread_num);
+
+            /// overlapping ranges, from sloppy aranges or identical code folding, go to the unit seen first.
+            std::stable_sort(intervals.begin(), intervals.end(), [](const Interval &lhs, const Interval &rhs) {
+                return lhs.begin < rhs.begin;
+            });
+            usize size = 0;
+            for (auto &interval: intervals) {
+                Interval current = interval;
+                if (size > 0 && current.begin < intervals[size - 1].end) current.begin = intervals[size - 1].end;
+                if (current.begin >= current.end) continue;
+
+                if (size > 0 && intervals[size - 1].end == current.begin && intervals[size - 1].unit == current.unit) {
+                    intervals[size - 1].end = current.end;
+                } else {
+                    intervals[size++] = current;
+                }
+            }
+            intervals.resize(size);
+            intervals.shrink_to_fit();
+        }
+
+        /// the unit covering `address`, nullptr if none does.
+        const DWARF::Unit *find(u64 address) const {
+            auto iter = std::upper_bound(intervals.begin(), intervals.end(), address, [](u64 val,
+                                                                                        const Interval &interval) {
+                return val < interval.begin;
+            });
+            if (iter == intervals.begin() || address >= (--iter)->end) return nullptr;
+            return &units[iter->unit];
+        }
+
+        const std::vector<DWARF::Unit> &get_units() const { return units; }
+
+        const std::vector<Interval> &get_intervals() const { return intervals; }
+
+        const Stats &get_stats() const { return stats; }
+    };
+}
+
+
+#endif //ELF_UNIT_INDEX_HPP
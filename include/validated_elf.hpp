@@ -0,0 +1,362 @@
+#ifndef ELF_VALIDATED_ELF_HPP
+#define ELF_VALIDATED_ELF_HPP
+
+
+#include <cstring>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+
+
+namespace elf {
+    /// table whose extent and entry size have been checked, indexing does not check boundary.
+    template<typename EntryT>
+    class TrustedTable {
+    private:
+        u8 *inner;
+        usize entry_size;
+        usize num;
+
+    public:
+        using Iter = ArrayIterator<EntryT>;
+
+        TrustedTable(void *inner, usize entry_size, usize num) :
+                inner{static_cast<u8 *>(inner)}, entry_size{entry_size}, num{num} {}
+
+        Iter begin() const { return Iter{reinterpret_cast<EntryT *>(inner), entry_size}; }
+
+        Iter end() const { return Iter{reinterpret_cast<EntryT *>(inner + entry_size * num), entry_size}; }
+
+        EntryT &operator[](usize index) const { return *reinterpret_cast<EntryT *>(inner + entry_size * index); }
+
+        usize size() const { return num; }
+    };
+
+    /// string table known to end with a zero, and every index handed out by a validated table is known to be in
+    /// range, so a lookup is a single pointer add.
+    class TrustedStringTable {
+    private:
+        const char *inner;
+
+    public:
+        explicit TrustedStringTable(const char *inner) : inner{inner} {}
+
+        const char *get_str(usize index, const char *no_name = "") const {
+            return index == 0 ? no_name : inner + index;
+        }
+    };
+
+    /// view of an ELF file checked once by `validate`. Everything reachable through the accessors below (headers,
+    /// table extents, entry sizes, section links, name indices, symbol indices of relocations and string table
+    /// termination) has been verified, so the accessors carry no checks. The mapped file must outlive this view.
+    template<typename USizeT>
+    class ValidatedELF {
+    public:
+        using ELFHeaderT = ELFHeader<USizeT>;
+        using SectionHeaderT = SectionHeader<USizeT>;
+        using ProgramHeaderT = ProgramHeader<USizeT>;
+        using SymbolTableEntryT = typename _SymbolTableHeader<USizeT>::SymbolTableEntry;
+        using DynEntryT = typename DynLinkingTableHeader<USizeT>::Entry;
+
+    private:
+        MappedFileVisitor *visitor;
+        ELFHeaderT *header;
+        /// resolved through section 0 with extended section numbering.
+        usize section_num;
+        usize section_name_index;
+
+        ValidatedELF(MappedFileVisitor *visitor, ELFHeaderT *header) :
+                visitor{visitor}, header{header}, section_num{header->get_section_num(*visitor)},
+                section_name_index{header->get_section_string_table_index(*visitor)} {}
+
+        static bool check_table(const SectionHeaderT &section, usize entry_size) {
+            return section.entry_size >= entry_size && section.size % section.entry_size == 0;
+        }
+
+        static bool check_link(const SectionHeaderT &section, TrustedTable<SectionHeaderT> sections, u32 type) {
+            return section.link < sections.size() && sections[section.link].section_type == type;
+        }
+
+        static bool check_string_table(MappedFileVisitor &visitor, const SectionHeaderT &section) {
+            if (section.size == 0) return true;
+            return *static_cast<char *>(visitor.trusted_address(section.offset + section.size - 1)) == '\0';
+        }
+
+        static bool check_symbol_table(MappedFileVisitor &visitor, const SectionHeaderT &section,
+                                       TrustedTable<SectionHeaderT> sections) {
+            if (!check_table(section, sizeof(SymbolTableEntryT))) return false;
+            if (!check_link(section, sections, SectionHeaderT::STRING_TABLE)) return false;
+
+            USizeT string_size = sections[section.link].size;
+            TrustedTable<SymbolTableEntryT> symbols{visitor.trusted_address(section.offset), section.entry_size,
+                                                    section.size / section.entry_size};
+            bool extended = false;
+
+            for (auto &symbol: symbols) {
+                if (symbol.name != 0 && symbol.name >= string_size) return false;
+                if (symbol.section_header_index >= sections.size() &&
+                    symbol.section_header_index < SectionHeaderT::INDEX_LOW_RESERVE)
+                    return false;
+                if (symbol.section_header_index == SectionHeaderT::INDEX_EXTENDED) extended = true;
+            }
+
+            /// the indices themselves are checked with the SHT_SYMTAB_SHNDX section.
+            return !extended || find_symbol_table_index(&section, sections) != nullptr;
+        }
+
+        static const SectionHeaderT *find_symbol_table_index(const SectionHeaderT *symbol_table,
+                                                             TrustedTable<SectionHeaderT> sections) {
+            for (auto &section: sections) {
+                if (section.section_type == SectionHeaderT::SYMBOL_TABLE_INDEX && section.link < sections.size() &&
+                    &sections[section.link] == symbol_table)
+                    return &section;
+            }
+            return nullptr;
+        }
+
+        static bool check_symbol_table_index(MappedFileVisitor &visitor, const SectionHeaderT &section,
+                                             TrustedTable<SectionHeaderT> sections) {
+            if (!check_table(section, sizeof(u32)) || section.entry_size != sizeof(u32)) return false;
+            if (!check_link(section, sections, SectionHeaderT::SYMBOL_TABLE)) return false;
+
+            /// the symbol table may come later in the sweep, check its entry size before dividing by it.
+            const SectionHeaderT &symbol_table = sections[section.link];
+            if (!check_table(symbol_table, sizeof(SymbolTableEntryT))) return false;
+            if (section.size / sizeof(u32) != symbol_table.size / symbol_table.entry_size) return false;
+
+            auto *indices = static_cast<const u32 *>(visitor.trusted_address(section.offset));
+            for (usize i = 0; i < section.size / sizeof(u32); ++i) {
+                if (indices[i] >= sections.size()) return false;
+            }
+
+            return true;
+        }
+
+        template<typename EntryT>
+        static bool check_relocation_table(MappedFileVisitor &visitor, SectionHeaderT &section,
+                                           TrustedTable<SectionHeaderT> sections) {
+            if (!check_table(section, sizeof(EntryT))) return false;
+
+            /// relocations without an associated symbol table must not refer to any symbol.
+            usize symbol_num = 0;
+            if (section.link != 0) {
+                if (section.link >= sections.size()) return false;
+                const SectionHeaderT &symbol_table = sections[section.link];
+                if (symbol_table.section_type != SectionHeaderT::SYMBOL_TABLE &&
+                    symbol_table.section_type != SectionHeaderT::DYNAMIC_SYMBOL_TABLE)
+                    return false;
+                if (!check_table(symbol_table, sizeof(SymbolTableEntryT))) return false;
+                symbol_num = symbol_table.size / symbol_table.entry_size;
+            }
+
+            TrustedTable<EntryT> relocations{visitor.trusted_address(section.offset), section.entry_size,
+                                             section.size / section.entry_size};
+
+            for (auto &relocation: relocations) {
+                usize symbol = relocation.get_symbol();
+                if (symbol != 0 && symbol >= symbol_num) return false;
+            }
+
+            return true;
+        }
+
+        static bool check_dynamic_table(MappedFileVisitor &visitor, const SectionHeaderT &section,
+                                        TrustedTable<SectionHeaderT> sections) {
+            using DynLinkingTableHeaderT = DynLinkingTableHeader<USizeT>;
+
+            if (!check_table(section, sizeof(DynEntryT))) return false;
+            if (!check_link(section, sections, SectionHeaderT::STRING_TABLE)) return false;
+
+            USizeT string_size = sections[section.link].size;
+            TrustedTable<DynEntryT> entries{visitor.trusted_address(section.offset), section.entry_size,
+                                            section.size / section.entry_size};
+
+            for (auto &entry: entries) {
+                switch (entry.tag) {
+                    case DynLinkingTableHeaderT::NEEDED:
+                    case DynLinkingTableHeaderT::SONAME:
+                    case DynLinkingTableHeaderT::RPATH:
+                    case DynLinkingTableHeaderT::RUNPATH:
+                        if (entry.val >= string_size) return false;
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            return true;
+        }
+
+        static bool check_section(MappedFileVisitor &visitor, SectionHeaderT &section,
+                                  TrustedTable<SectionHeaderT> sections) {
+            switch (section.section_type) {
+                case SectionHeaderT::STRING_TABLE:
+                    return check_string_table(visitor, section);
+                case SectionHeaderT::SYMBOL_TABLE:
+                case SectionHeaderT::DYNAMIC_SYMBOL_TABLE:
+                    return check_symbol_table(visitor, section, sections);
+                case SectionHeaderT::RELOCATION_TABLE:
+                    return check_relocation_table<RelocationEntry<USizeT>>(visitor, section, sections);
+                case SectionHeaderT::RELOCATION_ADDEND_TABLE:
+                    return check_relocation_table<RelocationAddendEntry<USizeT>>(visitor, section, sections);
+                case SectionHeaderT::DYNAMIC_LINKING_TABLE:
+                    return check_dynamic_table(visitor, section, sections);
+                case SectionHeaderT::HASH_TABLE:
+                    return check_table(section, sizeof(u32)) &&
+                           check_link(section, sections, SectionHeaderT::DYNAMIC_SYMBOL_TABLE);
+                case SectionHeaderT::SYMBOL_TABLE_INDEX:
+                    return check_symbol_table_index(visitor, section, sections);
+                case SectionHeaderT::RELR_TABLE:
+                    return check_table(section, sizeof(USizeT)) && section.entry_size == sizeof(USizeT);
+                default:
+                    return true;
+            }
+        }
+
+    public:
+        ValidatedELF() : visitor{nullptr}, header{nullptr}, section_num{0}, section_name_index{0} {}
+
+        /// checks everything in one sweep, return an invalid view (`is_valid() == false`) on any failure.
+        static ValidatedELF validate(MappedFileVisitor &visitor) {
+            ELFHeaderT *header = ELFHeaderT::read(visitor);
+            if (header == nullptr) return ValidatedELF{};
+
+            if (header->elf_class != (sizeof(USizeT) == 8 ? ELFHeaderT::ELF64 : ELFHeaderT::ELF32)) {
+                return ValidatedELF{};
+            }
+            if (header->data_encoding != (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ?
+                                          ELFHeaderT::DATA_LITTLE_ENDIAN : ELFHeaderT::DATA_BIG_ENDIAN)) {
+                return ValidatedELF{};
+            }
+
+            ValidatedELF self{&visitor, header};
+
+            for (auto &program: self.programs()) {
+                if (program.type == ProgramHeaderT::PROGRAM_NULL) continue;
+                if (!visitor.check_address(program.offset, program.file_size)) return ValidatedELF{};
+                if (program.type == ProgramHeaderT::LOADABLE && program.file_size > program.mem_size) {
+                    return ValidatedELF{};
+                }
+            }
+
+            auto sections = self.sections();
+
+            for (auto &section: sections) {
+                if (section.section_type == SectionHeaderT::SECTION_NULL) continue;
+                if (section.section_type == SectionHeaderT::NO_BITS) continue;
+                if (!visitor.check_address(section.offset, section.size)) return ValidatedELF{};
+            }
+
+            /// section names, every name must be zero if there is no section name string table.
+            USizeT name_size = 0;
+            if (self.section_name_index != 0) {
+                if (self.section_name_index >= sections.size()) return ValidatedELF{};
+                SectionHeaderT &names = sections[self.section_name_index];
+                if (names.section_type != SectionHeaderT::STRING_TABLE) return ValidatedELF{};
+                name_size = names.size;
+            }
+
+            for (auto &section: sections) {
+                if (section.name != 0 && section.name >= name_size) return ValidatedELF{};
+                if (section.section_type == SectionHeaderT::NO_BITS) continue;
+                if (!check_section(visitor, section, sections)) return ValidatedELF{};
+            }
+
+            return self;
+        }
+
+        bool is_valid() const { return header != nullptr; }
+
+        ELFHeaderT &get_header() const { return *header; }
+
+        MappedFileVisitor &get_visitor() const { return *visitor; }
+
+        TrustedTable<ProgramHeaderT> programs() const {
+            return TrustedTable<ProgramHeaderT>{visitor->trusted_address(header->program_header_offset),
+                                                header->program_header_size, header->program_header_num};
+        }
+
+        TrustedTable<SectionHeaderT> sections() const {
+            return TrustedTable<SectionHeaderT>{visitor->trusted_address(header->section_header_offset),
+                                                header->section_header_size, section_num};
+        }
+
+        /// content of a section, not meaningful for NO_BITS sections.
+        u8 *get_content(const SectionHeaderT &section) const {
+            return static_cast<u8 *>(visitor->trusted_address(section.offset));
+        }
+
+        u8 *get_content(const ProgramHeaderT &program) const {
+            return static_cast<u8 *>(visitor->trusted_address(program.offset));
+        }
+
+        /// `section` must be a string table.
+        TrustedStringTable get_string_table(const SectionHeaderT &section) const {
+            return TrustedStringTable{reinterpret_cast<const char *>(get_content(section))};
+        }
+
+        TrustedStringTable get_section_string_table() const {
+            /// with no section name string table every name is zero and never dereferenced.
+            if (section_name_index == 0) return TrustedStringTable{nullptr};
+            return get_string_table(sections()[section_name_index]);
+        }
+
+        const char *get_section_name(const SectionHeaderT &section) const {
+            return get_section_string_table().get_str(section.name);
+        }
+
+        /// `section` must be a section of fixed size entries checked above, e.g. a symbol, relocation, dynamic,
+        /// hash or section index table.
+        template<typename EntryT>
+        TrustedTable<EntryT> get_entries(const SectionHeaderT &section) const {
+            return TrustedTable<EntryT>{get_content(section), section.entry_size, section.size / section.entry_size};
+        }
+
+        /// `section` must be a symbol table.
+        TrustedTable<SymbolTableEntryT> get_symbol_table(const SectionHeaderT &section) const {
+            return get_entries<SymbolTableEntryT>(section);
+        }
+
+        /// the SHT_SYMTAB_SHNDX table in parallel to the symbol table `section`, empty if it has none.
+        SymbolTableIndex get_symbol_table_index(const SectionHeaderT &section) const {
+            const SectionHeaderT *index = find_symbol_table_index(&section, sections());
+            if (index == nullptr) return SymbolTableIndex{};
+            return SymbolTableIndex{get_content(*index), static_cast<usize>(index->size / sizeof(u32))};
+        }
+
+        /// `section` must be a symbol table or a dynamic linking table.
+        TrustedStringTable get_linked_string_table(const SectionHeaderT &section) const {
+            return get_string_table(sections()[section.link]);
+        }
+
+        /// return nullptr if no section or more than one section has the name, or the type does not match.
+        template<typename SectionT>
+        SectionT *get_section_header(const char *section_name) const {
+            auto names = get_section_string_table();
+            SectionHeaderT *found = nullptr;
+
+            for (auto &section: sections()) {
+                if (strcmp(names.get_str(section.name), section_name) != 0) continue;
+                if (found != nullptr) return nullptr;
+                found = &section;
+            }
+
+            if (found == nullptr || found->section_type != SectionT::TYPE) return nullptr;
+            return static_cast<SectionT *>(found);
+        }
+    };
+
+    template<typename USizeT>
+    ValidatedELF<USizeT> validate(MappedFileVisitor &visitor) { return ValidatedELF<USizeT>::validate(visitor); }
+}
+
+namespace elf32 {
+    using ValidatedELF = elf::ValidatedELF<elf::u32>;
+}
+
+namespace elf64 {
+    using ValidatedELF = elf::ValidatedELF<elf::u64>;
+}
+
+
+#endif //ELF_VALIDATED_ELF_HPP
@@ -0,0 +1,211 @@
+#ifndef ELF_WINDOWED_FILE_HPP
+#define ELF_WINDOWED_FILE_HPP
+
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "elf_utility.hpp"
+#include "elf_header.hpp"
+
+
+namespace elf {
+    /// file visitor for files too large to be mapped at once, such as multi-GB core or debug files on 32-bit hosts.
+    /// The file is mapped in windows of `window_size` bytes on demand, at most `window_num` of them live at a time
+    /// and the least recently used one is unmapped first. The first window, which holds the ELF header, is never
+    /// unmapped.
+    ///
+    /// `view` hands out a `MappedFileVisitor` covering a whole range, a range straddling window boundaries gets a
+    /// wider window, so `ELFHeader` and the table views are used on it unchanged with file offsets, e.g.
+    /// `header->sections(*file.view(header->section_header_offset, ...))`. A view and the pointers obtained from it
+    /// stay valid until `window_num` other windows have been mapped. With extended section numbering, the view of
+    /// the section header table covers section 0 which holds the section number.
+    class WindowedFileVisitor {
+    public:
+        static constexpr usize DEFAULT_WINDOW_SIZE = 16 * 1024 * 1024;
+        static constexpr usize DEFAULT_WINDOW_NUM = 8;
+
+    private:
+        struct Window {
+            MappedFileVisitor visitor;
+            u64 last_use;
+        };
+
+        int fd;
+        u64 size;
+        usize window_size;
+        Window head;
+        std::vector<Window> windows;
+        Window *current;
+        u64 clock;
+        usize map_num;
+
+        static bool contains(const MappedFileVisitor &visitor, u64 offset, u64 len) {
+            return visitor.get_size() > 0 && visitor.check_address(offset, len);
+        }
+
+        bool map(Window &window, u64 offset, u64 len) {
+            u64 start = offset / window_size * window_size;
+            u64 end = (offset + len + window_size - 1) / window_size * window_size;
+            if (end > size) end = size;
+            if (end - start > static_cast<usize>(-1)) {
+                elf_warn("range too large to be mapped!");
+                return false;
+            }
+
+            window.visitor = MappedFileVisitor::map_range(fd, start, end - start);
+            window.last_use = ++clock;
+            ++map_num;
+            return window.visitor.get_size() > 0;
+        }
+
+        void release() {
+            if (fd != -1) close(fd);
+        }
+
+    public:
+        static WindowedFileVisitor open_elf(int fd, usize window_size = DEFAULT_WINDOW_SIZE,
+                                            usize window_num = DEFAULT_WINDOW_NUM) {
+            WindowedFileVisitor file{};
+            file.fd = fd;
+
+            struct stat file_stat{};
+            if (fd == -1 || fstat(fd, &file_stat) != 0) {
+                elf_warn("fstat failed!");
+                return file;
+            }
+
+            usize page_size = sysconf(_SC_PAGESIZE);
+            file.size = file_stat.st_size;
+            file.window_size = std::max<usize>(page_size, window_size / page_size * page_size);
+            file.windows.resize(std::max<usize>(window_num, 1));
+            if (file.size > 0) file.map(file.head, 0, 1);
+
+            return file;
+        }
+
+        static WindowedFileVisitor open_elf(const char *name, usize window_size = DEFAULT_WINDOW_SIZE,
+                                            usize window_num = DEFAULT_WINDOW_NUM) {
+            return open_elf(::open(name, O_RDONLY | O_CLOEXEC), window_size, window_num);
+        }
+
+        WindowedFileVisitor() : fd{-1}, size{0}, window_size{0}, head{}, windows{}, current{nullptr}, clock{0},
+                                map_num{0} {}
+
+        WindowedFileVisitor(WindowedFileVisitor &&other) noexcept:
+                fd{other.fd}, size{other.size}, window_size{other.window_size}, head{std::move(other.head)},
+                windows{std::move(other.windows)}, current{nullptr}, clock{other.clock}, map_num{other.map_num} {
+            other.fd = -1;
+            other.current = nullptr;
+        }
+
+        WindowedFileVisitor &operator=(WindowedFileVisitor &&other) noexcept {
+            if (this != &other) {
+                release();
+
+                fd = other.fd;
+                size = other.size;
+                window_size = other.window_size;
+                head = std::move(other.head);
+                windows = std::move(other.windows);
+                current = nullptr;
+                clock = other.clock;
+                map_num = other.map_num;
+
+                other.fd = -1;
+                other.current = nullptr;
+            }
+
+            return *this;
+        }
+
+        WindowedFileVisitor(const WindowedFileVisitor &other) = delete;
+
+        WindowedFileVisitor &operator=(const WindowedFileVisitor &other) = delete;
+
+        ~WindowedFileVisitor() { release(); }
+
+        /// return a visitor mapping at least [offset, offset + len), nullptr if the range is out of the file or
+        /// cannot be mapped.
+        MappedFileVisitor *view(u64 offset, u64 len) {
+            if (current != nullptr && contains(current->visitor, offset, len)) {
+                current->last_use = ++clock;
+                return &current->visitor;
+            }
+
+            if (len > size || offset > size - len) return nullptr;
+            if (contains(head.visitor, offset, len)) return &head.visitor;
+
+            Window *victim = &windows[0];
+            for (auto &window: windows) {
+                if (contains(window.visitor, offset, len)) {
+                    window.last_use = ++clock;
+                    current = &window;
+                    return &window.visitor;
+                }
+                if (window.last_use < victim->last_use) victim = &window;
+            }
+
+            current = nullptr;
+            if (!map(*victim, offset, len)) return nullptr;
+            current = victim;
+            return &victim->visitor;
+        }
+
+        /// return the `len` bytes at `offset`, nullptr if they are out of the file.
+        const void *address(u64 offset, u64 len) {
+            MappedFileVisitor *visitor = view(offset, len);
+            return visitor == nullptr ? nullptr : visitor->trusted_address(offset);
+        }
+
+        /// copy `len` bytes at `offset` window by window, never mapping more than `window_size` bytes for it. Return
+        /// false if they are out of the file.
+        bool read(u64 offset, void *buffer, usize len) {
+            u8 *out = static_cast<u8 *>(buffer);
+
+            while (len > 0) {
+                usize num = std::min<u64>(len, window_size - offset % window_size);
+                const void *ptr = address(offset, num);
+                if (ptr == nullptr) return false;
+
+                memcpy(out, ptr, num);
+                out += num;
+                offset += num;
+                len -= num;
+            }
+
+            return true;
+        }
+
+        /// read and check the ELF header, which stays mapped as long as the visitor. Return nullptr if the file is
+        /// not an ELF file of the class of `USizeT`.
+        template<typename USizeT>
+        ELFHeader<USizeT> *read_header() {
+            if (get_elf_class(head.visitor) != (sizeof(USizeT) == 8 ? 2 : 1)) return nullptr;
+
+            auto *header = static_cast<ELFHeader<USizeT> *>(head.visitor.address(0, sizeof(ELFHeader<USizeT>)));
+            if (header == nullptr || !header->check(size)) return nullptr;
+
+            if (header->is_extended()) {
+                auto *first = static_cast<const SectionHeader<USizeT> *>(
+                        address(header->section_header_offset, sizeof(SectionHeader<USizeT>)));
+                if (first == nullptr || !header->check_extended(*first, size)) return nullptr;
+            }
+
+            return header;
+        }
+
+        int get_fd() const { return fd; }
+
+        u64 get_size() const { return size; }
+
+        usize get_window_size() const { return window_size; }
+
+        /// number of windows mapped so far, the first one included.
+        usize get_map_num() const { return map_num; }
+    };
+}
+
+
+#endif //ELF_WINDOWED_FILE_HPP
@@ -0,0 +1,80 @@
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+
+#include "archive.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    const char *get_class_name(MappedFileVisitor &visitor) {
+        switch (get_elf_class(visitor)) {
+            case 1:
+                return "ELF32";
+            case 2:
+                return "ELF64";
+            default:
+                return "-";
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    usize thread_num = 0;
+    bool print_index = false;
+    const char *find = nullptr;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "--index") == 0) {
+            print_index = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            thread_num = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--find") == 0 && i + 1 < argc) {
+            find = argv[++i];
+        } else {
+            break;
+        }
+    }
+
+    if (argc - i != 1) {
+        std::cerr << "usage: " << argv[0] << " [--threads N] [--index | --find SYMBOL] ARCHIVE" << std::endl
+                  << "list the members of a static library, or index the symbols they define" << std::endl;
+        return 1;
+    }
+
+    MappedFileVisitor visitor = MappedFileVisitor::open_elf(argv[i]);
+    Archive archive{};
+    if (!Archive::read(visitor, archive, argv[i])) {
+        std::cerr << "not an archive or malformed archive" << std::endl;
+        return 1;
+    }
+
+    auto &members = archive.get_members();
+    if (!print_index && find == nullptr) {
+        for (usize index = 0; index < members.size(); ++index) {
+            MappedFileVisitor member_visitor = archive.get_member_visitor(index);
+            printf("%-6s %12" PRIu64 " %s\n", get_class_name(member_visitor), members[index].size,
+                   members[index].get_name().c_str());
+        }
+        printf("%zu members, %zu indexed symbols%s\n", members.size(), archive.get_symbols().size(),
+               archive.is_thin() ? ", thin" : "");
+        return 0;
+    }
+
+    std::vector<Archive::Symbol> index;
+    archive.build_symbol_index(index, thread_num);
+
+    if (find != nullptr) {
+        auto range = Archive::find_symbol(index, find);
+        if (range.first == range.second) return 1;
+        for (auto iter = range.first; iter != range.second; ++iter) {
+            printf("%s\n", members[iter->member].get_name().c_str());
+        }
+        return 0;
+    }
+
+    for (auto &symbol: index) printf("%s\t%s\n", symbol.name, members[symbol.member].get_name().c_str());
+    return 0;
+}
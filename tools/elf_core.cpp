@@ -0,0 +1,61 @@
+#include <cinttypes>
+
+#include "core_file.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    template<typename USizeT>
+    int print_core(MappedFileVisitor &visitor) {
+        using CoreFileT = CoreFile<USizeT>;
+
+        CoreFileT core{};
+        if (!CoreFileT::read(visitor, core)) {
+            std::cerr << "not a core file" << std::endl;
+            return 1;
+        }
+
+        typename CoreFileT::ProcessInfo info{};
+        if (core.get_process_info(info)) {
+            printf("process %d parent %d uid %u state %c name %s args %s\n", info.pid, info.parent_pid, info.user_id,
+                   info.state, info.name, info.arguments);
+        }
+
+        for (auto &thread: core.get_threads()) {
+            USizeT pc = 0, sp = 0, fp = 0;
+            core.get_register(thread, CoreFileT::PROGRAM_COUNTER, pc);
+            core.get_register(thread, CoreFileT::STACK_POINTER, sp);
+            core.get_register(thread, CoreFileT::FRAME_POINTER, fp);
+
+            auto *mapping = core.find_mapping(pc);
+            printf("thread %d signal %d pc 0x%" PRIx64 " sp 0x%" PRIx64 " fp 0x%" PRIx64 " %s\n", thread.pid,
+                   thread.signal, static_cast<u64>(pc), static_cast<u64>(sp), static_cast<u64>(fp),
+                   mapping == nullptr ? "??" : mapping->path);
+        }
+
+        printf("%zu auxiliary vector entries, %zu mapped files\n", static_cast<size_t>(core.get_aux_num()),
+               core.get_mappings().size());
+
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " CORE" << std::endl;
+        return 1;
+    }
+
+    MappedFileVisitor visitor = MappedFileVisitor::open_elf(argv[1]);
+
+    switch (get_elf_class(visitor)) {
+        case 1:
+            return print_core<u32>(visitor);
+        case 2:
+            return print_core<u64>(visitor);
+        default:
+            std::cerr << "not an ELF file in host byte order" << std::endl;
+            return 1;
+    }
+}
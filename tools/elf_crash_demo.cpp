@@ -0,0 +1,44 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "crash_symbolizer.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    volatile int *null_pointer = nullptr;
+
+    __attribute__((noinline)) void crash(const char *mode) {
+        if (strcmp(mode, "segv") == 0) {
+            *null_pointer = 1;
+        } else if (strcmp(mode, "abort") == 0) {
+            abort();
+        } else {
+            raise(SIGTRAP);
+        }
+    }
+
+    __attribute__((noinline)) void call_crash(const char *mode) {
+        crash(mode);
+        /// keep the call out of tail position so that this frame stays on the stack.
+        asm volatile("");
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2 || (strcmp(argv[1], "segv") != 0 && strcmp(argv[1], "abort") != 0 &&
+                      strcmp(argv[1], "trap") != 0)) {
+        std::cerr << "usage: " << argv[0] << " segv|abort|trap" << std::endl
+                  << "install the crash symbolizer, then crash with the given signal and print the symbolized stack"
+                  << std::endl;
+        return 1;
+    }
+
+    CrashSymbolizer symbolizer{};
+    symbolizer.install_handler();
+    std::cerr << symbolizer.module_num() << " modules loaded" << std::endl;
+
+    call_crash(argv[1]);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+
+#include "debug_file.hpp"
+
+
+int main(int argc, char **argv) {
+    using namespace elf;
+
+    std::vector<std::string> debug_dirs;
+    bool crc_only = false;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "--debug-dir") == 0 && i + 1 < argc) {
+            debug_dirs.emplace_back(argv[++i]);
+        } else if (strcmp(argv[i], "--crc") == 0) {
+            crc_only = true;
+        } else {
+            break;
+        }
+    }
+
+    if (i >= argc || argv[i][0] == '-') {
+        std::cerr << "usage: " << argv[0] << " [--debug-dir DIR]... [--crc] FILE..." << std::endl
+                  << "find the separate debug file of each FILE by build-id or .gnu_debuglink, searching DIR,"
+                  << " /usr/lib/debug by default. With --crc, print the CRC-32 of each FILE instead" << std::endl;
+        return 1;
+    }
+
+    if (debug_dirs.empty()) debug_dirs.emplace_back("/usr/lib/debug");
+    DebugFileResolver resolver{debug_dirs};
+    int status = 0;
+
+    for (; i < argc; ++i) {
+        if (crc_only) {
+            auto start = std::chrono::steady_clock::now();
+            u32 crc = 0;
+            if (!resolver.get_crc(argv[i], crc)) {
+                std::cerr << argv[i] << ": not a readable regular file" << std::endl;
+                status = 1;
+                continue;
+            }
+            auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                               start).count();
+            printf("%08" PRIx32 "\t%s\t%lld us\n", crc, argv[i], static_cast<long long>(time));
+            continue;
+        }
+
+        std::string debug_file = resolver.resolve(argv[i]);
+        if (debug_file.empty()) {
+            printf("%s\t(not found)\n", argv[i]);
+            status = 1;
+        } else {
+            printf("%s\t%s\n", argv[i], debug_file.c_str());
+        }
+    }
+
+    return status;
+}
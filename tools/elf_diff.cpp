@@ -0,0 +1,78 @@
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+
+#include "elf_diff.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    void print_entries(const char *kind, const std::vector<ELFDiff::Entry> &entries) {
+        i64 total = 0;
+        for (auto &entry: entries) {
+            printf("%s %-7s %s %" PRIu64 " -> %" PRIu64 " (%+" PRId64 ")\n", kind,
+                   entry.change == ELFDiff::ADDED ? "added" : entry.change == ELFDiff::REMOVED ? "removed" : "changed",
+                   entry.name.c_str(), entry.old_size, entry.new_size, entry.get_size_delta());
+            total += entry.get_size_delta();
+        }
+        printf("%s: %zu differences, %+" PRId64 " bytes\n", kind, entries.size(), total);
+    }
+
+    template<typename USizeT>
+    int print_diff(MappedFileVisitor &old_visitor, MappedFileVisitor &new_visitor, usize thread_num) {
+        auto *old_header = ELFHeader<USizeT>::read(old_visitor);
+        auto *new_header = ELFHeader<USizeT>::read(new_visitor);
+        if (old_header == nullptr || new_header == nullptr) {
+            std::cerr << "invalid ELF file" << std::endl;
+            return 2;
+        }
+
+        ELFDiff diff{};
+        if (!ELFDiff::diff(old_header, old_visitor, new_header, new_visitor, diff, thread_num)) {
+            std::cerr << "malformed section table" << std::endl;
+            return 2;
+        }
+
+        print_entries("section", diff.sections);
+        print_entries("symbol", diff.symbols);
+
+        return diff.empty() ? 0 : 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    usize thread_num = 0;
+
+    int i = 1;
+    if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) {
+        thread_num = strtoul(argv[i + 1], nullptr, 10);
+        i += 2;
+    }
+
+    if (argc - i != 2) {
+        std::cerr << "usage: " << argv[0] << " [--threads N] OLD NEW" << std::endl
+                  << "report added, removed and changed sections and symbols, exit with 1 if the files differ"
+                  << std::endl;
+        return 2;
+    }
+
+    MappedFileVisitor old_visitor = MappedFileVisitor::open_elf(argv[i]);
+    MappedFileVisitor new_visitor = MappedFileVisitor::open_elf(argv[i + 1]);
+
+    u8 elf_class = get_elf_class(old_visitor);
+    if (elf_class != get_elf_class(new_visitor)) {
+        std::cerr << "files of different classes" << std::endl;
+        return 2;
+    }
+
+    switch (elf_class) {
+        case 1:
+            return print_diff<u32>(old_visitor, new_visitor, thread_num);
+        case 2:
+            return print_diff<u64>(old_visitor, new_visitor, thread_num);
+        default:
+            std::cerr << "not an ELF file in host byte order" << std::endl;
+            return 2;
+    }
+}
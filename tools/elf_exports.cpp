@@ -0,0 +1,101 @@
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <dirent.h>
+
+#include "export_index.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    bool is_shared_library_name(const char *name) {
+        const char *suffix = strstr(name, ".so");
+        return suffix != nullptr && (suffix[3] == '\0' || suffix[3] == '.');
+    }
+
+    /// regular files are taken as they are, directories are walked for shared libraries.
+    void collect_files(const std::string &path, bool top, std::vector<std::string> &files) {
+        struct stat file_stat{};
+        if ((top ? stat(path.c_str(), &file_stat) : lstat(path.c_str(), &file_stat)) != 0) return;
+
+        if (S_ISREG(file_stat.st_mode)) {
+            const char *slash = strrchr(path.c_str(), '/');
+            if (top || is_shared_library_name(slash == nullptr ? path.c_str() : slash + 1)) files.push_back(path);
+            return;
+        }
+        if (!S_ISDIR(file_stat.st_mode)) return;
+
+        DIR *handle = opendir(path.c_str());
+        if (handle == nullptr) return;
+
+        std::vector<std::string> names;
+        for (struct dirent *entry = readdir(handle); entry != nullptr; entry = readdir(handle)) {
+            if (entry->d_name[0] != '.') names.emplace_back(entry->d_name);
+        }
+        closedir(handle);
+        std::sort(names.begin(), names.end());
+
+        for (auto &name: names) collect_files(path + '/' + name, false, files);
+    }
+
+    int usage(const char *program) {
+        std::cerr << "usage: " << program << " build INDEX [--threads N] PATH..." << std::endl
+                  << "       " << program << " find INDEX SYMBOL..." << std::endl
+                  << "index the symbols exported by shared libraries, PATH may be a directory, and find which"
+                  << " libraries export SYMBOL" << std::endl;
+        return 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) return usage(argv[0]);
+
+    if (strcmp(argv[1], "build") == 0) {
+        usize thread_num = 0;
+        int i = 3;
+        if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) {
+            thread_num = strtoul(argv[i + 1], nullptr, 10);
+            i += 2;
+        }
+
+        std::vector<std::string> files;
+        for (; i < argc; ++i) collect_files(argv[i], true, files);
+
+        ExportIndex previous{};
+        bool has_previous = access(argv[2], F_OK) == 0 && ExportIndex::open(argv[2], previous);
+
+        auto start = std::chrono::steady_clock::now();
+        ExportIndex::Stats stats{};
+        if (!ExportIndex::write(files, argv[2], has_previous ? &previous : nullptr, thread_num, &stats)) return 1;
+        auto time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%zu libraries scanned, %zu reused, %zu not shared objects, %zu symbols in %.3f s\n", stats.scanned,
+               stats.reused, stats.failed, stats.posting_num, time);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "find") == 0) {
+        ExportIndex index{};
+        if (!ExportIndex::open(argv[2], index)) {
+            std::cerr << "invalid index" << std::endl;
+            return 1;
+        }
+
+        usize found = 0;
+        for (int i = 3; i < argc; ++i) {
+            found += index.find(argv[i], [&](const ExportIndex::Definition &definition) {
+                const char *binding = definition.binding == 1 ? "GLOBAL" : definition.binding == 2 ? "WEAK" :
+                                                                           "UNIQUE";
+                std::string name = argv[i];
+                if (definition.version != nullptr) {
+                    name.append(definition.hidden ? "@" : "@@").append(definition.version);
+                }
+                printf("%s\t%s\t%s\n", name.c_str(), binding, definition.library);
+            });
+        }
+        return found > 0 ? 0 : 1;
+    }
+
+    return usage(argv[0]);
+}
@@ -0,0 +1,48 @@
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+
+#include "function_starts.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    template<typename USizeT>
+    int print_functions(MappedFileVisitor &visitor) {
+        ValidatedELF<USizeT> elf = validate<USizeT>(visitor);
+        if (!elf.is_valid()) {
+            std::cerr << "invalid ELF file" << std::endl;
+            return 1;
+        }
+
+        FunctionStarts functions{};
+        functions.build(elf);
+
+        for (auto &function: functions.get_functions()) {
+            printf("0x%016" PRIx64 " %8" PRIu64 " %s\n", function.address, function.size, function.name);
+        }
+
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " FILE" << std::endl
+                  << "list the functions found in .eh_frame and at the entry point that no symbol names" << std::endl;
+        return 1;
+    }
+
+    MappedFileVisitor visitor = MappedFileVisitor::open_elf(argv[1]);
+
+    switch (get_elf_class(visitor)) {
+        case 1:
+            return print_functions<u32>(visitor);
+        case 2:
+            return print_functions<u64>(visitor);
+        default:
+            std::cerr << "not an ELF file in host byte order" << std::endl;
+            return 1;
+    }
+}
@@ -0,0 +1,78 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "elf_generator.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    void usage(const char *name) {
+        std::cerr << "usage: " << name << " [--class 32|64] [--endian little|big] [--seed N] [--sections N]"
+                  << " [--symbols N] [--relocations N] [--string-table-size N] [--text-size N] OUTPUT" << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    GeneratorOptions options{};
+    usize elf_class = 64;
+    const char *output = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (arg[0] != '-') {
+            if (output != nullptr) {
+                usage(argv[0]);
+                return 1;
+            }
+            output = arg;
+            continue;
+        }
+
+        if (value == nullptr) {
+            usage(argv[0]);
+            return 1;
+        }
+        ++i;
+
+        if (strcmp(arg, "--class") == 0) {
+            elf_class = strtoull(value, nullptr, 10);
+        } else if (strcmp(arg, "--endian") == 0) {
+            if (strcmp(value, "little") == 0) {
+                options.big_endian = false;
+            } else if (strcmp(value, "big") == 0) {
+                options.big_endian = true;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--seed") == 0) {
+            options.seed = strtoull(value, nullptr, 0);
+        } else if (strcmp(arg, "--sections") == 0) {
+            options.section_num = strtoull(value, nullptr, 10);
+        } else if (strcmp(arg, "--symbols") == 0) {
+            options.symbol_num = strtoull(value, nullptr, 10);
+        } else if (strcmp(arg, "--relocations") == 0) {
+            options.relocation_num = strtoull(value, nullptr, 10);
+        } else if (strcmp(arg, "--string-table-size") == 0) {
+            options.string_table_size = strtoull(value, nullptr, 10);
+        } else if (strcmp(arg, "--text-size") == 0) {
+            options.text_size = strtoull(value, nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (output == nullptr || (elf_class != 32 && elf_class != 64)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    bool success = elf_class == 64 ? ELFGenerator<u64>{options}.write(output) :
+                   ELFGenerator<u32>{options}.write(output);
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+
+#include "inline_frames.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    template<typename USizeT>
+    int print_frames(MappedFileVisitor &visitor, const std::vector<u64> &addresses) {
+        ValidatedELF<USizeT> elf = validate<USizeT>(visitor);
+        if (!elf.is_valid()) {
+            std::cerr << "invalid ELF file" << std::endl;
+            return 1;
+        }
+
+        DWARF dwarf{};
+        if (!dwarf.load(elf)) {
+            std::cerr << "no uncompressed .debug_info" << std::endl;
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        UnitIndex index{};
+        index.build(dwarf);
+        InlineFrames frames{dwarf, index};
+        InlineFrames::Batch batch{};
+        frames.find(addresses.data(), addresses.size(), batch);
+        auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                           start).count();
+
+        for (usize i = 0; i < batch.size(); ++i) {
+            printf("0x%" PRIx64 "\n", addresses[i]);
+            if (batch[i].empty()) printf("    ??\n");
+            for (auto &frame: batch[i]) {
+                printf("    %s", frame.name == nullptr ? "??" : frame.name);
+                if (frame.call_line != 0) {
+                    printf(" inlined at %s:%" PRIu32 ":%" PRIu32, frame.call_file == nullptr ? "??" : frame.call_file,
+                           frame.call_line, frame.call_column);
+                }
+                printf("\n");
+            }
+        }
+
+        std::cerr << addresses.size() << " addresses in " << time << " us, " << frames.decoded_num() << " of "
+                  << index.get_units().size() << " units decoded" << std::endl;
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " FILE [ADDRESS...]" << std::endl
+                  << "print the chain of inlined functions at each hex ADDRESS, read from standard input if none is"
+                  << " given" << std::endl;
+        return 1;
+    }
+
+    std::vector<u64> addresses;
+    if (argc > 2) {
+        for (int i = 2; i < argc; ++i) addresses.push_back(strtoull(argv[i], nullptr, 16));
+    } else {
+        char line[256];
+        while (fgets(line, sizeof(line), stdin) != nullptr) addresses.push_back(strtoull(line, nullptr, 16));
+    }
+
+    MappedFileVisitor visitor = MappedFileVisitor::open_elf(argv[1]);
+
+    switch (get_elf_class(visitor)) {
+        case 1:
+            return print_frames<u32>(visitor, addresses);
+        case 2:
+            return print_frames<u64>(visitor, addresses);
+        default:
+            std::cerr << "not an ELF file in host byte order" << std::endl;
+            return 1;
+    }
+}
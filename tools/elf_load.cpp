@@ -0,0 +1,96 @@
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+
+#include "image_loader.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    /// compare every loaded segment with the file, and check that the rest of its memory reads as zero.
+    template<typename USizeT>
+    bool check_segments(const GuestImage<USizeT> &image, MappedFileVisitor &visitor) {
+        using ProgramHeaderT = ProgramHeader<USizeT>;
+
+        bool success = true;
+        for (auto &program: ELFHeader<USizeT>::read(visitor)->programs(visitor)) {
+            /// segments without read access cannot be checked.
+            if (program.type != ProgramHeaderT::LOADABLE || program.mem_size == 0 || !program.is_read()) continue;
+
+            const u8 *data = image.to_host(program.virtual_address + image.get_bias(), program.mem_size);
+            const void *content = visitor.address(program.offset, program.file_size);
+            if (data == nullptr || (program.file_size > 0 && memcmp(data, content, program.file_size) != 0)) {
+                std::cerr << "segment at 0x" << std::hex << program.virtual_address << std::dec
+                          << " differs from the file" << std::endl;
+                success = false;
+                continue;
+            }
+
+            for (USizeT i = program.file_size; i < program.mem_size; ++i) {
+                if (data[i] != 0) {
+                    std::cerr << "bss at 0x" << std::hex << program.virtual_address + i << std::dec
+                              << " is not zero" << std::endl;
+                    success = false;
+                    break;
+                }
+            }
+        }
+        return success;
+    }
+
+    template<typename USizeT>
+    int load_image(MappedFileVisitor &visitor, u64 bias) {
+        GuestImage<USizeT> image{};
+        if (!GuestImage<USizeT>::load(visitor, static_cast<USizeT>(bias), image)) {
+            std::cerr << "cannot load the image" << std::endl;
+            return 1;
+        }
+
+        auto &tls = image.get_tls();
+        printf("reservation: %zu bytes at guest 0x%" PRIx64 "\n", image.get_size(),
+               static_cast<u64>(image.get_guest_base()));
+        printf("entry: 0x%" PRIx64 "\n", static_cast<u64>(image.get_entry()));
+        printf("program headers: %zu at 0x%" PRIx64 "\n", image.get_program_num(),
+               static_cast<u64>(image.get_program_address()));
+        if (tls.mem_size == 0) {
+            printf("tls: none\n");
+        } else {
+            printf("tls: 0x%" PRIx64 ", %" PRIu64 " bytes, %" PRIu64 " initialized, aligned to %" PRIu64 "\n",
+                   static_cast<u64>(tls.address), static_cast<u64>(tls.mem_size), static_cast<u64>(tls.file_size),
+                   static_cast<u64>(tls.alignment));
+        }
+        printf("interpreter: %s\n", image.get_interpreter() == nullptr ? "none" : image.get_interpreter());
+
+        return check_segments(image, visitor) ? 0 : 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    u64 bias = 0;
+
+    int i = 1;
+    if (i + 1 < argc && strcmp(argv[i], "--bias") == 0) {
+        bias = strtoull(argv[i + 1], nullptr, 16);
+        i += 2;
+    }
+
+    if (i + 1 != argc) {
+        std::cerr << "usage: " << argv[0] << " [--bias ADDRESS] FILE" << std::endl
+                  << "map the segments of FILE like a loader, shared objects at the hex ADDRESS, print the entry"
+                  << " point, TLS template and interpreter and check the mapped memory against the file" << std::endl;
+        return 1;
+    }
+
+    MappedFileVisitor visitor = MappedFileVisitor::open_elf(argv[i]);
+
+    switch (get_elf_class(visitor)) {
+        case 1:
+            return load_image<u32>(visitor, bias);
+        case 2:
+            return load_image<u64>(visitor, bias);
+        default:
+            std::cerr << "not an ELF file in host byte order" << std::endl;
+            return 1;
+    }
+}
@@ -0,0 +1,39 @@
+#include <cinttypes>
+
+#include "loaded_image.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    void print_symbol(const char *name) {
+        LoadedSymbol symbol{};
+        if (!find_loaded_symbol(name, symbol)) {
+            printf("%s\t??\n", name);
+            return;
+        }
+
+        LoadedSymbol covering{};
+        symbolize_loaded(symbol.address, covering);
+        printf("%s\t0x%" PRIx64 "\t%" PRIu64 "\t%s\t%s\n", name, symbol.address, symbol.size,
+               symbol.image[0] == '\0' ? "[main]" : symbol.image, covering.name == nullptr ? "??" : covering.name);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && argv[1][0] == '-') {
+        std::cerr << "usage: " << argv[0] << " [NAME...]" << std::endl
+                  << "list the images loaded in this process, then find the image defining each symbol NAME and the"
+                  << " symbol covering its address" << std::endl;
+        return 1;
+    }
+
+    for (auto &image: loaded_images()) {
+        printf("0x%" PRIx64 "\t%zu segments\t%zu symbols\t%s\n", static_cast<u64>(image.get_bias()),
+               image.programs().size(), image.symbol_table().size(),
+               image.get_name()[0] == '\0' ? "[main]" : image.get_name());
+    }
+
+    for (int i = 1; i < argc; ++i) print_symbol(argv[i]);
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+
+#include "content_hash.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    template<typename USizeT>
+    int print_manifest(const char *name, MappedFileVisitor &visitor, bool segments, usize thread_num) {
+        auto *header = ELFHeader<USizeT>::read(visitor);
+        if (header == nullptr) {
+            std::cerr << name << ": invalid ELF file" << std::endl;
+            return 1;
+        }
+
+        for (auto &entry: build_manifest(header, visitor, segments, thread_num)) {
+            printf("%s\t%s\t%" PRIu64 "\t%016" PRIx64 "\n", name, entry.name.c_str(), entry.size, entry.hash);
+        }
+
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    bool segments = true;
+    usize thread_num = 0;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "--no-segments") == 0) {
+            segments = false;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            thread_num = strtoul(argv[++i], nullptr, 10);
+        } else {
+            break;
+        }
+    }
+
+    if (i >= argc) {
+        std::cerr << "usage: " << argv[0] << " [--threads N] [--no-segments] FILE..." << std::endl
+                  << "print the size and content hash of every section and segment, one per line" << std::endl;
+        return 1;
+    }
+
+    int ret = 0;
+    for (; i < argc; ++i) {
+        MappedFileVisitor visitor = MappedFileVisitor::open_elf(argv[i]);
+
+        switch (get_elf_class(visitor)) {
+            case 1:
+                ret |= print_manifest<u32>(argv[i], visitor, segments, thread_num);
+                break;
+            case 2:
+                ret |= print_manifest<u64>(argv[i], visitor, segments, thread_num);
+                break;
+            default:
+                std::cerr << argv[i] << ": not an ELF file in host byte order" << std::endl;
+                ret = 1;
+                break;
+        }
+    }
+
+    return ret;
+}
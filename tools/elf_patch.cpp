@@ -0,0 +1,244 @@
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <utility>
+#include <vector>
+
+#include "validated_elf.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    struct Patch {
+        const char *option;
+        const char *name;
+        u64 val;
+    };
+
+    /// bytes to store at `destination` once every patch is known to apply, since each store through the shared
+    /// mapping reaches the file at once.
+    struct Write {
+        void *destination;
+        std::vector<u8> bytes;
+    };
+
+    /// queue `val` for `field`, return false if it does not fit, like `MappedFileVisitor::write`.
+    template<typename FieldT, typename ValueT>
+    bool stage(std::vector<Write> &writes, FieldT *field, ValueT val) {
+        if (!MappedFileVisitor::fits<FieldT>(val)) return false;
+
+        auto converted = static_cast<FieldT>(val);
+        auto *bytes = reinterpret_cast<const u8 *>(&converted);
+        writes.push_back(Write{field, std::vector<u8>(bytes, bytes + sizeof(converted))});
+        return true;
+    }
+
+    template<typename USizeT>
+    bool patch_dynamic(const ValidatedELF<USizeT> &elf, std::vector<Write> &writes, u64 tag, u64 val) {
+        using SectionHeaderT = SectionHeader<USizeT>;
+        using EntryT = typename DynLinkingTableHeader<USizeT>::Entry;
+
+        for (auto &section: elf.sections()) {
+            if (section.section_type != SectionHeaderT::DYNAMIC_LINKING_TABLE) continue;
+            for (auto &entry: elf.template get_entries<EntryT>(section)) {
+                if (entry.tag == tag) return stage(writes, &entry.val, val);
+            }
+        }
+        return false;
+    }
+
+    /// whether another string of the string table `strings_index` starts in (start, end], inside the string at
+    /// `start`. Linkers merging string tails store `lib` in the bytes of `$ORIGIN/../lib`, for a DT_NEEDED, a
+    /// DT_SONAME, a symbol or a version name, and overwriting the string at `start` would change it too.
+    template<typename USizeT>
+    bool is_shared(const ValidatedELF<USizeT> &elf, MappedFileVisitor &visitor, const SectionHeader<USizeT> &dynamic,
+                   usize strings_index, u64 start, u64 end) {
+        using SectionHeaderT = SectionHeader<USizeT>;
+        using DynLinkingTableHeaderT = DynLinkingTableHeader<USizeT>;
+        using EntryT = typename DynLinkingTableHeaderT::Entry;
+
+        auto inside = [&](u64 offset) { return offset > start && offset <= end; };
+
+        for (auto &entry: elf.template get_entries<EntryT>(dynamic)) {
+            if ((entry.tag == DynLinkingTableHeaderT::NEEDED || entry.tag == DynLinkingTableHeaderT::SONAME ||
+                 entry.tag == DynLinkingTableHeaderT::RPATH || entry.tag == DynLinkingTableHeaderT::RUNPATH) &&
+                inside(entry.val)) {
+                return true;
+            }
+        }
+
+        for (auto &section: elf.sections()) {
+            if (section.link != strings_index) continue;
+
+            std::vector<u32> names;
+            if (section.section_type == SectionHeaderT::SYMBOL_TABLE ||
+                section.section_type == SectionHeaderT::DYNAMIC_SYMBOL_TABLE) {
+                for (auto &symbol: elf.get_symbol_table(section)) {
+                    if (inside(symbol.name)) return true;
+                }
+            } else if (section.section_type == SectionHeaderT::VERSION_DEF) {
+                auto *header = SectionHeaderT::template cast<VersionDefinitionHeader<USizeT>>(&section, visitor);
+                if (header == nullptr || !header->get_names(visitor, names)) return true;
+            } else if (section.section_type == SectionHeaderT::VERSION_NEED) {
+                auto *header = SectionHeaderT::template cast<VersionNeedHeader<USizeT>>(&section, visitor);
+                if (header == nullptr || !header->get_names(visitor, names)) return true;
+            }
+
+            for (u32 name: names) {
+                if (inside(name)) return true;
+            }
+        }
+        return false;
+    }
+
+    /// overwrite the RUNPATH or RPATH string in .dynstr, which works as long as the new one is not longer and no
+    /// other string is stored in its bytes.
+    template<typename USizeT>
+    bool patch_runpath(const ValidatedELF<USizeT> &elf, MappedFileVisitor &visitor, std::vector<Write> &writes,
+                       const char *path) {
+        using SectionHeaderT = SectionHeader<USizeT>;
+        using DynLinkingTableHeaderT = DynLinkingTableHeader<USizeT>;
+        using EntryT = typename DynLinkingTableHeaderT::Entry;
+
+        for (auto &section: elf.sections()) {
+            if (section.section_type != SectionHeaderT::DYNAMIC_LINKING_TABLE) continue;
+            auto &strings = elf.sections()[section.link];
+
+            for (auto &entry: elf.template get_entries<EntryT>(section)) {
+                if (entry.tag != DynLinkingTableHeaderT::RUNPATH && entry.tag != DynLinkingTableHeaderT::RPATH) {
+                    continue;
+                }
+
+                auto *old = reinterpret_cast<char *>(elf.get_content(strings)) + entry.val;
+                usize old_size = strnlen(old, strings.size - entry.val);
+                if (strlen(path) > old_size) return false;
+                if (is_shared(elf, visitor, section, section.link, entry.val, entry.val + old_size)) {
+                    std::cerr << "another string of .dynstr is stored in the bytes of the old path" << std::endl;
+                    return false;
+                }
+                writes.push_back(Write{old, std::vector<u8>(path, path + strlen(path) + 1)});
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// return the number of symbols named `name`, 0 if none is or if `val` does not fit.
+    template<typename USizeT>
+    usize patch_symbols(const ValidatedELF<USizeT> &elf, std::vector<Write> &writes, const char *name, u64 val) {
+        using SectionHeaderT = SectionHeader<USizeT>;
+
+        usize patched = 0;
+        for (auto &section: elf.sections()) {
+            if (section.section_type != SectionHeaderT::SYMBOL_TABLE &&
+                section.section_type != SectionHeaderT::DYNAMIC_SYMBOL_TABLE)
+                continue;
+
+            auto strings = elf.get_linked_string_table(section);
+            for (auto &symbol: elf.get_symbol_table(section)) {
+                if (symbol.name == 0 || strcmp(strings.get_str(symbol.name), name) != 0) continue;
+                if (!stage(writes, &symbol.value, val)) return 0;
+                ++patched;
+            }
+        }
+        return patched;
+    }
+
+    template<typename USizeT>
+    int apply_patches(MappedFileVisitor &visitor, const std::vector<Patch> &patches) {
+        using ELFHeaderT = ELFHeader<USizeT>;
+
+        ValidatedELF<USizeT> elf = validate<USizeT>(visitor);
+        if (!elf.is_valid()) {
+            std::cerr << "invalid ELF file" << std::endl;
+            return 1;
+        }
+
+        /// resolve and check every patch first, so that a failed run leaves the file untouched.
+        std::vector<Write> writes;
+        std::vector<std::pair<usize, const char *>> symbol_counts;
+        bool success = true;
+        for (auto &patch: patches) {
+            bool found;
+            ELFHeaderT &header = elf.get_header();
+            if (strcmp(patch.option, "--entry") == 0) {
+                found = stage(writes, &header.entry_point, patch.val);
+            } else if (strcmp(patch.option, "--flags") == 0) {
+                found = stage(writes, &header.flags, patch.val);
+            } else if (strcmp(patch.option, "--dynamic") == 0) {
+                found = patch_dynamic(elf, writes, strtoull(patch.name, nullptr, 0), patch.val);
+            } else if (strcmp(patch.option, "--runpath") == 0) {
+                found = patch_runpath(elf, visitor, writes, patch.name);
+            } else {
+                usize patched = patch_symbols(elf, writes, patch.name, patch.val);
+                symbol_counts.emplace_back(patched, patch.name);
+                found = patched > 0;
+            }
+
+            if (!found) {
+                std::cerr << patch.option;
+                if (patch.name != nullptr) std::cerr << ' ' << patch.name;
+                std::cerr << ": not found or value does not fit" << std::endl;
+                success = false;
+            }
+        }
+
+        if (!success) {
+            std::cerr << "nothing written" << std::endl;
+            return 1;
+        }
+
+        for (auto &write: writes) {
+            if (!visitor.write_bytes(write.destination, write.bytes.data(), write.bytes.size())) return 1;
+        }
+        if (!visitor.commit()) return 1;
+
+        for (auto &count: symbol_counts) {
+            std::cout << count.first << " symbols named " << count.second << " patched" << std::endl;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::vector<Patch> patches;
+
+    int i = 2;
+    for (; i < argc; ++i) {
+        const char *option = argv[i];
+        if ((strcmp(option, "--entry") == 0 || strcmp(option, "--flags") == 0) && i + 1 < argc) {
+            patches.push_back(Patch{option, nullptr, strtoull(argv[i + 1], nullptr, 0)});
+            i += 1;
+        } else if ((strcmp(option, "--dynamic") == 0 || strcmp(option, "--symbol") == 0) && i + 2 < argc) {
+            patches.push_back(Patch{option, argv[i + 1], strtoull(argv[i + 2], nullptr, 0)});
+            i += 2;
+        } else if (strcmp(option, "--runpath") == 0 && i + 1 < argc) {
+            patches.push_back(Patch{option, argv[i + 1], 0});
+            i += 1;
+        } else {
+            break;
+        }
+    }
+
+    if (argc < 3 || i != argc) {
+        std::cerr << "usage: " << argv[0] << " FILE [--entry ADDRESS] [--flags N] [--dynamic TAG VALUE]"
+                  << " [--symbol NAME VALUE] [--runpath PATH]..." << std::endl
+                  << "patch fixed size fields of FILE in place: the entry point or flags of the ELF header, the first"
+                  << " dynamic entry of TAG, the value of every symbol named NAME, or the RUNPATH string, which can"
+                  << " only get shorter" << std::endl;
+        return 1;
+    }
+
+    MappedFileVisitor visitor = MappedFileVisitor::open_elf_writable(argv[1]);
+
+    switch (get_elf_class(visitor)) {
+        case 1:
+            return apply_patches<u32>(visitor, patches);
+        case 2:
+            return apply_patches<u64>(visitor, patches);
+        default:
+            std::cerr << "not an ELF file in host byte order" << std::endl;
+            return 1;
+    }
+}
@@ -0,0 +1,93 @@
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+
+#include "relocation_cost.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    template<typename USizeT>
+    int print_cost(MappedFileVisitor &visitor, u64 page_size, usize limit) {
+        auto *header = ELFHeader<USizeT>::read(visitor);
+        if (header == nullptr) {
+            std::cerr << "invalid ELF file" << std::endl;
+            return 1;
+        }
+
+        RelocationCost cost{};
+        if (!RelocationCost::analyze(header, visitor, cost, page_size)) {
+            std::cerr << "unreadable dynamic relocation table" << std::endl;
+            return 1;
+        }
+
+        std::cout << cost.get_relocation_num() << " dynamic relocations";
+        if (cost.relr_word_num > 0) {
+            std::cout << ", " << cost.relr_num << " of them packed in " << cost.relr_word_num << " RELR words";
+        }
+        std::cout << std::endl;
+        for (usize i = 0; i < RelocationCost::KIND_NUM; ++i) {
+            if (cost.counts[i] == 0) continue;
+            std::cout << "  " << static_cast<RelocationCost::Kind>(i) << ": " << cost.counts[i] << std::endl;
+        }
+
+        std::cout << "bind now: " << (cost.bind_now ? "yes" : "no") << ", text relocations: "
+                  << (cost.text_relocations ? "yes" : "no") << std::endl;
+
+        printf("%-8s %-18s %10s %10s %12s\n", "segment", "address", "pages", "dirty", "relocations");
+        u64 dirty_page_num = 0;
+        for (auto &segment: cost.segments) {
+            printf("%-8zu 0x%-16" PRIx64 " %10" PRIu64 " %10" PRIu64 " %12" PRIu64 "\n", segment.index,
+                   segment.address, segment.page_num, segment.dirty_page_num, segment.relocation_num);
+            dirty_page_num += segment.dirty_page_num;
+        }
+        printf("%" PRIu64 " pages dirtied", dirty_page_num);
+        if (cost.unmapped_num > 0) printf(", %" PRIu64 " relocations outside of any segment", cost.unmapped_num);
+        printf("\n");
+
+        printf("%" PRIu64 " symbol lookups at load time for %zu symbols, %" PRIu64 " lazy JUMP_SLOT relocations\n",
+               cost.lookup_num, cost.lookups.size(), cost.lazy_num);
+        for (usize i = 0; i < cost.lookups.size() && i < limit; ++i) {
+            printf("%10" PRIu64 " %s\n", cost.lookups[i].count, cost.lookups[i].name);
+        }
+        if (cost.lookups.size() > limit) printf("... %zu more\n", cost.lookups.size() - limit);
+
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    u64 page_size = 4096;
+    usize limit = 20;
+
+    int i = 1;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (strcmp(argv[i], "--page-size") == 0) {
+            page_size = strtoull(argv[i + 1], nullptr, 10);
+        } else if (strcmp(argv[i], "--symbols") == 0) {
+            limit = strtoul(argv[i + 1], nullptr, 10);
+        } else {
+            break;
+        }
+    }
+
+    if (argc - i != 1 || page_size == 0 || (page_size & (page_size - 1)) != 0) {
+        std::cerr << "usage: " << argv[0] << " [--page-size N] [--symbols N] FILE" << std::endl
+                  << "count the dynamic relocations by kind, the pages they dirty in each loadable segment and the"
+                  << " N symbols most looked up at load time" << std::endl;
+        return 1;
+    }
+
+    MappedFileVisitor visitor = MappedFileVisitor::open_elf(argv[i]);
+
+    switch (get_elf_class(visitor)) {
+        case 1:
+            return print_cost<u32>(visitor, page_size, limit);
+        case 2:
+            return print_cost<u64>(visitor, page_size, limit);
+        default:
+            std::cerr << "not an ELF file in host byte order" << std::endl;
+            return 1;
+    }
+}
@@ -0,0 +1,81 @@
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+
+#include "size_report.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    void print_node(const SizeReport::Node &node, usize depth, usize limit) {
+        for (usize i = 0; i < node.children.size(); ++i) {
+            const SizeReport::Node &child = node.children[i];
+            if (depth == 2 && i == limit) {
+                printf("%*s... %zu more\n", static_cast<int>(depth * 2), "", node.children.size() - limit);
+                break;
+            }
+            printf("%*s%-40s %12" PRIu64 " %12" PRIu64 "\n", static_cast<int>(depth * 2), "", child.name.c_str(),
+                   child.file_size, child.vm_size);
+            print_node(child, depth + 1, limit);
+        }
+    }
+
+    template<typename USizeT>
+    int print_report(MappedFileVisitor &visitor, bool json, usize limit) {
+        auto *header = ELFHeader<USizeT>::read(visitor);
+        if (header == nullptr) {
+            std::cerr << "invalid ELF file" << std::endl;
+            return 1;
+        }
+
+        SizeReport::Node root{};
+        SizeReport::build(header, visitor, root);
+
+        if (json) {
+            SizeReport::write_json(std::cout, root);
+            std::cout << std::endl;
+        } else {
+            printf("%-40s %12s %12s\n", "", "file size", "vm size");
+            print_node(root, 0, limit);
+            printf("%-40s %12" PRIu64 " %12" PRIu64 "\n", "total", root.file_size, root.vm_size);
+        }
+
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    bool json = false;
+    usize limit = 10;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strcmp(argv[i], "--symbols") == 0 && i + 1 < argc) {
+            limit = strtoul(argv[++i], nullptr, 10);
+        } else {
+            break;
+        }
+    }
+
+    if (argc - i != 1) {
+        std::cerr << "usage: " << argv[0] << " [--json] [--symbols N] FILE" << std::endl
+                  << "attribute the file and memory bytes to segments, sections and symbols, the text output lists"
+                  << " the N largest symbols of each section" << std::endl;
+        return 1;
+    }
+
+    MappedFileVisitor visitor = MappedFileVisitor::open_elf(argv[i]);
+
+    switch (get_elf_class(visitor)) {
+        case 1:
+            return print_report<u32>(visitor, json, limit);
+        case 2:
+            return print_report<u64>(visitor, json, limit);
+        default:
+            std::cerr << "not an ELF file in host byte order" << std::endl;
+            return 1;
+    }
+}
@@ -0,0 +1,46 @@
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+
+#include "process_view.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    void print_location(const ProcessView &view, u64 address) {
+        ProcessView::Location location{};
+
+        if (!view.symbolize(address, location)) {
+            printf("0x%" PRIx64 " ??\n", address);
+        } else if (location.symbol == nullptr) {
+            printf("0x%" PRIx64 " %s 0x%" PRIx64 "\n", address, location.module->get_path().c_str(),
+                   location.address);
+        } else {
+            printf("0x%" PRIx64 " %s %s+0x%" PRIx64 "\n", address, location.module->get_path().c_str(),
+                   location.symbol->name, location.offset);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " PID [ADDRESS...]" << std::endl
+                  << "addresses are read from standard input if none is given" << std::endl;
+        return 1;
+    }
+
+    ModuleCache cache{};
+    ProcessView view{};
+
+    if (!ProcessView::open(static_cast<pid_t>(strtol(argv[1], nullptr, 10)), cache, view)) return 1;
+
+    if (argc > 2) {
+        for (int i = 2; i < argc; ++i) print_location(view, strtoull(argv[i], nullptr, 16));
+    } else {
+        char line[256];
+        while (fgets(line, sizeof(line), stdin) != nullptr) print_location(view, strtoull(line, nullptr, 16));
+    }
+
+    return 0;
+}
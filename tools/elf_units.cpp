@@ -0,0 +1,98 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+
+#include "unit_index.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    const char *get_unit_name(const DWARF &dwarf, const DWARF::Unit &unit) {
+        DWARF::AbbrevTable table{};
+        if (!table.parse(dwarf.abbrev, unit.abbrev_offset)) return nullptr;
+
+        DWARF::Unit root = unit;
+        DWARF::PCAttributes pc{};
+        DWARF::Value name{};
+        bool has_name = false;
+        if (!dwarf.read_root(root, table, pc, [&](u16 attribute, const DWARF::Value &value) {
+            if (attribute == DWARF::NAME) {
+                name = value;
+                has_name = true;
+            }
+        }) || !has_name) {
+            return nullptr;
+        }
+
+        return dwarf.get_string(root, name);
+    }
+
+    template<typename USizeT>
+    int print_units(MappedFileVisitor &visitor, usize thread_num, char **addresses, int address_num) {
+        ValidatedELF<USizeT> elf = validate<USizeT>(visitor);
+        if (!elf.is_valid()) {
+            std::cerr << "invalid ELF file" << std::endl;
+            return 1;
+        }
+
+        DWARF dwarf{};
+        if (!dwarf.load(elf)) {
+            std::cerr << "no uncompressed .debug_info" << std::endl;
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        UnitIndex index{};
+        index.build(dwarf, thread_num);
+        auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                           start).count();
+
+        printf("%zu units, %zu intervals in %lld us: %zu units from .debug_aranges, %zu units scanned\n",
+               index.get_units().size(), index.get_intervals().size(), static_cast<long long>(time),
+               index.get_stats().aranges_unit_num, index.get_stats().scanned_unit_num);
+
+        for (int i = 0; i < address_num; ++i) {
+            u64 address = strtoull(addresses[i], nullptr, 16);
+            const DWARF::Unit *unit = index.find(address);
+            if (unit == nullptr) {
+                printf("0x%" PRIx64 "\t??\n", address);
+                continue;
+            }
+            const char *name = get_unit_name(dwarf, *unit);
+            printf("0x%" PRIx64 "\t0x%" PRIx64 "\t%s\n", address, unit->offset, name == nullptr ? "??" : name);
+        }
+
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    usize thread_num = 0;
+
+    int i = 1;
+    if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) {
+        thread_num = strtoul(argv[i + 1], nullptr, 10);
+        i += 2;
+    }
+
+    if (i >= argc) {
+        std::cerr << "usage: " << argv[0] << " [--threads N] FILE [ADDRESS]..." << std::endl
+                  << "index the compilation units of FILE by address, and print the unit covering each hex ADDRESS"
+                  << std::endl;
+        return 1;
+    }
+
+    MappedFileVisitor visitor = MappedFileVisitor::open_elf(argv[i]);
+
+    switch (get_elf_class(visitor)) {
+        case 1:
+            return print_units<u32>(visitor, thread_num, argv + i + 1, argc - i - 1);
+        case 2:
+            return print_units<u64>(visitor, thread_num, argv + i + 1, argc - i - 1);
+        default:
+            std::cerr << "not an ELF file in host byte order" << std::endl;
+            return 1;
+    }
+}
@@ -0,0 +1,99 @@
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <chrono>
+
+#include "relocation_xref.hpp"
+
+
+namespace {
+    using namespace elf;
+
+    template<typename USizeT>
+    int print_xref(MappedFileVisitor &visitor, bool unreferenced, int name_num, char **names) {
+        using SectionHeaderT = SectionHeader<USizeT>;
+        using SymbolTableHeaderT = _SymbolTableHeader<USizeT>;
+
+        ValidatedELF<USizeT> elf = validate<USizeT>(visitor);
+        if (!elf.is_valid()) {
+            std::cerr << "invalid ELF file" << std::endl;
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        RelocationXRef xref{};
+        xref.build(elf);
+        auto time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (!unreferenced && name_num == 0) {
+            printf("%zu relocations referring to %zu symbols indexed in %.3f ms\n", xref.size(),
+                   xref.get_symbol_num(), time * 1000);
+            return 0;
+        }
+
+        auto sections = elf.sections();
+        usize found = 0;
+
+        for (usize i = 0; i < sections.size(); ++i) {
+            auto &section = sections[i];
+            if (section.section_type != SectionHeaderT::SYMBOL_TABLE &&
+                section.section_type != SectionHeaderT::DYNAMIC_SYMBOL_TABLE)
+                continue;
+
+            auto strings = elf.get_linked_string_table(section);
+            auto symbols = elf.get_symbol_table(section);
+
+            for (usize j = 1; j < symbols.size(); ++j) {
+                auto &symbol = symbols[j];
+                const char *name = strings.get_str(symbol.name);
+
+                if (unreferenced) {
+                    auto type = symbol.get_type();
+                    if (symbol.section_header_index == SectionHeaderT::INDEX_UNDEFINED || name[0] == '\0' ||
+                        (type != SymbolTableHeaderT::FUNCTION && type != SymbolTableHeaderT::OBJECT) ||
+                        !xref.find(i, j).empty())
+                        continue;
+                    printf("%s\t%s\n", elf.get_section_name(section), name);
+                    ++found;
+                    continue;
+                }
+
+                for (int k = 0; k < name_num; ++k) {
+                    if (strcmp(name, names[k]) != 0) continue;
+                    for (auto &site: xref.find(i, j)) {
+                        printf("%s\t%s\t0x%" PRIx64 "\ttype %" PRIu32 "\t%+" PRIi64 "\n", name,
+                               elf.get_section_name(sections[site.section]), site.offset, site.type, site.addend);
+                        ++found;
+                    }
+                }
+            }
+        }
+
+        return found > 0 ? 0 : 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    bool unreferenced = argc > 1 && strcmp(argv[1], "--unreferenced") == 0;
+    int i = unreferenced ? 2 : 1;
+
+    if (i >= argc || (unreferenced && i + 1 != argc)) {
+        std::cerr << "usage: " << argv[0] << " FILE [SYMBOL...]" << std::endl
+                  << "       " << argv[0] << " --unreferenced FILE" << std::endl
+                  << "list the relocations referring to SYMBOL, or the defined functions and objects no relocation"
+                  << " refers to" << std::endl;
+        return 1;
+    }
+
+    MappedFileVisitor visitor = MappedFileVisitor::open_elf(argv[i]);
+
+    switch (get_elf_class(visitor)) {
+        case 1:
+            return print_xref<u32>(visitor, unreferenced, argc - i - 1, argv + i + 1);
+        case 2:
+            return print_xref<u64>(visitor, unreferenced, argc - i - 1, argv + i + 1);
+        default:
+            std::cerr << "not an ELF file in host byte order" << std::endl;
+            return 1;
+    }
+}